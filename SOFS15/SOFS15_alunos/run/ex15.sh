@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# This test vector deals with the operations alloc / free data clusters when the free data clusters
+# are kept in a bitmap.
+# It defines a storage device with 524 blocks and formats it with an inode table of 8 inodes and a
+# bitmap of free data clusters.
+# It starts by allocating all the data clusters. Then, it frees the odd numbered data clusters in
+# ascending order and the even numbered ones in descending order, tries to free a data cluster which
+# is already free, the data cluster of the root directory and a data cluster which does not exist.
+# Finally, it allocates three data clusters.
+# The showblock_sofs15 application should be used in the end to check metadata.
+
+./createEmptyFile myDisk 524
+./mkfs_sofs15 -n SOFS15 -f bitmap -i 8 -z myDisk
+./testifuncs15 -b -l 600,700 -L testVector15.rst myDisk <testVector15.cmd
@@ -0,0 +1,14 @@
+#!/bin/bash
+
+# This test vector deals with the operations alloc / free data clusters when the caches of references
+# to free data clusters are small.
+# It defines a storage device with 524 blocks and formats it with an inode table of 8 inodes and
+# caches holding 5 references, so that they are replenished and depleted many times.
+# It starts by allocating 20 data clusters and freeing them in the order of allocation. Then, it
+# allocates all the data clusters, frees them in the reverse order of allocation and tries to free
+# a data cluster which is already free. Finally, it allocates a data cluster.
+# The showblock_sofs15 application should be used in the end to check metadata.
+
+./createEmptyFile myDisk 524
+./mkfs_sofs15 -n SOFS15 -c 5 -i 8 -z myDisk
+./testifuncs15 -b -l 600,700 -L testVector16.rst myDisk <testVector16.cmd
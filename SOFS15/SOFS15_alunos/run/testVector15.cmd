@@ -0,0 +1,398 @@
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster (it is going to fail - there are no more free data clusters)
+4 #free data cluster
+1
+4 #free data cluster
+3
+4 #free data cluster
+5
+4 #free data cluster
+7
+4 #free data cluster
+9
+4 #free data cluster
+11
+4 #free data cluster
+13
+4 #free data cluster
+15
+4 #free data cluster
+17
+4 #free data cluster
+19
+4 #free data cluster
+21
+4 #free data cluster
+23
+4 #free data cluster
+25
+4 #free data cluster
+27
+4 #free data cluster
+29
+4 #free data cluster
+31
+4 #free data cluster
+33
+4 #free data cluster
+35
+4 #free data cluster
+37
+4 #free data cluster
+39
+4 #free data cluster
+41
+4 #free data cluster
+43
+4 #free data cluster
+45
+4 #free data cluster
+47
+4 #free data cluster
+49
+4 #free data cluster
+51
+4 #free data cluster
+53
+4 #free data cluster
+55
+4 #free data cluster
+57
+4 #free data cluster
+59
+4 #free data cluster
+61
+4 #free data cluster
+63
+4 #free data cluster
+65
+4 #free data cluster
+67
+4 #free data cluster
+69
+4 #free data cluster
+71
+4 #free data cluster
+73
+4 #free data cluster
+75
+4 #free data cluster
+77
+4 #free data cluster
+79
+4 #free data cluster
+81
+4 #free data cluster
+83
+4 #free data cluster
+85
+4 #free data cluster
+87
+4 #free data cluster
+89
+4 #free data cluster
+91
+4 #free data cluster
+93
+4 #free data cluster
+95
+4 #free data cluster
+97
+4 #free data cluster
+99
+4 #free data cluster
+101
+4 #free data cluster
+103
+4 #free data cluster
+105
+4 #free data cluster
+107
+4 #free data cluster
+109
+4 #free data cluster
+111
+4 #free data cluster
+113
+4 #free data cluster
+115
+4 #free data cluster
+117
+4 #free data cluster
+119
+4 #free data cluster
+121
+4 #free data cluster
+123
+4 #free data cluster
+125
+4 #free data cluster
+127
+4 #free data cluster
+129
+4 #free data cluster
+128
+4 #free data cluster
+126
+4 #free data cluster
+124
+4 #free data cluster
+122
+4 #free data cluster
+120
+4 #free data cluster
+118
+4 #free data cluster
+116
+4 #free data cluster
+114
+4 #free data cluster
+112
+4 #free data cluster
+110
+4 #free data cluster
+108
+4 #free data cluster
+106
+4 #free data cluster
+104
+4 #free data cluster
+102
+4 #free data cluster
+100
+4 #free data cluster
+98
+4 #free data cluster
+96
+4 #free data cluster
+94
+4 #free data cluster
+92
+4 #free data cluster
+90
+4 #free data cluster
+88
+4 #free data cluster
+86
+4 #free data cluster
+84
+4 #free data cluster
+82
+4 #free data cluster
+80
+4 #free data cluster
+78
+4 #free data cluster
+76
+4 #free data cluster
+74
+4 #free data cluster
+72
+4 #free data cluster
+70
+4 #free data cluster
+68
+4 #free data cluster
+66
+4 #free data cluster
+64
+4 #free data cluster
+62
+4 #free data cluster
+60
+4 #free data cluster
+58
+4 #free data cluster
+56
+4 #free data cluster
+54
+4 #free data cluster
+52
+4 #free data cluster
+50
+4 #free data cluster
+48
+4 #free data cluster
+46
+4 #free data cluster
+44
+4 #free data cluster
+42
+4 #free data cluster
+40
+4 #free data cluster
+38
+4 #free data cluster
+36
+4 #free data cluster
+34
+4 #free data cluster
+32
+4 #free data cluster
+30
+4 #free data cluster
+28
+4 #free data cluster
+26
+4 #free data cluster
+24
+4 #free data cluster
+22
+4 #free data cluster
+20
+4 #free data cluster
+18
+4 #free data cluster
+16
+4 #free data cluster
+14
+4 #free data cluster
+12
+4 #free data cluster
+10
+4 #free data cluster
+8
+4 #free data cluster
+6
+4 #free data cluster
+4
+4 #free data cluster
+2
+4 #free data cluster (it is going to fail - the data cluster is already free)
+64
+4 #free data cluster (it is going to fail - the data cluster is the root directory one)
+0
+4 #free data cluster (it is going to fail - the data cluster does not exist)
+130
+3 #alloc data cluster
+3 #alloc data cluster
+3 #alloc data cluster
+0
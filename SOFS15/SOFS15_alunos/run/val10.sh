@@ -0,0 +1,38 @@
+#!/bin/bash
+
+# This test vector checks if FUSE can mount again a storage device formatted with a bitmap of free data clusters
+# after it was not properly unmounted: the mount flag of the superblock is left set and the superblock must pass the
+# quick consistency check for that format on the next mount.
+# Basic system calls involved: mknode, write, read and readdir.
+
+echo -e '\n**** Creating the storage device.****\n'
+./createEmptyFile myDisk 300
+echo -e '\n**** Converting the storage device into a SOFS15 file system with a bitmap of free data clusters.****\n'
+./mkfs_sofs15 -i 56 -f bitmap -z myDisk
+echo -e '\n**** Mounting the storage device as a SOFS15 file system.****\n'
+./mount_sofs15 myDisk mnt
+echo -e '\n**** Writing a file of 5000 bytes.****\n'
+head -c 5000 /dev/urandom > /tmp/val10.dat
+cp /tmp/val10.dat mnt/file
+sleep 1
+echo -e '\n**** Killing the file system daemon, so that the storage device is not properly unmounted.****\n'
+pkill -KILL -f 'mount_sofs15 myDisk mnt'
+sleep 1
+fusermount -u -z mnt
+echo -e '\n**** Showing the superblock: the mount flag must be NPRU.****\n'
+./showblock_sofs15 -s 0 myDisk
+echo -e '\n**** Mounting the storage device again.****\n'
+./mount_sofs15 myDisk mnt
+echo -e '\n**** Listing the root directory.****\n'
+ls -la mnt
+echo -e '\n**** Checking that the file reads back as it was written.****\n'
+if cmp -s mnt/file /tmp/val10.dat
+   then echo 'The file reads back as it was written.'
+   else echo 'The file does not read back as it was written!'
+fi
+rm -f /tmp/val10.dat
+echo -e '\n**** Unmounting the storage device.****\n'
+sleep 1
+fusermount -u mnt
+echo -e '\n**** Showing the superblock: the mount flag must be PRU.****\n'
+./showblock_sofs15 -s 0 myDisk
@@ -0,0 +1,29 @@
+#!/bin/bash
+
+# This test vector checks that the holes of a file read back as zeros when the data clusters which are
+# allocated for them were used before by another file.
+# Basic system calls involved: mknode, read, write and unlink.
+
+echo -e '\n**** Creating the storage device.****\n'
+./createEmptyFile myDisk 300
+echo -e '\n**** Converting the storage device into a SOFS15 file system.****\n'
+./mkfs_sofs15 -i 56 -z myDisk
+echo -e '\n**** Mounting the storage device as a SOFS15 file system.****\n'
+./mount_sofs15 myDisk mnt
+echo -e '\n**** Filling in the data zone with a file of random bytes and removing it.****\n'
+dd if=/dev/urandom of=mnt/fill bs=1024 count=120 2>/dev/null
+rm mnt/fill
+echo -e '\n**** Writing 3000 bytes at the beginning of a new file and 5000 bytes past its end.****\n'
+dd if=/dev/urandom of=mnt/hole bs=1000 count=3 2>/dev/null
+dd if=/dev/urandom of=mnt/hole bs=1000 count=5 seek=5 conv=notrunc 2>/dev/null
+sleep 1
+echo -e '\n**** Getting the file attributes.****\n'
+stat mnt/hole
+echo -e '\n**** Checking that the hole between both writes reads back as zeros.****\n'
+if dd if=mnt/hole bs=1000 skip=3 count=2 2>/dev/null | cmp -s - <(head -c 2000 /dev/zero)
+   then echo 'The hole reads back as zeros.'
+   else echo 'The hole does not read back as zeros!'
+fi
+echo -e '\n**** Unmounting the storage device.****\n'
+sleep 1
+fusermount -u mnt
@@ -0,0 +1,315 @@
+/**
+ *  \file benchcache_sofs15.c (implementation file)
+ *
+ *  \brief The SOFS15 buffercache thread-scaling benchmark.
+ *
+ *  It measures the throughput of the buffercache when it is accessed by a growing number of threads, from one up to a
+ *  given maximum, doubling at each step, and compares a storage area with a single shard, where all accesses contend
+ *  for the same locking flag, with one split in a given number of shards.
+ *  Every thread accesses random blocks among the first ones of the storage device; the storage area is loaded with
+ *  them before the measurement starts, so that, if they fit in it, the throughput is limited by the buffercache alone.
+ *  A write access writes back the contents of the block as it was just read, so the supporting file is left unchanged.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                   benchcache_sofs15 [OPTIONS] supp-file
+ *
+ *                OPTIONS:
+ *                 -s blocks  --- number of blocks of the storage area (default: 4096)
+ *                 -b blocks  --- number of blocks accessed (default: the number of blocks of the storage area)
+ *                 -p shards  --- number of shards of the storage area compared with a single one (default: 8)
+ *                 -t threads --- maximum number of threads (default: 32)
+ *                 -o ops     --- number of accesses per thread (default: 200000)
+ *                 -w percent --- percentage of write accesses (default: 0)
+ *                 -h         --- print this help.</PRE>
+ *
+ *  \remarks The flusher thread is disabled, so the write accesses only mark the blocks as changed; they are written to
+ *           the storage device when the storage area is closed at the end of each measurement.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+
+/** \brief default number of blocks of the storage area */
+#define BENCH_CACHE_SIZE  4096
+/** \brief maximum number of threads */
+#define MAX_THREADS       64
+/** \brief default number of accesses per thread */
+#define BENCH_OPS         200000
+
+/** \brief Definition of the worker thread parameters data type. */
+typedef struct worker
+{
+   /** \brief thread identification */
+    pthread_t thr;
+   /** \brief seed of the random number generator */
+    unsigned int seed;
+   /** \brief status of the accesses */
+    int status;
+} WORKER;
+
+/*
+ *  Benchmark parameters
+ */
+/** \brief Number of blocks accessed */
+static uint32_t span = 0;
+/** \brief Number of accesses per thread */
+static uint32_t nOps = BENCH_OPS;
+/** \brief Percentage of write accesses */
+static uint32_t wPercent = 0;
+/** \brief Synchronization point of the start of the worker threads */
+static pthread_barrier_t start;
+
+/* Allusion to internal functions */
+
+static int measure (const char *devname, uint32_t shards, uint32_t nThreads, double *p_rate);
+static void *worker (void *arg);
+static double getTime (void);
+static void printUsage (char *cmd_name);
+static void printError (int errcode, char *cmd_name);
+
+/* The main function */
+
+int main (int argc, char *argv[])
+{
+  uint32_t size = BENCH_CACHE_SIZE;              /* number of blocks of the storage area */
+  uint32_t shards = DEF_CACHE_SHARDS;            /* number of shards compared with a single one */
+  uint32_t maxThreads = 32;                      /* maximum number of threads */
+  int64_t val;                                   /* value of a numeric option */
+
+  /* process command line options */
+
+  int opt;                                       /* selected option */
+
+  do
+  { switch ((opt = getopt (argc, argv, "s:b:p:t:o:w:h")))
+    { case 's': /* number of blocks of the storage area */
+                if (((val = atoll (optarg)) <= 0) || (val > UINT32_MAX))
+                   { fprintf (stderr, "%s: Bad argument to s option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                size = (uint32_t) val;
+                break;
+      case 'b': /* number of blocks accessed */
+                if (((val = atoll (optarg)) <= 0) || (val > UINT32_MAX))
+                   { fprintf (stderr, "%s: Bad argument to b option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                span = (uint32_t) val;
+                break;
+      case 'p': /* number of shards */
+                if (((val = atoll (optarg)) <= 0) || (val > MAX_CACHE_SHARDS))
+                   { fprintf (stderr, "%s: Bad argument to p option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                shards = (uint32_t) val;
+                break;
+      case 't': /* maximum number of threads */
+                if (((val = atoll (optarg)) <= 0) || (val > MAX_THREADS))
+                   { fprintf (stderr, "%s: Bad argument to t option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                maxThreads = (uint32_t) val;
+                break;
+      case 'o': /* number of accesses per thread */
+                if (((val = atoll (optarg)) <= 0) || (val > UINT32_MAX))
+                   { fprintf (stderr, "%s: Bad argument to o option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nOps = (uint32_t) val;
+                break;
+      case 'w': /* percentage of write accesses */
+                if (((val = atoll (optarg)) < 0) || (val > 100) || ((val == 0) && (*optarg != '0')))
+                   { fprintf (stderr, "%s: Bad argument to w option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                wPercent = (uint32_t) val;
+                break;
+      case 'h': /* help mode */
+                printUsage (basename (argv[0]));
+                return EXIT_SUCCESS;
+      case -1:  break;
+      default:  fprintf (stderr, "%s: Wrong option.\n", basename (argv[0]));
+                printUsage (basename (argv[0]));
+                return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+  if ((argc - optind) != 1)                      /* check existence of mandatory argument: supporting file name */
+     { fprintf (stderr, "%s: Wrong number of mandatory arguments.\n", basename (argv[0]));
+       printUsage (basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (span == 0)
+     span = size;
+
+  /* check the storage device */
+
+  uint32_t nBlocks;                              /* number of blocks of the storage device */
+  int status;                                    /* status of operation */
+
+  if ((status = soOpenDevice (argv[optind], &nBlocks)) != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  soCloseDevice ();
+  if (span > nBlocks)
+     span = nBlocks;
+
+  /* measure the throughput for every number of threads, with a single shard and with the given number of shards */
+
+  double rate1, rateN;                           /* accesses per second with one shard and with the given number */
+  uint32_t n;                                    /* number of threads */
+
+  if (((status = soSetBufferCacheSize (size)) != 0) ||
+      ((status = soSetBufferCacheFlush (0, DEF_DIRTY_RATIO, DEF_DIRTY_LIMIT)) != 0) ||
+      ((status = soSetBufferCacheReadAhead (0)) != 0))
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  printf ("%"PRIu32" accesses per thread to %"PRIu32" blocks (%"PRIu32"%% writes), storage area of %"PRIu32" blocks\n",
+          nOps, span, wPercent, size);
+  printf ("%7s %16s %16s %8s\n", "threads", "1 shard (op/s)", "shards (op/s)", "speedup");
+  for (n = 1; n <= maxThreads; n *= 2)
+  { if (((status = measure (argv[optind], 1, n, &rate1)) != 0) ||
+        ((status = measure (argv[optind], shards, n, &rateN)) != 0))
+       { printError (status, basename (argv[0]));
+         return EXIT_FAILURE;
+       }
+    printf ("%7"PRIu32" %16.0f %16.0f %7.2fx\n", n, rate1, rateN, rateN / rate1);
+  }
+  printf ("(%"PRIu32" shards were requested)\n", shards);
+
+  /* that's all */
+
+  return EXIT_SUCCESS;
+
+} /* end of main */
+
+/*
+ * measure the throughput of a storage area with a given number of shards accessed by a given number of threads
+ */
+
+static int measure (const char *devname, uint32_t shards, uint32_t nThreads, double *p_rate)
+{
+  WORKER w[MAX_THREADS];                         /* worker threads */
+  unsigned char buffer[BLOCK_SIZE];              /* buffer to store block contents */
+  double t0, t1;                                 /* time the measurement starts and ends */
+  uint32_t i;                                    /* counter */
+  int status;                                    /* status of operation */
+
+  if (((status = soSetBufferCacheShards (shards)) != 0) || ((status = soOpenBufferCache (devname, BUF)) != 0))
+     return status;
+
+  /* load the storage area with the blocks accessed */
+
+  for (i = 0; i < span; i++)
+    if ((status = soReadCacheBlock (i, buffer)) != 0)
+       { soCloseBufferCache ();
+         return status;
+       }
+
+  /* start the worker threads all at once and wait for them to finish */
+
+  pthread_barrier_init (&start, NULL, nThreads + 1);
+  for (i = 0; i < nThreads; i++)
+  { w[i].seed = 2 * i + 1;
+    w[i].status = 0;
+    if ((status = pthread_create (&w[i].thr, NULL, worker, &w[i])) != 0)
+       { fprintf (stderr, "Unable to create worker thread.\n");
+         exit (EXIT_FAILURE);
+       }
+  }
+  pthread_barrier_wait (&start);
+  t0 = getTime ();
+  for (i = 0; i < nThreads; i++)
+  { pthread_join (w[i].thr, NULL);
+    if ((status == 0) && (w[i].status != 0))
+       status = w[i].status;
+  }
+  t1 = getTime ();
+  pthread_barrier_destroy (&start);
+
+  if (status != 0)
+     { soCloseBufferCache ();
+       return status;
+     }
+  *p_rate = ((double) nOps * nThreads) / (t1 - t0);
+
+  return soCloseBufferCache ();
+}
+
+/*
+ * life cycle of a worker thread: random accesses to the blocks
+ */
+
+static void *worker (void *arg)
+{
+  WORKER *w = (WORKER *) arg;                    /* parameters of the thread */
+  unsigned char buffer[BLOCK_SIZE];              /* buffer to store block contents */
+  uint32_t i, n;                                 /* counter and block number */
+
+  pthread_barrier_wait (&start);
+  for (i = 0; (i < nOps) && (w->status == 0); i++)
+  { n = (uint32_t) rand_r (&w->seed) % span;
+    w->status = soReadCacheBlock (n, buffer);
+    if ((w->status == 0) && (wPercent != 0) && (((uint32_t) rand_r (&w->seed) % 100) < wPercent))
+       w->status = soWriteCacheBlock (n, buffer);
+  }
+
+  return NULL;
+}
+
+/*
+ * get the present time in seconds
+ */
+
+static double getTime (void)
+{
+  struct timespec ts;                            /* present time */
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * print help message
+ */
+
+static void printUsage (char *cmd_name)
+{
+  printf ("Sinopsis: %s [OPTIONS] supp-file\n"
+          "  OPTIONS:\n"
+          "  -s blocks  --- number of blocks of the storage area (default: %d)\n"
+          "  -b blocks  --- number of blocks accessed (default: the number of blocks of the storage area)\n"
+          "  -p shards  --- number of shards of the storage area compared with a single one (default: %d)\n"
+          "  -t threads --- maximum number of threads (default: 32)\n"
+          "  -o ops     --- number of accesses per thread (default: %d)\n"
+          "  -w percent --- percentage of write accesses (default: 0)\n"
+          "  -h         --- print this help\n", cmd_name, BENCH_CACHE_SIZE, DEF_CACHE_SHARDS, BENCH_OPS);
+}
+
+/*
+ * print error message
+ */
+
+static void printError (int errcode, char *cmd_name)
+{
+  fprintf(stderr, "%s: error #%d - %s.\n", cmd_name, -errcode, strerror (-errcode));
+}
@@ -18,6 +18,7 @@
  *                OPTIONS:
  *                 -n name --- set volume name (default: "SOFS15")
  *                 -i num  --- set number of inodes (default: N/8, where N = number of blocks)
+ *                 -f fmt  --- set format of the free data clusters metadata: table or bitmap (default: table)
  *                 -z      --- set zero mode (default: not zero)
  *                 -q      --- set quiet mode (default: not quiet)
  *                 -h      --- print this help.</PRE>
@@ -46,14 +47,18 @@
 #include "sofs_direntry.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_bitmap.h"
 
 /* Allusion to internal functions */
 
+static uint32_t fcBlocks (uint32_t nclusttotal, uint32_t fcformat);
 static int fillInSuperBlock (SOSuperBlock *p_sb, uint32_t ntotal, uint32_t itotal, uint32_t fcblktotal,
-		                     uint32_t nclusttotal, unsigned char *name);
+		                     uint32_t nclusttotal, uint32_t fcformat, uint32_t dzcache, unsigned char *name);
 static int fillInINT (SOSuperBlock *p_sb);
 static int fillInRootDir (SOSuperBlock *p_sb);
 static int fillInTRefFDC (SOSuperBlock *p_sb, int zero);
+static int fillInBitmap (SOSuperBlock *p_sb, int zero);
+static int zeroFreeClusters (SOSuperBlock *p_sb);
 static int checkFSConsist (void);
 static void printUsage (char *cmd_name);
 static void printError (int errcode, char *cmd_name);
@@ -66,13 +71,15 @@ int main (int argc, char *argv[])
   uint32_t itotal = 0;                           /* total number of inodes, if kept, set value automatically */
   int quiet = 0;                                 /* quiet mode, if kept, set not quiet mode */
   int zero = 0;                                  /* zero mode, if kept, set not zero mode */
+  uint32_t fcformat = FC_TABLE;                  /* format of the free data clusters metadata, if kept, set table */
+  uint32_t dzcache = DZONE_CACHE_SIZE;           /* number of references the caches hold, if kept, set the largest */
 
   /* process command line options */
 
   int opt;                                       /* selected option */
 
   do
-  { switch ((opt = getopt (argc, argv, "n:i:qzh")))
+  { switch ((opt = getopt (argc, argv, "n:i:f:c:qzh")))
     { case 'n': /* volume name */
                 name = optarg;
                 break;
@@ -84,6 +91,25 @@ int main (int argc, char *argv[])
                    }
                 itotal = (uint32_t) atoi (optarg);
                 break;
+      case 'f': /* format of the free data clusters metadata */
+                if (strcmp (optarg, "table") == 0)
+                   fcformat = FC_TABLE;
+                   else if (strcmp (optarg, "bitmap") == 0)
+                           fcformat = FC_BITMAP;
+                           else { fprintf (stderr, "%s: Wrong format of the free data clusters metadata.\n",
+                                           basename (argv[0]));
+                                  printUsage (basename (argv[0]));
+                                  return EXIT_FAILURE;
+                                }
+                break;
+      case 'c': /* number of references the caches hold */
+                if ((atoi (optarg) < 1) || (atoi (optarg) > DZONE_CACHE_SIZE))
+                   { fprintf (stderr, "%s: Cache size out of range (1 to %d).\n", basename (argv[0]), DZONE_CACHE_SIZE);
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                dzcache = (uint32_t) atoi (optarg);
+                break;
       case 'q': /* quiet mode */
                 quiet = 1;                       /* set quiet mode for processing: no messages are issued */
                 break;
@@ -126,11 +152,13 @@ int main (int argc, char *argv[])
   /* evaluating the file system architecture parameters
    * full occupation of the storage device when seen as an array of blocks supposes that the equation bellow
    *
-   *    NTBlk = 1 + sige(NTClt/RPB) + NBlkTIN + NTClt*BLOCKS_PER_CLUSTER
+   *    NTBlk = 1 + F(NTClt) + NBlkTIN + NTClt*BLOCKS_PER_CLUSTER
    *
    *    where NTBlk means total number of blocks
    *          NTClt means total number of clusters of the data zone
-   *          RPB means total number of references to clusters which can be stored in a block
+   *          F(NTClt) means number of blocks required to store the free data clusters metadata: sige(NTClt/RPB) for
+   *                   the table of references, where RPB means total number of references to clusters which can be
+   *                   stored in a block, or the size of the bitmap and its summary
    *          NBlkTIN means total number of blocks required to store the inode table
    *          BLOCKS_PER_CLUSTER means number of blocks which fit in a cluster
    *          sige (.) means the smallest integer greater or equal to the argument
@@ -154,16 +182,12 @@ int main (int argc, char *argv[])
      else iblktotal = itotal / IPB + 1;
                                                  /* step number 1 */
   tmp = (ntotal - 1 - iblktotal) / BLOCKS_PER_CLUSTER;
-  if ((tmp % RPB) == 0)
-	 fcblktotal = tmp / RPB;
-     else fcblktotal = tmp / RPB + 1;
+  fcblktotal = fcBlocks (tmp, fcformat);
                                                  /* step number 2 */
   nclusttotal = (ntotal - 1 - iblktotal - fcblktotal) / BLOCKS_PER_CLUSTER;
-  if ((nclusttotal % RPB) == 0)
-	 fcblktotal = nclusttotal / RPB;
-     else fcblktotal = nclusttotal / RPB + 1;
+  fcblktotal = fcBlocks (nclusttotal, fcformat);
                                                  /* step number 3 */
-  if ((nclusttotal % RPB) != 0)
+  if (fcBlocks (nclusttotal + 1, fcformat) == fcblktotal)
      { if ((ntotal - 1 - iblktotal - fcblktotal - nclusttotal * BLOCKS_PER_CLUSTER) >= BLOCKS_PER_CLUSTER)
           nclusttotal += 1;
      }
@@ -174,10 +198,12 @@ int main (int argc, char *argv[])
   /* formatting of the storage device is going to start */
 
   SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  void *buf;                                     /* pointer to the pinned superblock */
   int status;                                    /* status of operation */
 
   if (!quiet)
-     printf("\e[34mInstalling a %"PRIu32"-inodes SOFS15 file system in %s.\e[0m\n", itotal, argv[optind]);
+     printf("\e[34mInstalling a %"PRIu32"-inodes SOFS15 file system in %s, with %d-byte blocks and %d-block clusters.\e[0m\n",
+            itotal, argv[optind], BLOCK_SIZE, BLOCKS_PER_CLUSTER);
 
   /* open a buffered communication channel with the storage device */
 
@@ -186,6 +212,19 @@ int main (int argc, char *argv[])
        return EXIT_FAILURE;
      }
 
+  /* invalidate the magic number, so that a storage device formatted with another geometry may be formatted again */
+
+  if ((status = soGetCacheBlock (0, &buf)) == 0)
+     { ((SOSuperBlock *) buf)->magic = 0xFFFF;
+       status = soMarkCacheBlock (0);
+       soPutCacheBlock (0);
+     }
+  if (status != 0)
+     { printError (status, basename (argv[0]));
+       soCloseBufferCache ();
+       return EXIT_FAILURE;
+     }
+
   /* read the contents of the superblock to the internal storage area
    * this operation only serves at present time to get a pointer to the superblock storage area in main memory
    */
@@ -204,7 +243,8 @@ int main (int argc, char *argv[])
        fflush (stdout);                          /* make sure the message is printed now */
      }
 
-  if ((status = fillInSuperBlock (p_sb, ntotal, itotal, fcblktotal, nclusttotal, (unsigned char *) name)) != 0)
+  if ((status = fillInSuperBlock (p_sb, ntotal, itotal, fcblktotal, nclusttotal, fcformat, dzcache,
+                                  (unsigned char *) name)) != 0)
      { printError (status, basename (argv[0]));
        soCloseBufferCache ();
        return EXIT_FAILURE;
@@ -248,17 +288,22 @@ int main (int argc, char *argv[])
   if (!quiet) printf ("done.\n");
 
   /*
-   * create the table of references to free data clusters as a static linear FIFO
+   * create the table of references to free data clusters as a static linear FIFO, or the bitmap of free data clusters
    * zero fill the remaining data clusters if full formating was required:
    *   zero mode was selected
    */
 
   if (!quiet)
-     { printf ("Filling in the contents of the table of references to free data clusters ... ");
+     { if (fcformat == FC_BITMAP)
+          printf ("Filling in the contents of the bitmap of free data clusters ... ");
+          else printf ("Filling in the contents of the table of references to free data clusters ... ");
        fflush (stdout);                          /* make sure the message is printed now */
      }
 
-  if ((status = fillInTRefFDC (p_sb, zero)) != 0)
+  if (fcformat == FC_BITMAP)
+     status = fillInBitmap (p_sb, zero);
+     else status = fillInTRefFDC (p_sb, zero);
+  if (status != 0)
      { printError (status, basename (argv[0]));
        soCloseBufferCache ();
        return EXIT_FAILURE;
@@ -313,9 +358,23 @@ static void printUsage (char *cmd_name)
           "  OPTIONS:\n"
           "  -n name --- set volume name (default: \"SOFS15\")\n"
           "  -i num  --- set number of inodes (default: N/8, where N = number of blocks)\n"
+          "  -f fmt  --- set format of the free data clusters metadata: table or bitmap (default: table)\n"
+          "  -c num  --- set number of references the caches of free data clusters hold (default: %d)\n"
           "  -z      --- set zero mode (default: not zero)\n"
           "  -q      --- set quiet mode (default: not quiet)\n"
-          "  -h      --- print this help\n", cmd_name);
+          "  -h      --- print this help\n", cmd_name, DZONE_CACHE_SIZE);
+}
+
+/*
+ * number of blocks required to store the free data clusters metadata
+ */
+
+static uint32_t fcBlocks (uint32_t nclusttotal, uint32_t fcformat)
+{
+  if (fcformat == FC_BITMAP)
+     return soBitmapSize (nclusttotal);
+
+  return (nclusttotal + RPB - 1) / RPB;
 }
 
 /*
@@ -335,7 +394,7 @@ static void printError (int errcode, char *cmd_name)
    */
 
 static int fillInSuperBlock (SOSuperBlock *p_sb, uint32_t ntotal, uint32_t itotal, uint32_t fcblktotal,
-		                     uint32_t nclusttotal, unsigned char *name)
+		                     uint32_t nclusttotal, uint32_t fcformat, uint32_t dzcache, unsigned char *name)
 {
   unsigned int i;
 
@@ -389,9 +448,21 @@ static int fillInSuperBlock (SOSuperBlock *p_sb, uint32_t ntotal, uint32_t itota
   p_sb->tbfreeclust_tail = 0;// p_sb->dzone_total - 1;
 
   p_sb->dzone_start = p_sb->tbfreeclust_start + p_sb->tbfreeclust_size; /* numero fisico onde se inicia a zona de dados */
+
+  /*geometry*/
+
+  p_sb->bsize = BLOCK_SIZE; /* tamanho do bloco em bytes */
+
+  p_sb->bpc = BLOCKS_PER_CLUSTER; /* numero de blocos de um cluster */
+
+  /*free data clusters metadata*/
+
+  p_sb->fcformat = fcformat; /* tabela de referencias ou bitmap */
+
+  p_sb->dzcache_size = dzcache; /* numero de referencias que as caches guardam */
   
-  for(i=0; i < (BLOCK_SIZE - PARTITION_NAME_SIZE - 1 - 16 * sizeof(uint32_t) - 2 * sizeof(struct fCNode));i++){
-    p_sb->reserved[i] = 0xEE;
+  for(i=0; i < sizeof(p_sb->reserved);i++){
+    p_sb->reserved[i] = RESERVED_FILL;
   }
 
   return 0;
@@ -526,18 +597,9 @@ static int fillInTRefFDC (SOSuperBlock *p_sb, int zero)
 {
   int i, j, k, error;
   uint32_t *ref;
-  SODataClust c; //cluster
-
-  if(zero){ //escrever 0 em tudo
 
-    for (i = 0;i < BSLPC; i++) //percorrer o array data[]
-      c.data[i] = 0;
-
-    for(i = p_sb->dzone_start + 4; i <  (p_sb->dzone_start + p_sb->dzone_total * 4); i += 4){  //percorrer todos os clusters e guardar
-      if ((error = soWriteCacheCluster(i, &c)) != 0)
-        return error;
-    }
-  }
+  if(zero && (error = zeroFreeClusters(p_sb)) != 0) //escrever 0 em tudo
+    return error;
 
   for(i = 0; i < p_sb->tbfreeclust_size; i++){ //passar por todos os blocos
 
@@ -561,6 +623,70 @@ static int fillInTRefFDC (SOSuperBlock *p_sb, int zero)
   return 0;
 }
 
+/*
+ * create the bitmap of free data clusters and its summary:
+ *   all data clusters are free, but the first one, which holds the root directory
+ * zero fill the remaining data clusters if full formating was required:
+ *   zero mode was selected
+ */
+
+static int fillInBitmap (SOSuperBlock *p_sb, int zero)
+{
+  uint32_t nbmp;                                 /* number of blocks of the bitmap proper */
+  uint32_t nblk;                                 /* physical number of the block */
+  uint32_t n, k, m;                              /* counters */
+  uint32_t *w;                                   /* pointer to the contents of the block */
+  void *buf;                                     /* pointer to the pinned block */
+  int status;                                    /* status of operation */
+
+  if (zero && ((status = zeroFreeClusters (p_sb)) != 0))
+     return status;
+
+  nbmp = (p_sb->dzone_total + BPB - 1) / BPB;
+  for (n = 0; n < p_sb->tbfreeclust_size; n++)
+  { nblk = p_sb->tbfreeclust_start + n;
+    if ((status = soGetCacheBlock (nblk, &buf)) != 0)
+       return status;
+    w = buf;
+    memset (w, 0, BLOCK_SIZE);
+    if (n < nbmp)                                /* block of the bitmap: a bit set per free data cluster */
+       { m = (p_sb->dzone_total - n * BPB < BPB) ? p_sb->dzone_total - n * BPB : BPB;
+         for (k = 0; k < m; k++)
+           w[k >> 5] |= 1U << (k & 31);
+         if (n == 0) w[0] &= ~1U;
+       }
+       else for (k = 0; (k < RPB) && ((m = (n - nbmp) * RPB + k) < nbmp); k++)
+            { w[k] = (m == nbmp - 1) ? p_sb->dzone_total - m * BPB : BPB;
+              if (m == 0) w[k] -= 1;             /* block of the summary: the number of free data clusters */
+            }
+    status = soMarkCacheBlock (nblk);
+    soPutCacheBlock (nblk);
+    if (status != 0)
+       return status;
+  }
+
+  return 0;
+}
+
+/*
+ * zero fill all data clusters, but the first one, which holds the root directory
+ */
+
+static int zeroFreeClusters (SOSuperBlock *p_sb)
+{
+  uint32_t i;                                    /* physical number of the first block of the data cluster */
+  SODataClust c;                                 /* contents of the data cluster */
+  int error;                                     /* status of operation */
+
+  memset (c.data, 0, BSLPC);
+  for (i = p_sb->dzone_start + BLOCKS_PER_CLUSTER; i < p_sb->dzone_start + p_sb->dzone_total * BLOCKS_PER_CLUSTER;
+       i += BLOCKS_PER_CLUSTER)
+    if ((error = soWriteCacheCluster (i, &c)) != 0)
+       return error;
+
+  return 0;
+}
+
 /*
  * check the consistency of the file system metadata
  */
@@ -578,7 +704,7 @@ static int checkFSConsist (void)
 
   /* check superblock and related structures */
 
-if ((stat = soQCheckSuperBlock (p_sb)) != 0) return stat;
+if ((stat = soQCheck (QC_SUPERBLOCK)) != 0) return stat;
 
   /* read the contents of the first block of the inode table to the internal storage area and get a pointer to it */
 
@@ -18,6 +18,8 @@
  *                OPTIONS:
  *                 -n name --- set volume name (default: "SOFS15")
  *                 -i num  --- set number of inodes (default: N/8, where N = number of blocks)
+ *                 -f fmt  --- set format of the free data clusters metadata: table or bitmap (default: table)
+ *                 -c num  --- set number of references the caches of free data clusters hold (default: 50)
  *                 -z      --- set zero mode (default: not zero)
  *                 -q      --- set quiet mode (default: not quiet)
  *                 -h      --- print this help.</PRE>
@@ -12,8 +12,16 @@
  *                 -d       --- set debugging mode (default: no debugging)
  *                 -l depth --- set log depth (default: 0,0)
  *                 -L file  --- log file (default: stdout)
+ *                 -M mode  --- device backend: sync, uring, mmap or direct (default: sync)
+ *                 -r size  --- maximum number of clusters read ahead, up to 64; 0 disables read-ahead (default: 16)
+ *                 -c level --- quick consistency checks: always, store (again only after the superblock is stored)
+ *                              or mount (only once) (default: always)
  *                 -h       --- print this help.</PRE>
  *
+ *  The statistics of the buffercache and of the storage device may be read while the file system is mounted from the
+ *  extended attribute <tt>user.sofs.stats</tt> of the root directory (<tt>getfattr -n user.sofs.stats
+ *  mount-point</tt>), one counter per line, so that the size of the storage area may be tuned to the workload.
+ *
  *  \author Artur Carneiro Pereira - October 2005
  *  \author Miguel Oliveira e Silva - September 2009
  *  \author João Rodrigues - September 2009
@@ -33,7 +41,10 @@
 
 #include "sofs_probe.h"
 #include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
 #include "sofs_direntry.h"
+#include "sofs_basicoper.h"
 #include "sofs_syscalls.h"
 
 /*
@@ -42,6 +53,13 @@
 
 static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;                                         /* locking flag */
 
+/*
+ *  Statistics of the buffercache
+ */
+
+#define STATS_XATTR      "user.sofs.stats"                      /* extended attribute of the root which holds them */
+#define STATS_TEXT_SIZE  4096                                   /* upper bound of the size of their text */
+
 /*
  *  Allusion to FUSE callbacks and other internal functions
  */
@@ -79,6 +97,7 @@ static int sofs_getxattr (const char *ePath, const char *name, char *value, size
 static int sofs_listxattr (const char *ePath, char *list, size_t size);
 static int sofs_removexattr (const char *ePath, const char *name);
 static void printUsage (char *cmd_name);
+static int printStats (char *text, size_t size);
 
 /*
  *  Set of FUSE operations (required by the FUSE filesystem)
@@ -138,6 +157,9 @@ int main(int argc, char *argv[])
 {
   int lower = 0;                                 /* lower limit of log depth, if kept set to zero */
   int higher = 0;                                /* upper limit of log depth, if kept set to zero */
+  uint32_t mode;                                 /* device backend */
+  int window;                                    /* maximum number of clusters read ahead */
+  uint32_t level;                                /* level of the quick consistency checks */
   int debug_mode = 0;                            /* debugging mode, if kept set to zero */
   FILE *fl = NULL;                               /* log stream default */
 
@@ -146,7 +168,7 @@ int main(int argc, char *argv[])
   int opt;                                       /* selected option */
 
   do
-  { switch ((opt = getopt (argc, argv, "l:L:dh")))
+  { switch ((opt = getopt (argc, argv, "l:L:dM:r:c:h")))
     { case 'l': /* log depth */
                 if (sscanf (optarg, "%d,%d", &lower, &higher) != 2)
                    { fprintf (stderr, "%s: Bad argument to l option.\n", basename (argv[0]));
@@ -166,6 +188,42 @@ int main(int argc, char *argv[])
       case 'd': /* debugging mode */
                 debug_mode = 1;                  /* set debugging mode for processing: no FUSE messages are issued */
                 break;
+      case 'M': /* device backend */
+                if (strcmp (optarg, "sync") == 0)
+                   mode = RAW_SYNC;
+                   else if (strcmp (optarg, "uring") == 0)
+                           mode = RAW_URING;
+                   else if (strcmp (optarg, "mmap") == 0)
+                           mode = RAW_MMAP;
+                   else if (strcmp (optarg, "direct") == 0)
+                           mode = RAW_DIRECT;
+                   else { fprintf (stderr, "%s: Bad argument to M option.\n", basename (argv[0]));
+                          printUsage (basename (argv[0]));
+                          return EXIT_FAILURE;
+                        }
+                soSetDeviceMode (mode, 0);
+                break;
+      case 'r': /* read-ahead window */
+                if ((sscanf (optarg, "%d", &window) != 1) || (window < 0) || (window > MAX_READ_AHEAD))
+                   { fprintf (stderr, "%s: Bad argument to r option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                soSetBufferCacheReadAhead ((uint32_t) window);
+                break;
+      case 'c': /* level of the quick consistency checks */
+                if (strcmp (optarg, "always") == 0)
+                   level = QCHECK_ALWAYS;
+                   else if (strcmp (optarg, "store") == 0)
+                           level = QCHECK_STORE;
+                   else if (strcmp (optarg, "mount") == 0)
+                           level = QCHECK_MOUNT;
+                   else { fprintf (stderr, "%s: Bad argument to c option.\n", basename (argv[0]));
+                          printUsage (basename (argv[0]));
+                          return EXIT_FAILURE;
+                        }
+                soSetQCheckLevel (level);
+                break;
       case 'h': /* help mode */
                 printUsage (basename (argv[0]));
                 return EXIT_SUCCESS;
@@ -217,7 +275,61 @@ static void printUsage (char *cmd_name)
           "  -d       --- set debugging mode (default: no debugging)\n"
           "  -l depth --- set log depth (default: 0,0)\n"
           "  -L file  --- log file (default: stdout)\n"
-          "  -h       --- print this help\n", cmd_name);
+          "  -M mode  --- device backend: sync, uring, mmap or direct (default: sync)\n"
+          "  -r size  --- maximum number of clusters read ahead, up to %d; 0 disables read-ahead (default: %d)\n"
+          "  -c level --- quick consistency checks: always, store (again only after the superblock is stored)\n"
+          "               or mount (only once) (default: always)\n"
+          "  -h       --- print this help\n", cmd_name, MAX_READ_AHEAD, DEF_READ_AHEAD);
+}
+
+/*
+ * print the statistics of the buffercache and of the storage device, one counter per line with a fixed width, so that
+ * the length of the text does not change from one call to the next
+ */
+
+static int printStats (char *text, size_t size)
+{
+  SOBufferCacheStats st;                         /* statistics */
+  char name[32];                                 /* name of a bucket of a latency histogram */
+  uint32_t i;                                    /* bucket counter */
+  int len = 0;                                   /* length of the text */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soGetBufferCacheStats (&st)) != 0)
+     return stat;
+
+#define PRINT_STAT(label,value) len += snprintf (text + len, size - len, "%-24s %20"PRIu64"\n", (label), \
+                                                 (uint64_t) (value))
+  PRINT_STAT ("cache.hits", st.nHits);
+  PRINT_STAT ("cache.misses", st.nMisses);
+  PRINT_STAT ("cache.evictions", st.nEvictions);
+  PRINT_STAT ("cache.writebacks", st.nWritebacks);
+  PRINT_STAT ("cache.writeback_ios", st.nWritebackIOs);
+  PRINT_STAT ("cache.writeback_bytes", st.bytesWriteback);
+  PRINT_STAT ("cache.writeback_avg_io", st.avgWritebackIO);
+  PRINT_STAT ("cache.flushes", st.nFlushes);
+  PRINT_STAT ("cache.readahead", st.nReadAhead);
+  PRINT_STAT ("cache.bytes_read", st.bytesRead);
+  PRINT_STAT ("cache.bytes_written", st.bytesWritten);
+  PRINT_STAT ("cache.nodes", st.nNodes);
+  PRINT_STAT ("cache.nodes_used", st.nUsed);
+  PRINT_STAT ("cache.nodes_dirty", st.nDirty);
+  PRINT_STAT ("device.reads", st.dev.nReads);
+  PRINT_STAT ("device.writes", st.dev.nWrites);
+  PRINT_STAT ("device.bytes_read", st.dev.bytesRead);
+  PRINT_STAT ("device.bytes_written", st.dev.bytesWritten);
+  PRINT_STAT ("device.syncs", st.dev.nSyncs);
+  for (i = 0; i < RAW_LAT_BUCKETS; i++)
+  { snprintf (name, sizeof (name), "device.read_us.%"PRIu32, (i == 0) ? 0 : 1U << (i - 1));
+    PRINT_STAT (name, st.dev.readLat[i]);
+  }
+  for (i = 0; i < RAW_LAT_BUCKETS; i++)
+  { snprintf (name, sizeof (name), "device.write_us.%"PRIu32, (i == 0) ? 0 : 1U << (i - 1));
+    PRINT_STAT (name, st.dev.writeLat[i]);
+  }
+#undef PRINT_STAT
+
+  return (len < (int) size) ? len : -ERANGE;
 }
 
 /* Functions to be implemented */
@@ -1066,14 +1178,34 @@ static int sofs_setxattr (const char *ePath, const char *name, const char *value
  *
  *  Equivalent to getxattr (man 2 getxattr).
  *
- *  \remarks UNIMPLEMENTED.
+ *  The only extended attribute is the one of the root directory which holds the statistics of the buffercache and of
+ *  the storage device, as text. They are taken without entering the critical region, since the buffercache has its
+ *  own locking flags.
+ *
+ *  \param ePath path to the file
+ *  \param name name of the extended attribute
+ *  \param value pointer to a buffer where the value is to be stored
+ *  \param size size of the buffer (\c 0 means only the size of the value is required)
+ *
+ *  \return the size of the value, on success, and a negative value, on error
  */
 
 static int sofs_getxattr (const char *ePath, const char *name, char *value, size_t size)
 {
   soColorProbe (139, "07;31", "sofs_getxattr_bin (\"%s\", \"%s\", %p, %"PRIu32")\n", ePath, name, value, (uint32_t) size);
 
-  return -ENOSYS;
+  char text[STATS_TEXT_SIZE];                    /* statistics of the buffercache */
+  int len;                                       /* length of the text */
+
+  if ((strcmp (ePath, "/") != 0) || (strcmp (name, STATS_XATTR) != 0))
+     return -ENODATA;
+  if ((len = printStats (text, sizeof (text))) < 0)
+     return len;
+  if (size == 0) return len;
+  if (size < (size_t) len) return -ERANGE;
+  memcpy (value, text, len);
+
+  return len;
 }
 
 /**
@@ -1081,14 +1213,26 @@ static int sofs_getxattr (const char *ePath, const char *name, char *value, size
  *
  *  Equivalent to listxattr (man 2 listxattr).
  *
- *  \remarks UNIMPLEMENTED.
+ *  Only the root directory has an extended attribute: the one which holds the statistics of the buffercache.
+ *
+ *  \param ePath path to the file
+ *  \param list pointer to a buffer where the list of names is to be stored
+ *  \param size size of the buffer (\c 0 means only the size of the list is required)
+ *
+ *  \return the size of the list, on success, and a negative value, on error
  */
 
 static int sofs_listxattr (const char *ePath, char *list, size_t size)
 {
-  soColorProbe (140, "07;31", "sofs_listxattr_bin (\"%s\", \"%s\", %"PRIu32")\n", ePath, list, (uint32_t) size);
+  soColorProbe (140, "07;31", "sofs_listxattr_bin (\"%s\", %p, %"PRIu32")\n", ePath, list, (uint32_t) size);
 
-  return -ENOSYS;
+  int len = (strcmp (ePath, "/") == 0) ? sizeof (STATS_XATTR) : 0;   /* size of the list, with the ending '\0' */
+
+  if (size == 0) return len;
+  if (size < (size_t) len) return -ERANGE;
+  memcpy (list, STATS_XATTR, len);
+
+  return len;
 }
 
 /**
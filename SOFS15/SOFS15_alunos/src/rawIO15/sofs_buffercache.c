@@ -0,0 +1,2368 @@
+/**
+ *  \file sofs_buffercache.c (implementation file)
+ *
+ *  \brief Access to buffered/unbuffered raw disk blocks and clusters.
+ *
+ *  The mean transfer time of a data block (cluster) between main memory and disk is typically at least tens of
+ *  thousands of times longer than the transfer time of an equal data block (cluster) between two different locations
+ *  in main memory.
+ *  Thus, the operating system tries to keep in a private storage area copies of the data blocks (clusters) whose
+ *  probability of access in the near future is higher.
+ *
+ *  The buffercache may be regarded as a storage area resident in main memory having the ability to store K data blocks
+ *  of the device's storage space. K is set by soSetBufferCacheSize before the storage area is initialized.
+ *  The storage area is organized in nodes which store a cluster each: the clusters of the nodes are shifted so that the
+ *  last one ends at the end of the storage device, which is where the data zone ends, so every data cluster is stored
+ *  in a single node and is transferred from / to the storage device in a single operation. A block is stored in the
+ *  node of the cluster it belongs to; each node keeps track of which of its blocks are stored and which were changed.
+ *  The nodes hold only the bookkeeping and are packed in an array, while their contents is kept in a separate arena,
+ *  mapped at once and backed by huge pages whenever it is large enough.
+ *  The storage area is split in shards, the cluster number modulo the number of shards selecting the shard a cluster
+ *  is stored in. Each shard is managed on its own, as described next, and has its own locking flag, so the accesses
+ *  to clusters of different shards do not contend.
+ *  The nodes of a shard are indexed by a hash table based on the number of the cluster, so the time it takes to find
+ *  out whether a block is stored does not depend on K, and are kept on a double-linked list based on the last access
+ *  time, whose tail is the node to be selected for replacement.
+ *  When the 2Q replacement policy is selected, a node is first stored on a FIFO list, <em>A1in</em>, taking up to a
+ *  fourth of the shard; only the clusters which are accessed again after being replaced from it, while they are still
+ *  remembered on a list of ghost entries, <em>A1out</em>, go to the list based on the last access time, <em>Am</em>.
+ *  So a sequential scan of a large file replaces only the nodes of <em>A1in</em>, while the frequently accessed
+ *  metadata stays on <em>Am</em>.
+ *  The nodes whose contents was changed are also kept on a double-linked list based on the time they were changed.
+ *  A flusher thread writes back the blocks which were changed longer ago than a given age and, whenever the number of
+ *  changed blocks of a shard exceeds a given fraction of it, the ones which were changed first. Writers are held back
+ *  while the number of changed blocks of the shard is above a second, higher, fraction.
+ *  Sequential access is detected on the node clusters: when a cluster is read right after the previous one, the
+ *  following clusters are read ahead into free nodes, in a window which starts small and doubles, up to a given
+ *  maximum, every time the reader gets to the first cluster of the previous window, which is when the next one is
+ *  read ahead. A read-ahead window is submitted as asynchronous transfers if the storage device is served by an
+ *  io_uring instance, the reader only waiting for a cluster when it gets to it before the transfer is complete;
+ *  otherwise, it is read by a single vectored transfer.
+ *  All operations on a shard are carried out in mutual exclusion and no operation, but the synchronization of the whole
+ *  storage area, which takes the access to all of them in order, has access to more than one shard at a time; the
+ *  flusher thread writes the blocks of a shard in small batches, releasing the access to it in between.
+ *  Changed blocks are written back sorted by block number, so that the ones which follow each other on the storage
+ *  device, even if they belong to different nodes, are gathered into a single vectored write.
+ *  Likewise, each shard keeps its own statistics, which are only added up when they are asked for.
+ *  A block or a cluster may also be accessed in place: it is pinned, so that its node is not selected for replacement,
+ *  and a pointer to its contents in the node is handed to the caller, who marks it as changed and unpins it when it is
+ *  done. With an unbuffered communication channel, a pinned block or cluster is a private copy instead, which is
+ *  written to the storage device whenever it is marked as changed.
+ *  The storage area, its settings and the flusher thread are part of the SOFS context bound to the calling thread:
+ *  each context has a buffercache of its own, assigned to the storage device opened in that context, and its flusher
+ *  works on it alone.
+ *
+ *  The following operations are defined:
+ *    \li set the number of blocks of the storage area
+ *    \li set the number of shards of the storage area
+ *    \li set the parameters of the write back of changed blocks
+ *    \li set the maximum number of clusters read ahead
+ *    \li initialize the storage area and assign it to the storage device
+ *    \li unassign the storage area from the storage device and perform the required housekeeping duties
+ *    \li read a block of data from the buffercache
+ *    \li write a block of data to the buffercache
+ *    \li flush a block of data to the storage device
+ *    \li synchronize a block of data with the same block in the storage device
+ *    \li read a cluster of data from the buffercache
+ *    \li write a cluster of data to the buffercache
+ *    \li flush a cluster of data to the storage device
+ *    \li synchronize a cluster of data with the same cluster in the storage device
+ *    \li synchronize the whole storage area with the storage device
+ *    \li pin a block / cluster of data and get a pointer to its contents in the buffercache
+ *    \li mark a pinned block / cluster of data as changed
+ *    \li unpin a block / cluster of data
+ *    \li get the statistics of the buffercache and of the storage device
+ *    \li get the generation of the storage area.
+ *
+ *  \author Artur Carneiro Pereira - September 2007
+ *  \author Miguel Oliveira e Silva - September 2009
+ *  \author António Rui Borges - July 2010 / August 2011
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_buffercachenode.h"
+#include "sofs_buffercacheinternals.h"
+#include "sofs_context.h"
+
+/** \brief maximum number of nodes written by the flusher thread before releasing the access to a shard */
+#define FLUSH_BATCH  8
+
+/** \brief minimum number of nodes of a shard (the number of shards is reduced for small storage areas) */
+#define MIN_SHARD_NODES  16
+
+/** \brief number of the node cluster a block belongs to */
+#define NCLUST(nBlock)   (((nBlock) + BC->nShift) / BLOCKS_PER_CLUSTER)
+/** \brief position of a block within the node cluster it belongs to */
+#define NOFFSET(nBlock)  (((nBlock) + BC->nShift) % BLOCKS_PER_CLUSTER)
+/** \brief set of \e count successive blocks of a node cluster, starting at position \e offset */
+#define BMASK(offset,count)  (((1U << (count)) - 1) << (offset))
+/** \brief shard a node cluster is stored in */
+#define SHARD(nClust)    (&BC->shard[(nClust) % BC->nShards])
+
+/** \brief size of a huge page: the arena of the storage area is backed by huge pages from this size on */
+#define HUGE_PAGE_SIZE   (2 * 1024 * 1024)
+
+/** \brief maximum number of blocks or clusters pinned at a time with an unbuffered communication channel */
+#define MAX_UNBUF_PINS   32
+
+/** \brief number of clusters of the first read-ahead window of a sequential access */
+#define RA_START_WINDOW  2
+/** \brief read-ahead hint of an access: the blocks had to be read from the storage device */
+#define RA_MISS          0x4
+
+/*
+ *  Internal data structure
+ */
+/** \brief State of the buffercache (one per SOFS context) */
+
+typedef struct
+{ /** \brief Number of blocks of the storage device */
+    uint32_t bnmax;
+  /** \brief Type of the communication channel */
+    uint32_t commType;
+  /** \brief Number of blocks of the storage area to be set up on the next initialization */
+    uint32_t cacheSize;
+  /** \brief Number of shards of the storage area to be set up on the next initialization */
+    uint32_t cacheShards;
+  /** \brief Number of blocks the node clusters are shifted by, so that the last one ends at the end of the device */
+    uint32_t nShift;
+  /** \brief Generation of the storage area: it is incremented each time the storage device is opened or closed */
+    uint32_t openGen;
+
+  /** \brief Storage area: nodes */
+    SOBufferCacheNode *buffer;
+  /** \brief Storage area: arena of the contents of the nodes, allocated at once */
+    unsigned char *arena;
+  /** \brief Size in bytes of the arena */
+    size_t arenaSize;
+  /** \brief Number of nodes of the storage area */
+    uint32_t nNodes;
+  /** \brief Nodes to be written back by a synchronization of the whole storage area */
+    SOBufferCacheNode **wbNode;
+  /** \brief Physical numbers of the blocks to be written back by a synchronization of the whole storage area */
+    uint32_t *wbBlock;
+  /** \brief Contents of the blocks to be written back by a synchronization of the whole storage area */
+    void **wbBuf;
+  /** \brief Shards of the storage area */
+    SOBufferCacheShard *shard;
+  /** \brief Number of shards of the storage area */
+    uint32_t nShards;
+
+  /** \brief Age in milliseconds above which a changed block is written back (zero, if there is no flusher thread) */
+    uint32_t flushAge;
+  /** \brief Percentage of a shard above which changed blocks are written back */
+    uint32_t dirtyRatio;
+  /** \brief Percentage of a shard above which writers are held back */
+    uint32_t dirtyLimit;
+
+  /** \brief Locking flag which warrants mutual exclusion on the access to the state of the flusher thread */
+    pthread_mutex_t flushCR;
+  /** \brief Flusher thread is waiting for changed blocks to be written back */
+    pthread_cond_t flushReq;
+  /** \brief Flusher thread */
+    pthread_t flusher;
+  /** \brief Flusher thread is running */
+    int flusherOn;
+  /** \brief Flusher thread is requested to terminate */
+    int flusherStop;
+  /** \brief Flusher thread is requested to go through the shards once more before sleeping */
+    int flushWake;
+
+  /** \brief Maximum number of clusters read ahead at a time to be set up on the next initialization */
+    uint32_t readAhead;
+  /** \brief Maximum number of clusters read ahead at a time (zero, if read-ahead is disabled) */
+    uint32_t raMax;
+  /** \brief Locking flag which warrants mutual exclusion on the access to the state of the sequential access */
+    pthread_mutex_t aheadCR;
+  /** \brief Number of the node cluster which was read last */
+    uint32_t raLast;
+  /** \brief Number of clusters of the present read-ahead window (zero, if no sequential access is going on) */
+    uint32_t raWin;
+  /** \brief Number of the node cluster following the present read-ahead window */
+    uint32_t raNext;
+  /** \brief Locking flag which warrants mutual exclusion on the submission and collection of asynchronous transfers */
+    pthread_mutex_t ioCR;
+  /** \brief Number of transfers of clusters read ahead which are in progress */
+    uint32_t nPending;
+
+  /** \brief Locking flag which warrants mutual exclusion on the access to the private copies of the pinned blocks and
+   *         clusters (unbuffered communication channel) */
+    pthread_mutex_t pinCR;
+  /** \brief Private copies of the pinned blocks and clusters (unbuffered communication channel): physical number of
+   *         the first block, number of blocks, number of pins (zero, if the entry is not in use) and contents */
+    struct
+    { uint32_t n;
+      uint32_t count;
+      uint32_t pins;
+      unsigned char buffer[CLUSTER_SIZE];
+    } unbufPin[MAX_UNBUF_PINS];
+} SOBufferCacheState;
+
+/** \brief State of the buffercache in the default context */
+static SOBufferCacheState defState;
+
+/** \brief State of the buffercache in the context bound to the calling thread */
+#define BC  ((SOBufferCacheState *) CTX_STATE (CTX_BUFFERCACHE))
+
+/* Allusion to internal functions */
+
+static int soReadNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void *buf, uint32_t *p_hint);
+static int soLoadNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, SOBufferCacheNode **p_node,
+                       uint32_t *p_hint);
+static int soWriteNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void *buf);
+static int soFlushNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void *buf);
+static int soSyncNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count);
+static int soPinNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void **p_buf);
+static int soMarkNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count);
+static int soUnpinNode (SOBufferCacheShard *sh, uint32_t n);
+static int soPinPrivate (uint32_t n, uint32_t count, void **p_buf);
+static int soMarkPrivate (uint32_t n, uint32_t count);
+static int soUnpinPrivate (uint32_t n, uint32_t count);
+static void soReadAhead (uint32_t nClust, uint32_t hint);
+static void soFetchNodes (uint32_t first, uint32_t count);
+static int soWaitNode (SOBufferCacheNode *node);
+static int soCollectNodes (uint32_t min);
+static int soTransferNode (uint32_t op, SOBufferCacheNode *node, uint32_t mask);
+static int soWriteBackNodes (SOBufferCacheNode **node, uint32_t count, uint32_t mask, uint32_t *nBlk, void **buf);
+static int soCompareNodes (const void *a, const void *b);
+static uint32_t soNodeBlocks (uint32_t nClust);
+static void soInsertNode (SOBufferCacheShard *sh, SOBufferCacheNode *node);
+static void soTouchNode (SOBufferCacheShard *sh, SOBufferCacheNode *node);
+static int soGetFreeNode (SOBufferCacheShard *sh, SOBufferCacheNode **p_node);
+static void soPutFreeNode (SOBufferCacheShard *sh, SOBufferCacheNode *node);
+static int soInitShard (SOBufferCacheShard *sh, SOBufferCacheNode *first, uint32_t size);
+static void soFreeStorageArea (void);
+static unsigned char *soAllocArena (size_t size);
+static void soMarkChanged (SOBufferCacheShard *sh, SOBufferCacheNode *node, uint32_t mask);
+static void soMarkSame (SOBufferCacheShard *sh, SOBufferCacheNode *node, uint32_t mask);
+static int soSyncFlushErr (void);
+static void soWakeFlusher (void);
+static void *soFlusher (void *arg);
+static uint64_t soGetTime (void);
+static void soInitState (void *state);
+
+/**
+ *  \brief Set the number of blocks of the storage area.
+ *
+ *  The value takes effect on the next initialization of a buffered communication channel and remains in force for
+ *  subsequent ones. It is rounded up to a whole number of clusters.
+ *
+ *  \param nBlocks number of blocks of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of blocks</em> is zero
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+int soSetBufferCacheSize (uint32_t nBlocks)
+{
+  soColorProbe (821, "07;31", "soSetBufferCacheSize(%"PRIu32")\n", nBlocks);
+
+  if (nBlocks == 0) return -EINVAL;              /* checking for number of blocks */
+  if (BC->buffer != NULL) return -EBUSY;         /* checking for storage area in use */
+
+  BC->cacheSize = nBlocks;
+
+  return 0;
+}
+
+/**
+ *  \brief Set the number of shards of the storage area.
+ *
+ *  The value takes effect on the next initialization of a buffered communication channel and remains in force for
+ *  subsequent ones. It is reduced, if needed, so that every shard has at least sixteen nodes.
+ *
+ *  \param n number of shards of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of shards</em> is zero or greater than \c MAX_CACHE_SHARDS
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+int soSetBufferCacheShards (uint32_t n)
+{
+  soColorProbe (824, "07;31", "soSetBufferCacheShards(%"PRIu32")\n", n);
+
+  if ((n == 0) || (n > MAX_CACHE_SHARDS))
+     return -EINVAL;                             /* checking for number of shards */
+  if (BC->buffer != NULL) return -EBUSY;         /* checking for storage area in use */
+
+  BC->cacheShards = n;
+
+  return 0;
+}
+
+/**
+ *  \brief Set the parameters of the write back of changed blocks.
+ *
+ *  The values take effect on the next initialization of a buffered communication channel and remain in force for
+ *  subsequent ones. The percentages apply to each shard of the storage area.
+ *
+ *  \param age age in milliseconds above which a changed block is written back by the flusher thread (\c 0 means no
+ *             flusher thread: changed blocks are only written on replacement or synchronization)
+ *  \param ratio percentage of the storage area above which changed blocks are written back by the flusher thread
+ *  \param limit percentage of the storage area above which writers are held back
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>limit</em> is zero or greater than 100, or the <em>ratio</em> is greater than it
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+int soSetBufferCacheFlush (uint32_t age, uint32_t ratio, uint32_t limit)
+{
+  soColorProbe (822, "07;31", "soSetBufferCacheFlush(%"PRIu32", %"PRIu32", %"PRIu32")\n", age, ratio, limit);
+
+  if ((limit == 0) || (limit > 100) || (ratio > limit))
+     return -EINVAL;                             /* checking for percentages */
+  if (BC->buffer != NULL) return -EBUSY;         /* checking for storage area in use */
+
+  BC->flushAge = age;
+  BC->dirtyRatio = ratio;
+  BC->dirtyLimit = limit;
+
+  return 0;
+}
+
+/**
+ *  \brief Set the maximum number of clusters read ahead.
+ *
+ *  The value takes effect on the next initialization of a buffered communication channel and remains in force for
+ *  subsequent ones. It is further limited to a fourth of the number of nodes of the storage area, so that a read-ahead
+ *  window never replaces the previous one.
+ *
+ *  \param window maximum number of clusters read ahead at a time (\c 0 means read-ahead is disabled)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>window</em> is greater than \c MAX_READ_AHEAD
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+int soSetBufferCacheReadAhead (uint32_t window)
+{
+  soColorProbe (823, "07;31", "soSetBufferCacheReadAhead(%"PRIu32")\n", window);
+
+  if (window > MAX_READ_AHEAD) return -EINVAL;   /* checking for window */
+  if (BC->buffer != NULL) return -EBUSY;         /* checking for storage area in use */
+
+  BC->readAhead = window;
+
+  return 0;
+}
+
+/**
+ *  \brief Initialize the storage area and assign it to the storage device.
+ *
+ *  A communication channel is established with the storage device so that data transfers between main memory and the
+ *  storage device may be minimized.
+ *  This communication may be unbuffered or buffered: it will be unbuffered, if the second argument is \c UNBUF ,
+ *  buffered with the 2Q replacement policy, if it is \c BUF2Q , and buffered with the least recently used replacement
+ *  policy, in any other case. When it is buffered, the flusher thread is started.
+ *
+ *  \param devname absolute path to the Linux file that simulates the storage device
+ *  \param type type of the communication channel that is opened
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the argument is \c NULL
+ *  \return -\c EBUSY, if the storage area is already in use or the device is already opened
+ *  \return -\c ENOMEM, if the storage area can not be allocated
+ *  \return -\c ELIBBAD, if the supporting file size is invalid
+ *  \return -<em>other specific error</em> issued by \e open or \e fstat system calls, or by \e pthread_create library
+ *          function
+ */
+
+int soOpenBufferCache (const char *devname, uint32_t type)
+{
+  soColorProbe (811, "07;31", "soOpenBufferCache(\"%s\",%"PRIu32")\n", devname, type);
+
+  uint32_t size;                                 /* number of nodes of the storage area */
+  uint32_t s, first, slice;                      /* shard counter, its first node and its number of nodes */
+  pthread_condattr_t attr;                       /* attributes of the condition variable of the flusher thread */
+  int stat;                                      /* status of operation */
+
+  if (devname == NULL) return -EINVAL;           /* checking for null pointer */
+  if (BC->buffer != NULL) return -EBUSY;         /* checking for storage area in use */
+
+  if ((stat = soOpenDevice (devname, &BC->bnmax)) != 0)
+     return stat;
+  BC->openGen += 1;
+  BC->commType = (type == UNBUF) ? UNBUF : ((type == BUF2Q) ? BUF2Q : BUF);
+  BC->nShift = (BLOCKS_PER_CLUSTER - BC->bnmax % BLOCKS_PER_CLUSTER) % BLOCKS_PER_CLUSTER;
+  if (BC->commType == UNBUF)
+     return 0;
+
+  /* set up the storage area, with a cluster per node, and split it in shards of consecutive nodes, none of them
+     smaller than the minimum; the contents of the nodes is laid out in the same order in a separate arena */
+
+  size = (BC->cacheSize + BLOCKS_PER_CLUSTER - 1) / BLOCKS_PER_CLUSTER;
+  BC->nShards = (BC->cacheShards < size / MIN_SHARD_NODES) ? BC->cacheShards : size / MIN_SHARD_NODES;
+  if (BC->nShards == 0) BC->nShards = 1;
+  BC->buffer = calloc (size, sizeof (SOBufferCacheNode));
+  BC->arena = soAllocArena ((size_t) size * CLUSTER_SIZE);
+  BC->shard = calloc (BC->nShards, sizeof (SOBufferCacheShard));
+  BC->wbNode = malloc ((size_t) size * sizeof (SOBufferCacheNode *));
+  BC->wbBlock = malloc ((size_t) size * BLOCKS_PER_CLUSTER * sizeof (uint32_t));
+  BC->wbBuf = malloc ((size_t) size * BLOCKS_PER_CLUSTER * sizeof (void *));
+  stat = ((BC->buffer == NULL) || (BC->arena == NULL) || (BC->shard == NULL) || (BC->wbNode == NULL) ||
+          (BC->wbBlock == NULL) || (BC->wbBuf == NULL)) ? -ENOMEM : 0;
+  for (s = 0; (s < size) && (stat == 0); s++)
+    BC->buffer[s].buffer = BC->arena + (size_t) s * CLUSTER_SIZE;
+  for (s = 0, first = 0; (s < BC->nShards) && (BC->shard != NULL); s++, first += slice)
+  { pthread_mutex_init (&BC->shard[s].accessCR, NULL);
+    pthread_cond_init (&BC->shard[s].flushDone, NULL);
+    slice = size / BC->nShards + ((s < size % BC->nShards) ? 1 : 0);
+    if (stat == 0)
+       stat = soInitShard (&BC->shard[s], &BC->buffer[first], slice);
+  }
+  if (stat != 0)
+     { soFreeStorageArea ();
+       soCloseDevice ();
+       BC->commType = BUF;
+       return stat;
+     }
+
+  BC->nNodes = size;
+  BC->raMax = (BC->readAhead < BC->nNodes / 4) ? BC->readAhead : BC->nNodes / 4;
+  BC->raLast = BC->raWin = BC->raNext = 0;
+
+  /* start the flusher thread */
+
+  if (BC->flushAge == 0)
+     return 0;
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&BC->flushReq, &attr);
+  pthread_condattr_destroy (&attr);
+  BC->flusherStop = BC->flushWake = 0;
+  if ((stat = pthread_create (&BC->flusher, NULL, soFlusher, soGetContext ())) != 0)
+     { pthread_cond_destroy (&BC->flushReq);
+       soFreeStorageArea ();
+       soCloseDevice ();
+       BC->commType = BUF;
+       return -stat;
+     }
+  BC->flusherOn = 1;
+
+  return 0;
+}
+
+/**
+ *  \brief Unassign the storage area from the storage device and perform the required housekeeping duties.
+ *
+ *  The buffered/unbuffered communication channel previously established with the storage device is closed.
+ *  This means, namely, that the flusher thread is terminated and the contents of the storage area is flushed into the
+ *  storage device and forced to stable storage to keep data consistent. The blocks and clusters which are still pinned
+ *  are unpinned.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the internal data is inconsistent
+ */
+
+int soCloseBufferCache (void)
+{
+  soColorProbe (812, "07;31", "soCloseBufferCache()\n");
+
+  uint32_t s;                                    /* private copy counter */
+  int stat = 0;                                  /* status of operation */
+
+  if (BC->commType == UNBUF)
+     { if ((stat = soSyncDevice (0, BC->bnmax)) != 0)
+          return stat;
+       for (s = 0; s < MAX_UNBUF_PINS; s++)
+         BC->unbufPin[s].pins = 0;
+       BC->commType = BUF;
+       BC->bnmax = 0;
+       BC->openGen += 1;
+       return soCloseDevice ();
+     }
+
+  /* terminate the flusher thread */
+
+  if (BC->flusherOn)
+     { pthread_mutex_lock (&BC->flushCR);
+       BC->flusherStop = 1;
+       pthread_cond_signal (&BC->flushReq);
+       pthread_mutex_unlock (&BC->flushCR);
+       pthread_join (BC->flusher, NULL);
+       pthread_cond_destroy (&BC->flushReq);
+       BC->flusherOn = 0;
+     }
+
+  /* wait for the clusters being read ahead */
+
+  pthread_mutex_lock (&BC->ioCR);
+  while ((BC->nPending > 0) && (stat == 0))
+    stat = soCollectNodes (1);
+  pthread_mutex_unlock (&BC->ioCR);
+  if (stat != 0) return stat;
+
+  /* write back the nodes whose contents was changed and force them to stable storage */
+
+  if ((stat = soSyncBufferCache ()) != 0)
+     return stat;
+
+  soFreeStorageArea ();
+  BC->commType = BUF;
+  BC->bnmax = 0;
+  BC->openGen += 1;
+
+  return soCloseDevice ();
+}
+
+/**
+ *  \brief Read a block of data from the buffercache.
+ *
+ *  Both the physical number of the data block to be read and a pointer to a previously allocated buffer are supplied
+ *  as arguments.
+ *
+ *  \param n physical number of the data block to be read from
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soReadCacheBlock (uint32_t n, void *buf)
+{
+  soColorProbe (813, "07;31", "soReadCacheBlock(%"PRIu32", %p)\n", n, buf);
+
+  SOBufferCacheShard *sh;                        /* shard the block is stored in */
+  uint32_t hint;                                 /* read-ahead hint of the access */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (n >= BC->bnmax) return -EINVAL;            /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soReadRawBlock (n, buf);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soReadNode (sh, n, 1, buf, &hint);
+  pthread_mutex_unlock (&sh->accessCR);
+  if (stat == 0)
+     soReadAhead (NCLUST (n), hint);
+
+  return stat;
+}
+
+/**
+ *  \brief Write a block of data to the buffercache.
+ *
+ *  Both the physical number of the data block to be written and a pointer to a previously allocated buffer are supplied
+ *  as arguments.
+ *  The block is only marked as changed: it is written to the storage device later on, by the flusher thread or when
+ *  its node is selected for replacement. The caller is held back while too many blocks are waiting to be written.
+ *
+ *  \param n physical number of the block to be written into
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soWriteCacheBlock (uint32_t n, void *buf)
+{
+  soColorProbe (814, "07;31", "soWriteCacheBlock(%"PRIu32", %p)\n", n, buf);
+
+  SOBufferCacheShard *sh;                        /* shard the block is stored in */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (n >= BC->bnmax) return -EINVAL;            /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soWriteRawBlock (n, buf);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soWriteNode (sh, n, 1, buf);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Flush a block of data to the storage device.
+ *
+ *  Both the physical number of the data block to be written and a pointer to a previously allocated buffer are supplied
+ *  as arguments.
+ *
+ *  \param n physical number of the block to be flushed
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soFlushCacheBlock (uint32_t n, void *buf)
+{
+  soColorProbe (815, "07;31", "soFlushCacheBlock(%"PRIu32", %p)\n", n, buf);
+
+  SOBufferCacheShard *sh;                        /* shard the block is stored in */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (n >= BC->bnmax) return -EINVAL;            /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soWriteRawBlock (n, buf);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soFlushNode (sh, n, 1, buf);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Synchronize a block of data with the same block in the storage device.
+ *
+ *  The physical number of the data block to be synchronized is supplied as argument.
+ *  The block is then forced to stable storage.
+ *
+ *  \param n physical number of the block to be synchronized
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing, now or previously by the flusher thread
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soSyncCacheBlock (uint32_t n)
+{
+  soColorProbe (816, "07;31", "soSyncCacheBlock(%"PRIu32")\n", n);
+
+  SOBufferCacheShard *sh;                        /* shard the block is stored in */
+  int stat = 0;                                  /* status of operation */
+
+  if (n >= BC->bnmax) return -EINVAL;            /* checking for block number */
+
+  if (BC->commType != UNBUF)
+     { sh = SHARD (NCLUST (n));
+       pthread_mutex_lock (&sh->accessCR);
+       stat = soSyncNode (sh, n, 1);
+       pthread_mutex_unlock (&sh->accessCR);
+     }
+  if ((stat == 0) && ((stat = soSyncDevice (n, 1)) == 0))
+     stat = soSyncFlushErr ();
+
+  return stat;
+}
+
+/**
+ *  \brief Read a cluster of data from the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  Both the physical number of the first block of the data cluster to be read and a pointer to a previously allocated
+ *  buffer are supplied as arguments.
+ *
+ *  \param n physical number of the first block of the data cluster to be read from
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soReadCacheCluster (uint32_t n, void *buf)
+{
+  soColorProbe (817, "07;31", "soReadCacheCluster(%"PRIu32", %p)\n", n, buf);
+
+  SOBufferCacheShard *sh;                        /* shard the blocks are stored in */
+  uint32_t i, count;                             /* block counter and number of blocks in the same node */
+  uint32_t hint;                                 /* read-ahead hint of the access */
+  int stat = 0;                                  /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + BLOCKS_PER_CLUSTER) > BC->bnmax)
+     return -EINVAL;                             /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soReadRawCluster (n, buf);
+
+  for (i = 0; (i < BLOCKS_PER_CLUSTER) && (stat == 0); i += count)
+  { count = BLOCKS_PER_CLUSTER - NOFFSET (n + i);
+    if (count > BLOCKS_PER_CLUSTER - i) count = BLOCKS_PER_CLUSTER - i;
+    sh = SHARD (NCLUST (n + i));
+    pthread_mutex_lock (&sh->accessCR);
+    stat = soReadNode (sh, n + i, count, (unsigned char *) buf + i * BLOCK_SIZE, &hint);
+    pthread_mutex_unlock (&sh->accessCR);
+    if (stat == 0)
+       soReadAhead (NCLUST (n + i), hint);
+  }
+
+  return stat;
+}
+
+/**
+ *  \brief Write a cluster of data to the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  Both the physical number of the first block of the data cluster to be written and a pointer to a previously
+ *  allocated buffer are supplied as arguments.
+ *  The blocks are only marked as changed, as in soWriteCacheBlock.
+ *
+ *  \param n physical number of the first block of the data cluster to be written into
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soWriteCacheCluster (uint32_t n, void *buf)
+{
+  soColorProbe (818, "07;31", "soWriteCacheCluster(%"PRIu32", %p)\n", n, buf);
+
+  SOBufferCacheShard *sh;                        /* shard the blocks are stored in */
+  uint32_t i, count;                             /* block counter and number of blocks in the same node */
+  int stat = 0;                                  /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + BLOCKS_PER_CLUSTER) > BC->bnmax)
+     return -EINVAL;                             /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soWriteRawCluster (n, buf);
+
+  for (i = 0; (i < BLOCKS_PER_CLUSTER) && (stat == 0); i += count)
+  { count = BLOCKS_PER_CLUSTER - NOFFSET (n + i);
+    if (count > BLOCKS_PER_CLUSTER - i) count = BLOCKS_PER_CLUSTER - i;
+    sh = SHARD (NCLUST (n + i));
+    pthread_mutex_lock (&sh->accessCR);
+    stat = soWriteNode (sh, n + i, count, (unsigned char *) buf + i * BLOCK_SIZE);
+    pthread_mutex_unlock (&sh->accessCR);
+  }
+
+  return stat;
+}
+
+/**
+ *  \brief Flush a cluster of data to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  Both the physical number of the first block of the data cluster to be flushed and a pointer to a previously
+ *  allocated buffer are supplied as arguments.
+ *
+ *  \param n physical number of the first block of the data cluster to be flushed
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soFlushCacheCluster (uint32_t n, void *buf)
+{
+  soColorProbe (819, "07;31", "soFlushCacheCluster(%"PRIu32", %p)\n", n, buf);
+
+  SOBufferCacheShard *sh;                        /* shard the blocks are stored in */
+  uint32_t i, count;                             /* block counter and number of blocks in the same node */
+  int stat = 0;                                  /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + BLOCKS_PER_CLUSTER) > BC->bnmax)
+     return -EINVAL;                             /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soWriteRawCluster (n, buf);
+
+  for (i = 0; (i < BLOCKS_PER_CLUSTER) && (stat == 0); i += count)
+  { count = BLOCKS_PER_CLUSTER - NOFFSET (n + i);
+    if (count > BLOCKS_PER_CLUSTER - i) count = BLOCKS_PER_CLUSTER - i;
+    sh = SHARD (NCLUST (n + i));
+    pthread_mutex_lock (&sh->accessCR);
+    stat = soFlushNode (sh, n + i, count, (unsigned char *) buf + i * BLOCK_SIZE);
+    pthread_mutex_unlock (&sh->accessCR);
+  }
+
+  return stat;
+}
+
+/**
+ *  \brief Synchronize a cluster of data with the same cluster in the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the data cluster to be synchronized is supplied as argument.
+ *  The cluster is then forced to stable storage.
+ *
+ *  \param n physical number of the first block of the data cluster to be synchronized
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing, now or previously by the flusher thread
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soSyncCacheCluster (uint32_t n)
+{
+  soColorProbe (820, "07;31", "soSyncCacheCluster(%"PRIu32")\n", n);
+
+  SOBufferCacheShard *sh;                        /* shard the blocks are stored in */
+  uint32_t i, count;                             /* block counter and number of blocks in the same node */
+  int stat = 0;                                  /* status of operation */
+
+  if (((uint64_t) n + BLOCKS_PER_CLUSTER) > BC->bnmax)
+     return -EINVAL;                             /* checking for block number */
+
+  for (i = 0; (i < BLOCKS_PER_CLUSTER) && (stat == 0) && (BC->commType != UNBUF); i += count)
+  { count = BLOCKS_PER_CLUSTER - NOFFSET (n + i);
+    if (count > BLOCKS_PER_CLUSTER - i) count = BLOCKS_PER_CLUSTER - i;
+    sh = SHARD (NCLUST (n + i));
+    pthread_mutex_lock (&sh->accessCR);
+    stat = soSyncNode (sh, n + i, count);
+    pthread_mutex_unlock (&sh->accessCR);
+  }
+  if ((stat == 0) && ((stat = soSyncDevice (n, BLOCKS_PER_CLUSTER)) == 0))
+     stat = soSyncFlushErr ();
+
+  return stat;
+}
+
+/**
+ *  \brief Synchronize the whole storage area with the storage device.
+ *
+ *  The changed blocks of all the nodes are written back, sorted by block number, so that the blocks which follow each
+ *  other on the storage device are gathered into single vectored writes, and the storage device is forced to stable
+ *  storage. The access to all the shards is taken, in order, while the blocks are written back.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing, now or previously by the flusher thread
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soSyncBufferCache (void)
+{
+  soColorProbe (832, "07;31", "soSyncBufferCache()\n");
+
+  SOBufferCacheNode *node;                       /* changed node */
+  uint32_t s, i, nChanged;                       /* shard and node counters and number of changed nodes */
+  int stat = 0;                                  /* status of operation */
+
+  if (BC->bnmax == 0) return -EBADF;             /* checking for device open state */
+
+  if (BC->commType != UNBUF)
+     { for (s = 0; s < BC->nShards; s++)
+         pthread_mutex_lock (&BC->shard[s].accessCR);
+
+       /* gather the nodes whose contents was changed */
+
+       for (s = 0, nChanged = 0; (s < BC->nShards) && (stat == 0); s++)
+       { for (i = 0, node = BC->shard[s].dLTail; (i < BC->shard[s].nDirty) && (node != NULL); i++, node = node->d_prev)
+           BC->wbNode[nChanged++] = node;
+         if ((i != BC->shard[s].nDirty) || (node != NULL))
+            stat = -ELIBBAD;
+       }
+
+       /* write them back in the order of their clusters on the storage device */
+
+       if (stat == 0)
+          stat = soWriteBackNodes (BC->wbNode, nChanged, BMASK (0, BLOCKS_PER_CLUSTER), BC->wbBlock, BC->wbBuf);
+       for (s = BC->nShards; s > 0; s--)
+       { pthread_cond_broadcast (&BC->shard[s-1].flushDone);
+         pthread_mutex_unlock (&BC->shard[s-1].accessCR);
+       }
+     }
+  if ((stat == 0) && ((stat = soSyncDevice (0, BC->bnmax)) == 0))
+     stat = soSyncFlushErr ();
+
+  return stat;
+}
+
+/**
+ *  \brief Pin a block of data and get a pointer to its contents in the buffercache.
+ *
+ *  The block is read into the storage area, if it is not there, and its node is not selected for replacement until
+ *  it is unpinned, so the contents may be read and changed in place, with no copy involved. Changes must be followed
+ *  by soMarkCacheBlock to be written to the storage device. A block may be pinned more than once; it has to be
+ *  unpinned as many times.
+ *
+ *  \param n physical number of the data block to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the block is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ENOBUFS, if all the nodes which could store the block, or all the private copies, are pinned
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soGetCacheBlock (uint32_t n, void **p_buf)
+{
+  soColorProbe (826, "07;31", "soGetCacheBlock(%"PRIu32", %p)\n", n, p_buf);
+
+  SOBufferCacheShard *sh;                        /* shard the block is stored in */
+  int stat;                                      /* status of operation */
+
+  if (p_buf == NULL) return -EINVAL;             /* checking for null pointer */
+  if (n >= BC->bnmax) return -EINVAL;            /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soPinPrivate (n, 1, p_buf);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soPinNode (sh, n, 1, p_buf);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Mark a pinned block of data as changed.
+ *
+ *  The block is written to the storage device later on, as if it had been written by soWriteCacheBlock; with an
+ *  unbuffered communication channel, it is written at once.
+ *
+ *  \param n physical number of the data block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+int soMarkCacheBlock (uint32_t n)
+{
+  soColorProbe (827, "07;31", "soMarkCacheBlock(%"PRIu32")\n", n);
+
+  SOBufferCacheShard *sh;                        /* shard the block is stored in */
+  int stat;                                      /* status of operation */
+
+  if (n >= BC->bnmax) return -EINVAL;            /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soMarkPrivate (n, 1);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soMarkNode (sh, n, 1);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Unpin a block of data.
+ *
+ *  The pointer to its contents is no longer valid, unless it is still pinned by a previous call.
+ *
+ *  \param n physical number of the data block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not pinned
+ */
+
+int soPutCacheBlock (uint32_t n)
+{
+  soColorProbe (828, "07;31", "soPutCacheBlock(%"PRIu32")\n", n);
+
+  SOBufferCacheShard *sh;                        /* shard the block is stored in */
+  int stat;                                      /* status of operation */
+
+  if (n >= BC->bnmax) return -EINVAL;            /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soUnpinPrivate (n, 1);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soUnpinNode (sh, n);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Pin a cluster of data and get a pointer to its contents in the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The cluster must be stored in a single node, which is the case of every data cluster, since the node clusters end
+ *  where the data zone ends. Otherwise, it behaves as soGetCacheBlock.
+ *
+ *  \param n physical number of the first block of the data cluster to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL, the <em>block number</em> is out of range or the cluster
+ *          is not aligned on a node cluster
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ENOBUFS, if all the nodes which could store the cluster, or all the private copies, are pinned
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soGetCacheCluster (uint32_t n, void **p_buf)
+{
+  soColorProbe (829, "07;31", "soGetCacheCluster(%"PRIu32", %p)\n", n, p_buf);
+
+  SOBufferCacheShard *sh;                        /* shard the cluster is stored in */
+  int stat;                                      /* status of operation */
+
+  if (p_buf == NULL) return -EINVAL;             /* checking for null pointer */
+  if ((((uint64_t) n + BLOCKS_PER_CLUSTER) > BC->bnmax) || (NOFFSET (n) != 0))
+     return -EINVAL;                             /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soPinPrivate (n, BLOCKS_PER_CLUSTER, p_buf);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soPinNode (sh, n, BLOCKS_PER_CLUSTER, p_buf);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Mark a pinned cluster of data as changed.
+ *
+ *  The cluster is written to the storage device later on, as if it had been written by soWriteCacheCluster; with an
+ *  unbuffered communication channel, it is written at once.
+ *
+ *  \param n physical number of the first block of the data cluster
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+int soMarkCacheCluster (uint32_t n)
+{
+  soColorProbe (830, "07;31", "soMarkCacheCluster(%"PRIu32")\n", n);
+
+  SOBufferCacheShard *sh;                        /* shard the cluster is stored in */
+  int stat;                                      /* status of operation */
+
+  if ((((uint64_t) n + BLOCKS_PER_CLUSTER) > BC->bnmax) || (NOFFSET (n) != 0))
+     return -EINVAL;                             /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soMarkPrivate (n, BLOCKS_PER_CLUSTER);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soMarkNode (sh, n, BLOCKS_PER_CLUSTER);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Unpin a cluster of data.
+ *
+ *  The pointer to its contents is no longer valid, unless it is still pinned by a previous call.
+ *
+ *  \param n physical number of the first block of the data cluster
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not pinned
+ */
+
+int soPutCacheCluster (uint32_t n)
+{
+  soColorProbe (831, "07;31", "soPutCacheCluster(%"PRIu32")\n", n);
+
+  SOBufferCacheShard *sh;                        /* shard the cluster is stored in */
+  int stat;                                      /* status of operation */
+
+  if ((((uint64_t) n + BLOCKS_PER_CLUSTER) > BC->bnmax) || (NOFFSET (n) != 0))
+     return -EINVAL;                             /* checking for block number */
+
+  if (BC->commType == UNBUF)
+     return soUnpinPrivate (n, BLOCKS_PER_CLUSTER);
+
+  sh = SHARD (NCLUST (n));
+  pthread_mutex_lock (&sh->accessCR);
+  stat = soUnpinNode (sh, n);
+  pthread_mutex_unlock (&sh->accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Get the statistics of the buffercache and of the storage device.
+ *
+ *  The statistics of the shards are added up one shard at a time, so accesses may go on meanwhile.
+ *
+ *  \param p_stats pointer to a location where the statistics are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ */
+
+int soGetBufferCacheStats (SOBufferCacheStats *p_stats)
+{
+  soColorProbe (825, "07;31", "soGetBufferCacheStats(%p)\n", p_stats);
+
+  SOBufferCacheShard *sh;                        /* shard whose statistics are added up */
+  SOBufferCacheNode *node;                       /* node of the list of released nodes */
+  uint32_t s;                                    /* shard counter */
+
+  if (p_stats == NULL) return -EINVAL;           /* checking for null pointer */
+  if (BC->bnmax == 0) return -EBADF;             /* checking for device open state */
+
+  memset (p_stats, 0, sizeof (SOBufferCacheStats));
+  for (s = 0; (s < BC->nShards) && (BC->commType != UNBUF); s++)
+  { sh = &BC->shard[s];
+    pthread_mutex_lock (&sh->accessCR);
+    p_stats->nHits += sh->nHits;
+    p_stats->nMisses += sh->nMisses;
+    p_stats->nEvictions += sh->nEvictions;
+    p_stats->nWritebacks += sh->nWritebacks;
+    p_stats->nWritebackIOs += sh->nWbTransfers;
+    p_stats->bytesWriteback += sh->bytesWb;
+    p_stats->nFlushes += sh->nFlushes;
+    p_stats->nReadAhead += sh->nReadAhead;
+    p_stats->bytesRead += sh->bytesRead;
+    p_stats->bytesWritten += sh->bytesWritten;
+    p_stats->nUsed += sh->nNodes - sh->nFreeBlocks;
+    for (node = sh->freeList; node != NULL; node = node->access_next)
+      p_stats->nUsed -= 1;
+    p_stats->nDirty += sh->nDirty;
+    pthread_mutex_unlock (&sh->accessCR);
+  }
+  p_stats->nNodes = BC->nNodes;
+  if (p_stats->nWritebackIOs > 0)
+     p_stats->avgWritebackIO = p_stats->bytesWriteback / p_stats->nWritebackIOs;
+
+  return soGetRawStats (&p_stats->dev);
+}
+
+/**
+ *  \brief Get the generation of the storage area.
+ *
+ *  It is incremented each time the storage device is opened or closed, so that a layer above which keeps pointers to
+ *  pinned blocks or clusters can find out they belong to a storage area which no longer exists.
+ *
+ *  \return generation of the storage area
+ */
+
+uint32_t soGetBufferCacheGen (void)
+{
+  return BC->openGen;
+}
+
+/**
+ *  \brief Read a group of successive blocks of data from a shard of the storage area.
+ *
+ *  The blocks are supposed to belong to the same node cluster. The caller is supposed to have exclusive access to the
+ *  shard.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the first block to be read from
+ *  \param count number of blocks
+ *  \param buf pointer to the buffer where the data must be read into
+ *  \param p_hint pointer to a location where the read-ahead hint of the access is to be stored, as in soLoadNode
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soReadNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void *buf, uint32_t *p_hint)
+{
+  SOBufferCacheNode *node;                       /* node where the blocks are stored */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadNode (sh, n, count, &node, p_hint)) != 0)
+     return stat;
+  memcpy (buf, node->buffer + NOFFSET (n) * BLOCK_SIZE, count * BLOCK_SIZE);
+  sh->bytesRead += (uint64_t) count * BLOCK_SIZE;
+
+  return 0;
+}
+
+/**
+ *  \brief Load a group of successive blocks of data into a shard of the storage area.
+ *
+ *  The blocks are supposed to belong to the same node cluster. If it is not stored in the shard yet, the whole cluster
+ *  is read into a free node. The access is registered on the node. The caller is supposed to have exclusive access to
+ *  the shard.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the first block to be loaded
+ *  \param count number of blocks
+ *  \param p_node pointer to a location where the pointer to the node where the blocks are stored is to be stored
+ *  \param p_hint pointer to a location where the read-ahead hint of the access is to be stored: a combination of
+ *                \c RA_TRIGGER, if the node is the first of a read-ahead window, and \c RA_MISS, if the blocks had to
+ *                be read from the storage device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ENOBUFS, if all the nodes of the shard are pinned
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soLoadNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, SOBufferCacheNode **p_node,
+                       uint32_t *p_hint)
+{
+  SOBufferCacheNode *node;                       /* node where the blocks are stored */
+  uint32_t mask = BMASK (NOFFSET (n), count);    /* set of blocks within the node */
+  int stat;                                      /* status of operation */
+
+  *p_hint = 0;
+  if ((node = searchNodeOnN (NCLUST (n), sh->nHTable, sh->nHMask)) != NULL)
+
+     /* the cluster is stored in the shard: read the blocks which are missing */
+
+     { if ((stat = soWaitNode (node)) != 0)
+          return stat;
+       if ((mask & ~node->valid) != 0)
+          { if ((stat = soTransferNode (RAW_READ, node, mask & ~node->valid)) != 0)
+               return stat;
+            node->valid |= mask;
+            *p_hint = RA_MISS;
+          }
+     }
+     else
+
+     /* the cluster is not stored in the shard: read it into a free node */
+
+     { if ((stat = soGetFreeNode (sh, &node)) != 0)
+          return stat;
+       node->n = NCLUST (n);
+       node->stat = SAME;
+       node->ahead = 0;
+       if ((stat = soTransferNode (RAW_READ, node, soNodeBlocks (node->n))) != 0)
+          { soPutFreeNode (sh, node);
+            return stat;
+          }
+       node->valid = soNodeBlocks (node->n);
+       soInsertNode (sh, node);
+       *p_hint = RA_MISS;
+     }
+  soTouchNode (sh, node);
+  if (*p_hint == RA_MISS)
+     sh->nMisses += 1;
+     else sh->nHits += 1;
+  *p_hint |= node->ahead & RA_TRIGGER;
+  node->ahead &= ~RA_TRIGGER;
+  *p_node = node;
+
+  return 0;
+}
+
+/**
+ *  \brief Write a group of successive blocks of data to a shard of the storage area.
+ *
+ *  The blocks are supposed to belong to the same node cluster; they are stored in its node, which is set up if it is
+ *  not there, and marked as changed. The caller is supposed to have exclusive access to the shard, which is released
+ *  while it is held back waiting for the flusher thread.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the first block to be written into
+ *  \param count number of blocks
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soWriteNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void *buf)
+{
+  SOBufferCacheNode *node;                       /* node where the blocks are stored */
+  uint32_t mask = BMASK (NOFFSET (n), count);    /* set of blocks within the node */
+  int stat;                                      /* status of operation */
+
+  /* hold back the writer while there are too many changed nodes in the shard */
+
+  while (BC->flusherOn && (sh->nDirty >= sh->nDirtyMax) && (sh->flushErr == 0))
+  { soWakeFlusher ();
+    pthread_cond_wait (&sh->flushDone, &sh->accessCR);
+  }
+
+  /* the cluster is not stored in the shard: set up a free node for it */
+
+  if ((node = searchNodeOnN (NCLUST (n), sh->nHTable, sh->nHMask)) == NULL)
+     { if ((stat = soGetFreeNode (sh, &node)) != 0)
+          return stat;
+       node->n = NCLUST (n);
+       node->valid = 0;
+       node->stat = SAME;
+       node->ahead = 0;
+       soInsertNode (sh, node);
+       sh->nMisses += 1;
+     }
+     else { if ((stat = soWaitNode (node)) != 0)
+               return stat;
+            sh->nHits += 1;
+          }
+
+  memcpy (node->buffer + NOFFSET (n) * BLOCK_SIZE, buf, count * BLOCK_SIZE);
+  node->valid |= mask;
+  soMarkChanged (sh, node, mask);
+  soTouchNode (sh, node);
+  sh->bytesWritten += (uint64_t) count * BLOCK_SIZE;
+
+  return 0;
+}
+
+/**
+ *  \brief Flush a group of successive blocks of data to the storage device through a shard of the storage area.
+ *
+ *  The blocks are supposed to belong to the same node cluster. The caller is supposed to have exclusive access to the
+ *  shard.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the first block to be flushed
+ *  \param count number of blocks
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on writing
+ */
+
+static int soFlushNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void *buf)
+{
+  SOBufferCacheNode *node;                       /* node where the blocks are stored */
+  uint32_t mask = BMASK (NOFFSET (n), count);    /* set of blocks within the node */
+  int stat;                                      /* status of operation */
+
+  sh->nWrites += 1;
+  sh->nFlushes += 1;
+  sh->bytesWritten += (uint64_t) count * BLOCK_SIZE;
+  if ((node = searchNodeOnN (NCLUST (n), sh->nHTable, sh->nHMask)) == NULL)
+     return soWriteRawBlocks (n, count, buf);
+  if ((stat = soWaitNode (node)) != 0)
+     return stat;
+
+  /* the cluster is stored in the shard: update it and write the blocks through */
+
+  memcpy (node->buffer + NOFFSET (n) * BLOCK_SIZE, buf, count * BLOCK_SIZE);
+  node->valid |= mask;
+  if ((stat = soTransferNode (RAW_WRITE, node, mask)) != 0)
+     { soMarkChanged (sh, node, mask);
+       return stat;
+     }
+  soMarkSame (sh, node, mask);
+  soTouchNode (sh, node);
+
+  return 0;
+}
+
+/**
+ *  \brief Synchronize a group of successive blocks of a shard of the storage area with the same blocks in the storage
+ *         device.
+ *
+ *  The blocks are supposed to belong to the same node cluster. The caller is supposed to have exclusive access to the
+ *  shard.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the first block to be synchronized
+ *  \param count number of blocks
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on writing
+ */
+
+static int soSyncNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count)
+{
+  SOBufferCacheNode *node;                       /* node where the blocks are stored */
+  uint32_t mask = BMASK (NOFFSET (n), count);    /* set of blocks within the node */
+  uint32_t nBlk[BLOCKS_PER_CLUSTER];             /* physical numbers of the blocks written back */
+  void *buf[BLOCKS_PER_CLUSTER];                 /* contents of the blocks written back */
+  int stat;                                      /* status of operation */
+
+  sh->nFlushes += 1;
+  if (((node = searchNodeOnN (NCLUST (n), sh->nHTable, sh->nHMask)) != NULL) && ((node->stat & mask) != 0))
+     { if ((stat = soWriteBackNodes (&node, 1, mask, nBlk, buf)) != 0)
+          return stat;
+       soTouchNode (sh, node);
+     }
+
+  return 0;
+}
+
+/**
+ *  \brief Pin a group of successive blocks of data of a shard of the storage area.
+ *
+ *  The blocks are supposed to belong to the same node cluster. They are loaded into the shard and the number of pins
+ *  of their node is incremented. The caller is supposed to have exclusive access to the shard.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the first block to be pinned
+ *  \param count number of blocks
+ *  \param p_buf pointer to a location where the pointer to the contents of the first block is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ENOBUFS, if all the nodes of the shard are pinned
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soPinNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count, void **p_buf)
+{
+  SOBufferCacheNode *node;                       /* node where the blocks are stored */
+  uint32_t hint;                                 /* read-ahead hint of the access (not used) */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadNode (sh, n, count, &node, &hint)) != 0)
+     return stat;
+  node->pins += 1;
+  *p_buf = node->buffer + NOFFSET (n) * BLOCK_SIZE;
+
+  return 0;
+}
+
+/**
+ *  \brief Mark a group of successive pinned blocks of data of a shard of the storage area as changed.
+ *
+ *  The blocks are supposed to belong to the same node cluster. The writer is not held back, even if there are too many
+ *  changed nodes in the shard. The caller is supposed to have exclusive access to the shard.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the first block
+ *  \param count number of blocks
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the node of the blocks is not pinned
+ */
+
+static int soMarkNode (SOBufferCacheShard *sh, uint32_t n, uint32_t count)
+{
+  SOBufferCacheNode *node;                       /* node where the blocks are stored */
+
+  if (((node = searchNodeOnN (NCLUST (n), sh->nHTable, sh->nHMask)) == NULL) || (node->pins == 0))
+     return -EINVAL;
+  soMarkChanged (sh, node, BMASK (NOFFSET (n), count));
+  sh->bytesWritten += (uint64_t) count * BLOCK_SIZE;
+
+  return 0;
+}
+
+/**
+ *  \brief Unpin the node of a block of data of a shard of the storage area.
+ *
+ *  The caller is supposed to have exclusive access to the shard.
+ *
+ *  \param sh pointer to the shard
+ *  \param n physical number of the block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the node of the block is not pinned
+ */
+
+static int soUnpinNode (SOBufferCacheShard *sh, uint32_t n)
+{
+  SOBufferCacheNode *node;                       /* node where the block is stored */
+
+  if (((node = searchNodeOnN (NCLUST (n), sh->nHTable, sh->nHMask)) == NULL) || (node->pins == 0))
+     return -EINVAL;
+  node->pins -= 1;
+
+  return 0;
+}
+
+/**
+ *  \brief Pin a group of successive blocks of data with an unbuffered communication channel.
+ *
+ *  The private copy of the group is shared, if it is already pinned; otherwise, a free entry is taken and the group is
+ *  read into it.
+ *
+ *  \param n physical number of the first block to be pinned
+ *  \param count number of blocks
+ *  \param p_buf pointer to a location where the pointer to the private copy is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading
+ *  \return -\c ENOBUFS, if all the entries are in use
+ */
+
+static int soPinPrivate (uint32_t n, uint32_t count, void **p_buf)
+{
+  uint32_t i, k = MAX_UNBUF_PINS;                /* counter and free entry */
+  int stat = 0;                                  /* status of operation */
+
+  pthread_mutex_lock (&BC->pinCR);
+  for (i = 0; i < MAX_UNBUF_PINS; i++)
+    if (BC->unbufPin[i].pins == 0)
+       { if (k == MAX_UNBUF_PINS) k = i;
+       }
+       else if ((BC->unbufPin[i].n == n) && (BC->unbufPin[i].count == count))
+               break;
+  if (i == MAX_UNBUF_PINS)                       /* the group is not pinned yet */
+     { if ((i = k) == MAX_UNBUF_PINS)
+          stat = -ENOBUFS;
+          else if ((stat = soReadRawBlocks (n, count, BC->unbufPin[i].buffer)) == 0)
+                  { BC->unbufPin[i].n = n;
+                    BC->unbufPin[i].count = count;
+                  }
+     }
+  if (stat == 0)
+     { BC->unbufPin[i].pins += 1;
+       *p_buf = BC->unbufPin[i].buffer;
+     }
+  pthread_mutex_unlock (&BC->pinCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Write the private copy of a group of successive pinned blocks of data to the storage device.
+ *
+ *  \param n physical number of the first block
+ *  \param count number of blocks
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the group is not pinned
+ *  \return -\c EIO, if it fails on writing
+ */
+
+static int soMarkPrivate (uint32_t n, uint32_t count)
+{
+  uint32_t i;                                    /* counter */
+  int stat = -EINVAL;                            /* status of operation */
+
+  pthread_mutex_lock (&BC->pinCR);
+  for (i = 0; i < MAX_UNBUF_PINS; i++)
+    if ((BC->unbufPin[i].pins != 0) && (BC->unbufPin[i].n == n) && (BC->unbufPin[i].count == count))
+       { stat = soWriteRawBlocks (n, count, BC->unbufPin[i].buffer);
+         break;
+       }
+  pthread_mutex_unlock (&BC->pinCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Unpin a group of successive blocks of data with an unbuffered communication channel.
+ *
+ *  The private copy is released when it is no longer pinned.
+ *
+ *  \param n physical number of the first block
+ *  \param count number of blocks
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the group is not pinned
+ */
+
+static int soUnpinPrivate (uint32_t n, uint32_t count)
+{
+  uint32_t i;                                    /* counter */
+  int stat = -EINVAL;                            /* status of operation */
+
+  pthread_mutex_lock (&BC->pinCR);
+  for (i = 0; i < MAX_UNBUF_PINS; i++)
+    if ((BC->unbufPin[i].pins != 0) && (BC->unbufPin[i].n == n) && (BC->unbufPin[i].count == count))
+       { BC->unbufPin[i].pins -= 1;
+         stat = 0;
+         break;
+       }
+  pthread_mutex_unlock (&BC->pinCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Detect a sequential access and read ahead the clusters that follow.
+ *
+ *  An access to a node cluster following the one which was read last starts, or goes on with, a sequential access. The
+ *  first read-ahead window is set up right away; the next one, twice as large up to the maximum, when the reader gets
+ *  to the first cluster of the present window, or earlier, if the reader has to wait for a cluster to be read. An
+ *  access to any other cluster ends the sequential access. The caller is supposed not to have access to any shard.
+ *
+ *  \param nClust number of the node cluster which was read
+ *  \param hint read-ahead hint of the access, as stored by soReadNode
+ */
+
+static void soReadAhead (uint32_t nClust, uint32_t hint)
+{
+  uint32_t first = 0, count = 0;                 /* read-ahead window */
+
+  if (BC->raMax == 0) return;
+
+  pthread_mutex_lock (&BC->aheadCR);
+  if (nClust != BC->raLast)
+     { if (nClust != BC->raLast + 1)
+          BC->raWin = 0;                         /* the sequential access, if any, is over */
+          else if (BC->raWin == 0)
+                  { BC->raWin = (RA_START_WINDOW < BC->raMax) ? RA_START_WINDOW : BC->raMax;
+                    BC->raNext = nClust + 1;
+                    count = BC->raWin;
+                  }
+          else if ((hint != 0) || (BC->raNext <= nClust + 1))
+                  { BC->raWin = (2 * BC->raWin < BC->raMax) ? 2 * BC->raWin : BC->raMax;
+                    if (BC->raNext <= nClust) BC->raNext = nClust + 1;
+                    count = BC->raWin;
+                  }
+       BC->raLast = nClust;
+       first = BC->raNext;
+       BC->raNext += count;
+     }
+  pthread_mutex_unlock (&BC->aheadCR);
+
+  if (count != 0)
+     soFetchNodes (first, count);
+}
+
+/**
+ *  \brief Read ahead a window of node clusters.
+ *
+ *  The clusters which are not stored in the storage area are read into free nodes, the first one being marked as the
+ *  trigger of the next window. If the storage device is served by an io_uring instance, the nodes are inserted in their
+ *  shards as pending and their transfers are submitted; otherwise, they are kept out of the shards while they are read
+ *  by a single vectored transfer and inserted afterwards, unless the cluster was meanwhile stored by another access or
+ *  the shard wrote anything to the storage device, in which case the contents which was read may be out of date.
+ *  The read ahead is a hint: on failure, the nodes are released or left with no blocks stored. The caller is supposed
+ *  not to have access to any shard.
+ *
+ *  \param first number of the first node cluster of the window
+ *  \param count number of clusters of the window
+ */
+
+static void soFetchNodes (uint32_t first, uint32_t count)
+{
+  SOBufferCacheShard *sh;                        /* shard a cluster is stored in */
+  SOBufferCacheNode *node[MAX_READ_AHEAD];       /* nodes where the clusters are read into */
+  uint32_t nBlk[MAX_READ_AHEAD];                 /* physical number of the first block of the clusters */
+  void *buf[MAX_READ_AHEAD];                     /* buffers of the nodes */
+  uint32_t nWrites[MAX_READ_AHEAD];              /* number of transfers to the storage device of their shards */
+  uint32_t nClust, i, k = 0;                     /* cluster number, counter and number of clusters to be read */
+  uint32_t trigger = RA_TRIGGER;                 /* read-ahead status of the first node inserted */
+  int uring = (soGetDeviceMode () == RAW_URING); /* the transfers are asynchronous */
+  int stat;                                      /* status of operation */
+
+  /* set up free nodes for the clusters which are not stored */
+
+  for (nClust = first;
+       (nClust < first + count) && (((uint64_t) nClust + 1) * BLOCKS_PER_CLUSTER - BC->nShift <= BC->bnmax); nClust++)
+  { sh = SHARD (nClust);
+    pthread_mutex_lock (&sh->accessCR);
+    if ((searchNodeOnN (nClust, sh->nHTable, sh->nHMask) == NULL) && (soGetFreeNode (sh, &node[k]) == 0))
+       { node[k]->n = nClust;
+         node[k]->valid = 0;
+         node[k]->stat = SAME;
+         node[k]->ahead = 0;
+         nBlk[k] = nClust * BLOCKS_PER_CLUSTER - BC->nShift;
+         buf[k] = node[k]->buffer;
+         nWrites[k] = sh->nWrites;
+         if (uring)                              /* the transfer is submitted before the node may be waited for */
+            { pthread_mutex_lock (&BC->ioCR);
+              if (soSubmitRawCluster (RAW_READ, nBlk[k], buf[k], (uint64_t) (node[k] - BC->buffer)) == 0)
+                 { node[k]->ahead = RA_PENDING | trigger;
+                   trigger = 0;
+                   BC->nPending += 1;
+                   sh->nReadAhead += 1;
+                 }
+              pthread_mutex_unlock (&BC->ioCR);
+              soInsertNode (sh, node[k]);
+            }
+         k += 1;
+       }
+    pthread_mutex_unlock (&sh->accessCR);
+  }
+  if (k == 0) return;
+
+  /* hand the transfers to the device */
+
+  if (uring)
+     { pthread_mutex_lock (&BC->ioCR);
+       soCollectNodes (0);
+       pthread_mutex_unlock (&BC->ioCR);
+       return;
+     }
+
+  /* read the clusters and insert the nodes in their shards */
+
+  stat = soReadRawClusterv (k, nBlk, buf);
+  for (i = 0; i < k; i++)
+  { sh = SHARD (node[i]->n);
+    pthread_mutex_lock (&sh->accessCR);
+    if ((stat == 0) && (sh->nWrites == nWrites[i]) && (searchNodeOnN (node[i]->n, sh->nHTable, sh->nHMask) == NULL))
+       { node[i]->valid = BMASK (0, BLOCKS_PER_CLUSTER);
+         node[i]->ahead = trigger;
+         trigger = 0;
+         soInsertNode (sh, node[i]);
+         sh->nReadAhead += 1;
+       }
+       else soPutFreeNode (sh, node[i]);
+    pthread_mutex_unlock (&sh->accessCR);
+  }
+}
+
+/**
+ *  \brief Wait for the contents of a node being read ahead.
+ *
+ *  The caller is supposed to have exclusive access to the shard of the node.
+ *
+ *  \param node pointer to the node
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>specific error</em> issued by soCompleteRaw
+ */
+
+static int soWaitNode (SOBufferCacheNode *node)
+{
+  int stat = 0;                                  /* status of operation */
+
+  while ((stat == 0) && ((__atomic_load_n (&node->ahead, __ATOMIC_ACQUIRE) & RA_PENDING) != 0))
+  { pthread_mutex_lock (&BC->ioCR);
+    stat = soCollectNodes (1);
+    pthread_mutex_unlock (&BC->ioCR);
+  }
+
+  return stat;
+}
+
+/**
+ *  \brief Collect the outcome of the transfers of clusters read ahead.
+ *
+ *  The nodes whose transfer is complete are no longer pending; their contents is stored only if the transfer was
+ *  successful, otherwise it will be read again when it is accessed. A pending node is only accessed here, so the
+ *  caller is supposed to have exclusive access to the submission and collection of asynchronous transfers, but not to
+ *  the shards of the nodes.
+ *
+ *  \param min minimum number of transfers to wait for
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>specific error</em> issued by soCompleteRaw
+ */
+
+static int soCollectNodes (uint32_t min)
+{
+  SORawCompletion cmp[MAX_READ_AHEAD];           /* outcome of the transfers */
+  SOBufferCacheNode *node;                       /* node whose transfer is complete */
+  int k, i;                                      /* number of outcomes and counter */
+
+  if ((k = soCompleteRaw (min, cmp, MAX_READ_AHEAD)) < 0)
+     return k;
+  for (i = 0; i < k; i++)
+  { node = &BC->buffer[cmp[i].tag];
+    if (cmp[i].stat == 0)
+       node->valid = BMASK (0, BLOCKS_PER_CLUSTER);
+    __atomic_fetch_and (&node->ahead, ~RA_PENDING, __ATOMIC_RELEASE);
+    BC->nPending -= 1;
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Transfer a set of blocks between a node and the storage device.
+ *
+ *  Each group of successive blocks of the set is transferred in a single operation, so a whole cluster takes only one.
+ *
+ *  \param op direction of the transfer: \c RAW_READ, from the storage device; \c RAW_WRITE, to the storage device
+ *  \param node pointer to the node
+ *  \param mask set of blocks within the node
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ */
+
+static int soTransferNode (uint32_t op, SOBufferCacheNode *node, uint32_t mask)
+{
+  uint32_t first = node->n * BLOCKS_PER_CLUSTER - BC->nShift; /* physical number of the first block of the cluster */
+  uint32_t i, j;                                 /* limits of a group of successive blocks */
+  int stat;                                      /* status of operation */
+
+  for (i = 0; i < BLOCKS_PER_CLUSTER; i = j)
+  { j = i + 1;
+    if ((mask & BMASK (i, 1)) == 0) continue;
+    while ((j < BLOCKS_PER_CLUSTER) && ((mask & BMASK (j, 1)) != 0)) j++;
+    stat = (op == RAW_READ) ? soReadRawBlocks (first + i, j - i, node->buffer + i * BLOCK_SIZE)
+                            : soWriteRawBlocks (first + i, j - i, node->buffer + i * BLOCK_SIZE);
+    if (stat != 0) return stat;
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Write back the changed blocks of a set of nodes to the storage device.
+ *
+ *  The nodes are sorted by cluster number and their changed blocks are written by a single vectored transfer, so the
+ *  blocks which follow each other on the storage device, whether they belong to the same node or to successive ones,
+ *  are gathered into large sequential writes. The nodes whose changed blocks were written are marked as the same as
+ *  the storage device and each group of successive blocks is accounted as a write back transfer of the shard of its
+ *  first block. The caller is supposed to have exclusive access to the shards of all the nodes.
+ *
+ *  \param node pointer to the array of the nodes (it is sorted)
+ *  \param count number of nodes
+ *  \param mask set of blocks within each node which are to be written back, if they were changed
+ *  \param nBlk pointer to an array, with room for the blocks of all the nodes, where the physical numbers of the blocks
+ *              are stored
+ *  \param buf pointer to an array, with room for the blocks of all the nodes, where the pointers to the contents of the
+ *             blocks are stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on writing
+ */
+
+static int soWriteBackNodes (SOBufferCacheNode **node, uint32_t count, uint32_t mask, uint32_t *nBlk, void **buf)
+{
+  SOBufferCacheShard *sh;                        /* shard of the node */
+  uint32_t first;                                /* physical number of the first block of the node cluster */
+  uint32_t i, b, k;                              /* node, block and write back block counters */
+  int stat;                                      /* status of operation */
+
+  if (count > 1)
+     qsort (node, count, sizeof (SOBufferCacheNode *), soCompareNodes);
+  for (i = 0, k = 0; i < count; i++)
+  { sh = SHARD (node[i]->n);
+    sh->nWrites += 1;
+    first = node[i]->n * BLOCKS_PER_CLUSTER - BC->nShift;
+    for (b = 0; b < BLOCKS_PER_CLUSTER; b++)
+      if ((node[i]->stat & mask & BMASK (b, 1)) != 0)
+         { nBlk[k] = first + b;
+           buf[k] = node[i]->buffer + b * BLOCK_SIZE;
+           if ((k == 0) || (nBlk[k] != nBlk[k-1] + 1))
+              sh->nWbTransfers += 1;
+           sh->bytesWb += BLOCK_SIZE;
+           k += 1;
+         }
+  }
+  if ((k > 0) && ((stat = soWriteRawBlockv (k, nBlk, buf)) != 0))
+     return stat;
+  for (i = 0; i < count; i++)
+  { sh = SHARD (node[i]->n);
+    if ((node[i]->stat & mask) != 0)
+       sh->nWritebacks += 1;
+    soMarkSame (sh, node[i], mask);
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Compare two nodes by cluster number (qsort callback).
+ *
+ *  \param a pointer to the pointer to the first node
+ *  \param b pointer to the pointer to the second node
+ *
+ *  \return a negative value, zero or a positive value, if the cluster of the first node comes before, is the same as
+ *          or comes after the cluster of the second one
+ */
+
+static int soCompareNodes (const void *a, const void *b)
+{
+  uint32_t na = (*(SOBufferCacheNode * const *) a)->n;  /* cluster number of the first node */
+  uint32_t nb = (*(SOBufferCacheNode * const *) b)->n;  /* cluster number of the second node */
+
+  return (na > nb) - (na < nb);
+}
+
+/**
+ *  \brief Get the set of blocks of a node cluster which exist in the storage device.
+ *
+ *  Only the first cluster may be incomplete, since the last one ends at the end of the storage device.
+ *
+ *  \param nClust number of the node cluster
+ *
+ *  \return the set of blocks
+ */
+
+static uint32_t soNodeBlocks (uint32_t nClust)
+{
+  return (nClust == 0) ? BMASK (BC->nShift, BLOCKS_PER_CLUSTER - BC->nShift) : BMASK (0, BLOCKS_PER_CLUSTER);
+}
+
+/**
+ *  \brief Insert a node, which has just been set up, in a shard of the storage area.
+ *
+ *  With the 2Q policy, the node goes to the FIFO list of the nodes accessed once, unless its cluster is remembered by
+ *  a ghost entry; otherwise, it goes to the list based on the last access time.
+ *
+ *  \param sh pointer to the shard
+ *  \param node pointer to the node
+ */
+
+static void soInsertNode (SOBufferCacheShard *sh, SOBufferCacheNode *node)
+{
+  int32_t g = -1;                                /* ghost entry of the cluster */
+
+  if ((BC->commType == BUF2Q) && ((g = searchGhostOnN (node->n, sh->ghost, sh->gHTable, sh->gHMask)) == -1))
+     { node->queue = A1IN;
+       insertNode (node, sh->nHTable, sh->nHMask, &sh->a1inHead, &sh->a1inTail);
+       sh->nA1in += 1;
+     }
+     else { if (g != -1)
+               removeGhost (g, sh->ghost, sh->gHTable, sh->gHMask);
+            node->queue = AM;
+            insertNode (node, sh->nHTable, sh->nHMask, &sh->lATLHead, &sh->lATLTail);
+          }
+}
+
+/**
+ *  \brief Register an access to a node of a shard of the storage area.
+ *
+ *  The node is moved to the head of the list based on the last access time, if it is there; the order of the FIFO
+ *  list of the nodes accessed once (2Q policy) is not changed.
+ *
+ *  \param sh pointer to the shard
+ *  \param node pointer to the node
+ */
+
+static void soTouchNode (SOBufferCacheShard *sh, SOBufferCacheNode *node)
+{
+  if (node->queue == AM)
+     moveNodeAtHeadLAT (node, &sh->lATLHead, &sh->lATLTail);
+}
+
+/**
+ *  \brief Get a free node of a shard of the storage area.
+ *
+ *  A node which was released or never used is taken, if there is any; otherwise, the node of the shard that has not
+ *  been accessed for the longest time, and is not pinned, is retrieved and its contents, if changed, is first written
+ *  to the storage device.
+ *
+ *  \param sh pointer to the shard
+ *  \param p_node pointer to a location where the pointer to the free node is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ENOBUFS, if all the nodes of the shard are pinned
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soGetFreeNode (SOBufferCacheShard *sh, SOBufferCacheNode **p_node)
+{
+  SOBufferCacheNode *node;                       /* free node */
+  SOBufferCacheNode **p_head, **p_tail;          /* list the node is retrieved from */
+  uint32_t nSkipped, nSkippedA1in;               /* number of pinned nodes skipped, in all and on the FIFO list */
+  uint32_t nBlk[BLOCKS_PER_CLUSTER];             /* physical numbers of the blocks written back */
+  void *buf[BLOCKS_PER_CLUSTER];                 /* contents of the blocks written back */
+  int stat;                                      /* status of operation */
+
+  if (sh->freeList != NULL)
+     { *p_node = sh->freeList;
+       sh->freeList = sh->freeList->access_next;
+       (*p_node)->pins = 0;
+       return 0;
+     }
+  if (sh->nFreeBlocks > 0)
+     { sh->nFreeBlocks -= 1;
+       *p_node = &sh->buffer[sh->nFreeBlocks];
+       (*p_node)->pins = 0;
+       return 0;
+     }
+
+  /* the 2Q policy replaces first the nodes accessed once, if there are too many of them; a pinned node is skipped by
+     moving it to the head of its list */
+
+  for (nSkipped = nSkippedA1in = 0; ; nSkipped++)
+  { if (nSkipped > sh->nNodes) return -ENOBUFS;
+    if ((BC->commType == BUF2Q) && (sh->nA1in > nSkippedA1in) &&
+        ((sh->nA1in > sh->kIn) || (sh->lATLTail == NULL) || (nSkipped - nSkippedA1in >= sh->nNodes - sh->nA1in)))
+       { p_head = &sh->a1inHead;
+         p_tail = &sh->a1inTail;
+       }
+       else { p_head = &sh->lATLHead;
+              p_tail = &sh->lATLTail;
+            }
+    if (*p_tail == NULL)
+       return (nSkipped > 0) ? -ENOBUFS : -ELIBBAD;
+    if ((stat = soWaitNode (*p_tail)) != 0)
+       return stat;
+    if ((*p_tail)->pins == 0) break;
+    if (p_tail == &sh->a1inTail) nSkippedA1in += 1;
+    moveNodeAtHeadLAT (*p_tail, p_head, p_tail);
+  }
+  if ((node = retrieveNode (sh->nHTable, sh->nHMask, p_head, p_tail)) == NULL)
+     return -ELIBBAD;
+  if ((node->stat != SAME) && ((stat = soWriteBackNodes (&node, 1, BMASK (0, BLOCKS_PER_CLUSTER), nBlk, buf)) != 0))
+     { insertNode (node, sh->nHTable, sh->nHMask, p_head, p_tail);
+       return stat;                              /* the node keeps its contents */
+     }
+  sh->nEvictions += 1;
+  if (node->queue == A1IN)
+     { sh->nA1in -= 1;
+       insertGhost (node->n, sh->ghost, sh->kOut, &sh->gNext, sh->gHTable, sh->gHMask);
+     }
+  *p_node = node;
+
+  return 0;
+}
+
+/**
+ *  \brief Release a node of a shard of the storage area which is not in use.
+ *
+ *  \param sh pointer to the shard
+ *  \param node pointer to the node
+ */
+
+static void soPutFreeNode (SOBufferCacheShard *sh, SOBufferCacheNode *node)
+{
+  node->access_next = sh->freeList;
+  sh->freeList = node;
+}
+
+/**
+ *  \brief Set up a shard of the storage area.
+ *
+ *  The hash table, whose number of entries is the power of two not less than the number of nodes of the shard, and,
+ *  with the 2Q policy, the ghost entries, half as many as the nodes, and their hash table are allocated; the thresholds
+ *  of the write back of changed blocks are computed. The shard is supposed to be zeroed and its locking flag and
+ *  condition variable already initialized.
+ *
+ *  \param sh pointer to the shard
+ *  \param first pointer to the first node of the slice of the storage area
+ *  \param size number of nodes of the slice
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENOMEM, if the tables can not be allocated
+ */
+
+static int soInitShard (SOBufferCacheShard *sh, SOBufferCacheNode *first, uint32_t size)
+{
+  uint32_t i;                                    /* counter */
+
+  sh->buffer = first;
+  sh->nNodes = sh->nFreeBlocks = size;
+  sh->nHMask = 1;
+  while (sh->nHMask < size) sh->nHMask <<= 1;
+  if ((sh->nHTable = calloc (sh->nHMask, sizeof (SOBufferCacheNode *))) == NULL)
+     return -ENOMEM;
+  sh->nHMask -= 1;
+
+  if (BC->commType == BUF2Q)
+     { sh->kIn = (size + 3) / 4;
+       sh->kOut = (size + 1) / 2;
+       sh->gHMask = 1;
+       while (sh->gHMask < sh->kOut) sh->gHMask <<= 1;
+       sh->ghost = malloc ((size_t) sh->kOut * sizeof (SOBufferCacheGhost));
+       sh->gHTable = malloc ((size_t) sh->gHMask * sizeof (int32_t));
+       if ((sh->ghost == NULL) || (sh->gHTable == NULL))
+          return -ENOMEM;
+       for (i = 0; i < sh->kOut; i++)
+         sh->ghost[i].n = NULL_GHOST;
+       for (i = 0; i < sh->gHMask; i++)
+         sh->gHTable[i] = -1;
+       sh->gHMask -= 1;
+     }
+
+  sh->nDirtyBg = (uint32_t) (((uint64_t) size * BC->dirtyRatio) / 100);
+  sh->nDirtyMax = (uint32_t) (((uint64_t) size * BC->dirtyLimit) / 100);
+  if (sh->nDirtyMax <= sh->nDirtyBg) sh->nDirtyMax = sh->nDirtyBg + 1;
+
+  return 0;
+}
+
+/**
+ *  \brief Release the storage area.
+ *
+ *  The nodes, their arena, the arrays of the synchronization of the whole storage area and the shards, with their
+ *  tables, locking flags and condition variables, are freed and the internal data structure is reset.
+ */
+
+static void soFreeStorageArea (void)
+{
+  uint32_t s;                                    /* shard counter */
+
+  for (s = 0; (s < BC->nShards) && (BC->shard != NULL); s++)
+  { free (BC->shard[s].nHTable);
+    free (BC->shard[s].ghost);
+    free (BC->shard[s].gHTable);
+    pthread_mutex_destroy (&BC->shard[s].accessCR);
+    pthread_cond_destroy (&BC->shard[s].flushDone);
+  }
+  free (BC->shard);
+  free (BC->buffer);
+  free (BC->wbNode);
+  free (BC->wbBlock);
+  free (BC->wbBuf);
+  if (BC->arena != NULL)
+     munmap (BC->arena, BC->arenaSize);
+  BC->shard = NULL;
+  BC->buffer = NULL;
+  BC->wbNode = NULL;
+  BC->wbBlock = NULL;
+  BC->wbBuf = NULL;
+  BC->arena = NULL;
+  BC->arenaSize = 0;
+  BC->nNodes = BC->nShards = 0;
+  BC->raMax = BC->nPending = 0;
+}
+
+/**
+ *  \brief Allocate the arena of the contents of the nodes of the storage area.
+ *
+ *  The arena is mapped at once and page aligned. From the size of a huge page on, it is backed by huge pages, if any
+ *  are reserved, or else transparent huge pages are asked for, so that the whole storage area takes few entries of the
+ *  translation lookaside buffer.
+ *
+ *  \param size number of bytes required
+ *
+ *  \return pointer to the arena, on success
+ *  \return \c NULL, if it can not be mapped
+ */
+
+static unsigned char *soAllocArena (size_t size)
+{
+  void *p;                                       /* mapping */
+
+  if (size >= HUGE_PAGE_SIZE)
+     { size = (size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+       p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+       if (p != MAP_FAILED)
+          { BC->arenaSize = size;
+            return p;
+          }
+#endif
+     }
+  if ((p = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+     return NULL;
+#ifdef MADV_HUGEPAGE
+  if (size >= HUGE_PAGE_SIZE)
+     madvise (p, size, MADV_HUGEPAGE);
+#endif
+  BC->arenaSize = size;
+
+  return p;
+}
+
+/**
+ *  \brief Mark a set of blocks of a node as changed.
+ *
+ *  If the node had no changed blocks, it is inserted at the head of the double-linked list based on the time the
+ *  contents was changed and the flusher thread is woken up, if the number of changed nodes of the shard goes above its
+ *  threshold.
+ *
+ *  \param sh pointer to the shard of the node
+ *  \param node pointer to the node
+ *  \param mask set of blocks within the node
+ */
+
+static void soMarkChanged (SOBufferCacheShard *sh, SOBufferCacheNode *node, uint32_t mask)
+{
+  if (node->stat == SAME)
+     { node->dirtyTime = soGetTime ();
+       node->d_prev = NULL;
+       node->d_next = sh->dLHead;
+       if (sh->dLHead != NULL)
+          sh->dLHead->d_prev = node;
+          else sh->dLTail = node;
+       sh->dLHead = node;
+       sh->nDirty += 1;
+       if (BC->flusherOn && (sh->nDirty > sh->nDirtyBg))
+          soWakeFlusher ();
+     }
+  node->stat |= mask;
+}
+
+/**
+ *  \brief Mark a set of blocks of a node as the same as the corresponding blocks in the storage device.
+ *
+ *  If no changed blocks are left, the node is retrieved from the double-linked list based on the time the contents
+ *  was changed.
+ *
+ *  \param sh pointer to the shard of the node
+ *  \param node pointer to the node
+ *  \param mask set of blocks within the node
+ */
+
+static void soMarkSame (SOBufferCacheShard *sh, SOBufferCacheNode *node, uint32_t mask)
+{
+  if (node->stat == SAME) return;
+
+  node->stat &= ~mask;
+  if (node->stat != SAME) return;
+  if (node->d_prev != NULL)
+     node->d_prev->d_next = node->d_next;
+     else sh->dLHead = node->d_next;
+  if (node->d_next != NULL)
+     node->d_next->d_prev = node->d_prev;
+     else sh->dLTail = node->d_prev;
+  node->d_prev = node->d_next = NULL;
+  sh->nDirty -= 1;
+}
+
+/**
+ *  \brief Report, and clear, the errors on writing back a block by the flusher thread.
+ *
+ *  The caller is supposed not to have access to any shard.
+ *
+ *  \return <tt>0 (zero)</tt>, if no error has occurred since the last report
+ *  \return -<em>the error</em>, otherwise
+ */
+
+static int soSyncFlushErr (void)
+{
+  uint32_t s;                                    /* shard counter */
+  int stat = 0;                                  /* status of operation */
+
+  for (s = 0; s < BC->nShards; s++)
+  { pthread_mutex_lock (&BC->shard[s].accessCR);
+    if (stat == 0)
+       stat = BC->shard[s].flushErr;
+    BC->shard[s].flushErr = 0;
+    pthread_mutex_unlock (&BC->shard[s].accessCR);
+  }
+
+  return stat;
+}
+
+/**
+ *  \brief Wake up the flusher thread.
+ *
+ *  The request is remembered, so that it is not lost while the flusher thread is going through the shards.
+ */
+
+static void soWakeFlusher (void)
+{
+  pthread_mutex_lock (&BC->flushCR);
+  BC->flushWake = 1;
+  pthread_cond_signal (&BC->flushReq);
+  pthread_mutex_unlock (&BC->flushCR);
+}
+
+/**
+ *  \brief Life cycle of the flusher thread.
+ *
+ *  The thread goes through the shards, writing back a batch of the changed blocks of each, the oldest first: the ones
+ *  which have reached the given age and as many others as needed to bring the number of changed blocks of the shard
+ *  down to its threshold. The nodes of a batch are written back in the order of their clusters on the storage device.
+ *  Unless there is still work to be done, it then sleeps until the oldest changed block of any shard reaches the given
+ *  age or it is woken up because the number of changed blocks of a shard goes above its threshold. A shard where a
+ *  write error occurs is not taken as work to be done, so it is only tried again the next time the thread wakes up.
+ *  The thread works on the SOFS context of the thread which started it.
+ *
+ *  \param arg pointer to the SOFS context
+ *
+ *  \return \c NULL
+ */
+
+static void *soFlusher (void *arg)
+{
+  SOBufferCacheShard *sh;                        /* shard being written back */
+  SOBufferCacheNode *node;                       /* node being written back */
+  SOBufferCacheNode *batch[FLUSH_BATCH];         /* nodes of the batch */
+  uint32_t nBlk[FLUSH_BATCH * BLOCKS_PER_CLUSTER];  /* physical numbers of the blocks of the batch */
+  void *buf[FLUSH_BATCH * BLOCKS_PER_CLUSTER];   /* contents of the blocks of the batch */
+  uint64_t now, wake;                            /* present time and time to wake up in milliseconds */
+  struct timespec ts;                            /* time to wake up */
+  uint32_t s, nBatch;                            /* shard counter and number of nodes of the batch */
+  int busy;                                      /* there is still work to be done */
+  int stat;                                      /* status of operation */
+
+  soSetContext (arg);
+  pthread_mutex_lock (&BC->flushCR);
+  while (!BC->flusherStop)
+  { BC->flushWake = 0;
+    pthread_mutex_unlock (&BC->flushCR);
+
+    /* write back a batch of changed blocks of each shard */
+
+    now = soGetTime ();
+    wake = now + BC->flushAge;
+    busy = 0;
+    for (s = 0; s < BC->nShards; s++)
+    { sh = &BC->shard[s];
+      pthread_mutex_lock (&sh->accessCR);
+      for (nBatch = 0, node = sh->dLTail; (nBatch < FLUSH_BATCH) && (node != NULL); nBatch++, node = node->d_prev)
+      { if ((sh->nDirty - nBatch <= sh->nDirtyBg) && ((now - node->dirtyTime) < BC->flushAge))
+           break;
+        batch[nBatch] = node;
+      }
+      if ((stat = soWriteBackNodes (batch, nBatch, BMASK (0, BLOCKS_PER_CLUSTER), nBlk, buf)) != 0)
+         sh->flushErr = stat;
+      pthread_cond_broadcast (&sh->flushDone);
+      if ((stat == 0) && ((node = sh->dLTail) != NULL))
+         { if ((sh->nDirty > sh->nDirtyBg) || ((now - node->dirtyTime) >= BC->flushAge))
+              busy = 1;
+              else if (node->dirtyTime + BC->flushAge < wake)
+                      wake = node->dirtyTime + BC->flushAge;
+         }
+      pthread_mutex_unlock (&sh->accessCR);
+    }
+
+    /* sleep while there is nothing to be written back */
+
+    pthread_mutex_lock (&BC->flushCR);
+    if (!busy && !BC->flushWake && !BC->flusherStop)
+       { ts.tv_sec = (time_t) (wake / 1000);
+         ts.tv_nsec = (long) (wake % 1000) * 1000000L;
+         pthread_cond_timedwait (&BC->flushReq, &BC->flushCR, &ts);
+       }
+  }
+  pthread_mutex_unlock (&BC->flushCR);
+
+  return NULL;
+}
+
+/**
+ *  \brief Get the present time.
+ *
+ *  \return the time in milliseconds elapsed since an unspecified starting point
+ */
+
+static uint64_t soGetTime (void)
+{
+  struct timespec ts;                            /* present time */
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+/**
+ *  \brief Set up the state of the buffercache in a context.
+ *
+ *  \param state pointer to the state
+ */
+
+static void soInitState (void *state)
+{
+  SOBufferCacheState *bc = state;                /* pointer to the state */
+
+  memset (bc, 0, sizeof (SOBufferCacheState));
+  bc->commType = BUF;
+  bc->cacheSize = DEF_CACHE_SIZE;
+  bc->cacheShards = DEF_CACHE_SHARDS;
+  bc->flushAge = DEF_FLUSH_AGE;
+  bc->dirtyRatio = DEF_DIRTY_RATIO;
+  bc->dirtyLimit = DEF_DIRTY_LIMIT;
+  bc->readAhead = DEF_READ_AHEAD;
+  pthread_mutex_init (&bc->flushCR, NULL);
+  pthread_mutex_init (&bc->aheadCR, NULL);
+  pthread_mutex_init (&bc->ioCR, NULL);
+  pthread_mutex_init (&bc->pinCR, NULL);
+}
+
+/**
+ *  \brief Register the state of the buffercache, before <tt>main</tt> is called.
+ */
+
+static void __attribute__ ((constructor)) soRegisterState (void)
+{
+  soRegisterContextState (CTX_BUFFERCACHE, sizeof (SOBufferCacheState), soInitState, &defState);
+}
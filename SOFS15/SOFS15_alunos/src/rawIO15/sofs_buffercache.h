@@ -10,7 +10,11 @@
  *  probability of access in the near future is higher.
  *
  *  The buffercache may be regarded as a storage area resident in main memory having the ability to store K data blocks
- *  of the device's storage space.
+ *  of the device's storage space. K is set by soSetBufferCacheSize, before the storage area is initialized.
+ *  The storage area is organized in clusters: a block is stored along with the other blocks of the same cluster, a
+ *  cluster being aligned on the end of the device, where the data zone ends. It is split in shards, set by
+ *  soSetBufferCacheShards, each one holding the clusters whose number is the same modulo the number of shards and
+ *  managed on its own, so that the accesses to clusters of different shards may be carried out in parallel.
  *  Data transfer between the main memory and the device works according to the following rules:
  *    \li every time a data block (cluster) is required for reading, it is looked up in the storage area: if it is
  *        there, the contents is copied to the supplied buffer location; otherwise, it is first read from the device
@@ -21,11 +25,27 @@
  *        a new node in the storage area is initialized to this data block (cluster), the contents of the supplied
  *        buffer is copied into it and its status is marked <em>changed</em>, as before
  *    \li because the number of nodes in the storage area is finite, whenever it happens that no more free nodes are
- *        available, the node that has not been accessed for the longest time is selected for replacement: its contents,
- *        if needed (the status is marked <em>changed</em>), is first transfered to the device, then it becomes
- *        available for a new assignment.
+ *        available in a shard, its node that has not been accessed for the longest time is selected for replacement:
+ *        its contents, if needed (the status is marked <em>changed</em>), is first transfered to the device, then it
+ *        becomes available for a new assignment (with the 2Q policy, the nodes accessed only once are selected first,
+ *        so that a sequential scan does not replace the frequently accessed ones)
+ *    \li the contents of the blocks marked <em>changed</em> is transfered to the device in the background, by a flusher
+ *        thread, when it has been changed for longer than a given age or when the number of such blocks goes above a
+ *        given fraction of the shard; writers are held back while it is above a second, higher, fraction
+ *    \li when successive clusters are read one after the other, the following ones are read ahead, in a window
+ *        whose size doubles as long as the sequential access goes on, up to a maximum set by
+ *        soSetBufferCacheReadAhead
+ *    \li synchronization, of a block, a cluster or the whole storage area on closing, forces the contents to stable
+ *        storage
+ *    \li a data block (cluster) may be pinned instead, to be accessed in place: a pointer to its contents in the
+ *        storage area is supplied and its node is not selected for replacement until it is unpinned; when its
+ *        contents is changed through the pointer, it must be marked <em>changed</em> explicitly.
  *
  *  The following operations are defined:
+ *    \li set the number of blocks of the storage area
+ *    \li set the number of shards of the storage area
+ *    \li set the parameters of the write back of changed blocks
+ *    \li set the maximum number of clusters read ahead
  *    \li initialize the storage area and assign it to the storage device
  *    \li unassign the storage area from the storage device and perform the required housekeeping duties
  *    \li read a block of data from the buffercache
@@ -35,7 +55,12 @@
  *    \li read a cluster of data from the buffercache
  *    \li write a cluster of data to the buffercache
  *    \li flush a cluster of data to the storage device
- *    \li synchronize a cluster of data with the same cluster in the storage device.
+ *    \li synchronize a cluster of data with the same cluster in the storage device
+ *    \li synchronize the whole storage area with the storage device
+ *    \li pin a block / cluster of data and get a pointer to its contents in the buffercache
+ *    \li mark a pinned block / cluster of data as changed
+ *    \li unpin a block / cluster of data
+ *    \li get the statistics of the buffercache and of the storage device.
  *
  *  \author Artur Carneiro Pereira - September 2007
  *  \author Miguel Oliveira e Silva - September 2009
@@ -50,18 +75,150 @@
 #define SOFS_BUFFERCACHE_H_
 
 #include <stdint.h>
+
+#include "sofs_rawdisk.h"
+
 /** \brief the communication channel to the storage device is buffered */
 #define BUF    0
 /** \brief the communication channel to the storage device is unbuffered */
 #define UNBUF  1
+/** \brief the communication channel to the storage device is buffered, with the 2Q replacement policy */
+#define BUF2Q  2
+
+/** \brief default number of blocks of the storage area */
+#define DEF_CACHE_SIZE  100
+/** \brief default number of shards of the storage area */
+#define DEF_CACHE_SHARDS 8
+/** \brief upper bound of the number of shards of the storage area */
+#define MAX_CACHE_SHARDS 64
+/** \brief default age in milliseconds above which a changed block is written back */
+#define DEF_FLUSH_AGE   3000
+/** \brief default percentage of the storage area above which changed blocks are written back */
+#define DEF_DIRTY_RATIO 10
+/** \brief default percentage of the storage area above which writers are held back */
+#define DEF_DIRTY_LIMIT 20
+/** \brief default maximum number of clusters read ahead at a time */
+#define DEF_READ_AHEAD  16
+/** \brief upper bound of the maximum number of clusters read ahead at a time */
+#define MAX_READ_AHEAD  64
+
+/**
+ *  \brief Definition of the statistics of the buffercache.
+ *
+ *  An access is the read or the write of the blocks of a single node cluster, so a cluster which is not aligned on a
+ *  node cluster takes two. A read is a hit, if all the blocks are stored; a write, if the cluster is. The counters
+ *  are kept since the storage area was initialized; with an unbuffered communication channel, only the statistics of
+ *  the storage device are meaningful.
+ */
+
+typedef struct soBufferCacheStats
+{
+   /** \brief number of accesses whose cluster was stored with all the blocks required */
+    uint64_t nHits;
+   /** \brief number of accesses whose cluster, or some of the blocks required, had to be set up */
+    uint64_t nMisses;
+   /** \brief number of nodes replaced */
+    uint64_t nEvictions;
+   /** \brief number of nodes whose changed blocks were written back, on replacement, by the flusher thread or on
+    *         synchronization */
+    uint64_t nWritebacks;
+   /** \brief number of transfers which wrote back changed blocks: changed blocks which follow each other on the storage
+    *         device are written back by a single transfer */
+    uint64_t nWritebackIOs;
+   /** \brief number of bytes written back */
+    uint64_t bytesWriteback;
+   /** \brief average size in bytes of the transfers which wrote back changed blocks */
+    uint64_t avgWritebackIO;
+   /** \brief number of flush and synchronization accesses */
+    uint64_t nFlushes;
+   /** \brief number of clusters read ahead */
+    uint64_t nReadAhead;
+   /** \brief number of bytes read from the buffercache */
+    uint64_t bytesRead;
+   /** \brief number of bytes written to the buffercache, or flushed through it */
+    uint64_t bytesWritten;
+   /** \brief number of nodes of the storage area */
+    uint32_t nNodes;
+   /** \brief number of nodes in use */
+    uint32_t nUsed;
+   /** \brief number of nodes whose contents was changed */
+    uint32_t nDirty;
+   /** \brief statistics of the transfers of the storage device */
+    SORawStats dev;
+} SOBufferCacheStats;
+
+/**
+ *  \brief Set the number of blocks of the storage area.
+ *
+ *  The value takes effect on the next initialization of a buffered communication channel and remains in force for
+ *  subsequent ones. It is rounded up to a whole number of clusters.
+ *
+ *  \param nBlocks number of blocks of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of blocks</em> is zero
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+extern int soSetBufferCacheSize (uint32_t nBlocks);
+
+/**
+ *  \brief Set the number of shards of the storage area.
+ *
+ *  The value takes effect on the next initialization of a buffered communication channel and remains in force for
+ *  subsequent ones. It is reduced, if needed, so that every shard has at least sixteen nodes.
+ *
+ *  \param n number of shards of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of shards</em> is zero or greater than \c MAX_CACHE_SHARDS
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+extern int soSetBufferCacheShards (uint32_t n);
+
+/**
+ *  \brief Set the parameters of the write back of changed blocks.
+ *
+ *  The values take effect on the next initialization of a buffered communication channel and remain in force for
+ *  subsequent ones. The percentages apply to each shard of the storage area.
+ *
+ *  \param age age in milliseconds above which a changed block is written back by the flusher thread (\c 0 means no
+ *             flusher thread: changed blocks are only written on replacement or synchronization)
+ *  \param ratio percentage of the storage area above which changed blocks are written back by the flusher thread
+ *  \param limit percentage of the storage area above which writers are held back
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>limit</em> is zero or greater than 100, or the <em>ratio</em> is greater than it
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+extern int soSetBufferCacheFlush (uint32_t age, uint32_t ratio, uint32_t limit);
+
+/**
+ *  \brief Set the maximum number of clusters read ahead.
+ *
+ *  The value takes effect on the next initialization of a buffered communication channel and remains in force for
+ *  subsequent ones. It is further limited to a fourth of the number of nodes of the storage area, so that a read-ahead
+ *  window never replaces the previous one.
+ *
+ *  \param window maximum number of clusters read ahead at a time (\c 0 means read-ahead is disabled)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>window</em> is greater than \c MAX_READ_AHEAD
+ *  \return -\c EBUSY, if the storage area is in use
+ */
+
+extern int soSetBufferCacheReadAhead (uint32_t window);
 
 /**
  *  \brief Initialize the storage area and assign it to the storage device.
  *
  *  A communication channel is established with the storage device so that data transfers between main memory and the
  *  storage device may be minimized.
- *  This communication may be unbuffered or buffered: it will be unbuffered, if the second argument is \c UNBUF , and
- *  buffered, in any other case.
+ *  This communication may be unbuffered or buffered: it will be unbuffered, if the second argument is \c UNBUF ,
+ *  buffered with the 2Q replacement policy, if it is \c BUF2Q , and buffered with the least recently used replacement
+ *  policy, in any other case. When it is buffered, the flusher thread is started.
  *
  *  \param devname absolute path to the Linux file that simulates the storage device
  *  \param type type of the communication channel that is opened
@@ -69,8 +226,10 @@
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EINVAL, if the argument is \c NULL
  *  \return -\c EBUSY, if the storage area is already in use or the device is already opened
+ *  \return -\c ENOMEM, if the storage area can not be allocated
  *  \return -\c ELIBBAD, if the supporting file size is invalid
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e open or \e fstat system calls, or by \e pthread_create library
+ *          function
  */
 
 extern int soOpenBufferCache (const char *devname, uint32_t type);
@@ -79,14 +238,14 @@ extern int soOpenBufferCache (const char *devname, uint32_t type);
  *  \brief Unassign the storage area from the storage device and perform the required housekeeping duties.
  *
  *  The buffered/unbuffered communication channel previously established with the storage device is closed.
- *  This means, namely, that the contents of the storage area is flushed into the storage device to keep data
- *  consistent.
+ *  This means, namely, that the flusher thread is terminated and the contents of the storage area is flushed into the
+ *  storage device and forced to stable storage to keep data consistent. The blocks and clusters which are still pinned
+ *  are unpinned.
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
  *  \return -\c ELIBBAD, if the internal data is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soCloseBufferCache (void);
@@ -105,7 +264,6 @@ extern int soCloseBufferCache (void);
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading or writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soReadCacheBlock (uint32_t n, void *buf);
@@ -115,6 +273,8 @@ extern int soReadCacheBlock (uint32_t n, void *buf);
  *
  *  Both the physical number of the data block to be written and a pointer to a previously allocated buffer are supplied
  *  as arguments.
+ *  The block is only marked as changed: it is written to the storage device later on, by the flusher thread or when
+ *  its node is selected for replacement. The caller is held back while too many blocks are waiting to be written.
  *
  *  \param n physical number of the block to be written into
  *  \param buf pointer to the buffer containing the data to be written from
@@ -124,7 +284,6 @@ extern int soReadCacheBlock (uint32_t n, void *buf);
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soWriteCacheBlock (uint32_t n, void *buf);
@@ -143,7 +302,6 @@ extern int soWriteCacheBlock (uint32_t n, void *buf);
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soFlushCacheBlock (uint32_t n, void *buf);
@@ -152,15 +310,15 @@ extern int soFlushCacheBlock (uint32_t n, void *buf);
  *  \brief Synchronize a block of data with the same block in the storage device.
  *
  *  The physical number of the data block to be synchronized is supplied as argument.
+ *  The block is then forced to stable storage.
  *
  *  \param n physical number of the block to be synchronized
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EINVAL, if <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
- *  \return -\c EIO, if it fails on writing
+ *  \return -\c EIO, if it fails on writing, now or previously by the flusher thread
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soSyncCacheBlock (uint32_t n);
@@ -180,7 +338,6 @@ extern int soSyncCacheBlock (uint32_t n);
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading or writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soReadCacheCluster (uint32_t n, void *buf);
@@ -191,6 +348,7 @@ extern int soReadCacheCluster (uint32_t n, void *buf);
  *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
  *  Both the physical number of the first block of the data cluster to be written and a pointer to a previously
  *  allocated buffer are supplied as arguments.
+ *  The blocks are only marked as changed, as in soWriteCacheBlock.
  *
  *  \param n physical number of the first block of the data cluster to be written into
  *  \param buf pointer to the buffer containing the data to be written from
@@ -200,7 +358,6 @@ extern int soReadCacheCluster (uint32_t n, void *buf);
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soWriteCacheCluster (uint32_t n, void *buf);
@@ -220,7 +377,6 @@ extern int soWriteCacheCluster (uint32_t n, void *buf);
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soFlushCacheCluster (uint32_t n, void *buf);
@@ -230,17 +386,157 @@ extern int soFlushCacheCluster (uint32_t n, void *buf);
  *
  *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
  *  The physical number of the data cluster to be synchronized is supplied as argument.
+ *  The cluster is then forced to stable storage.
  *
  *  \param n physical number of the first block of the data cluster to be synchronized
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EINVAL, if <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
- *  \return -\c EIO, if it fails on writing
+ *  \return -\c EIO, if it fails on writing, now or previously by the flusher thread
  *  \return -\c ELIBBAD, if the buffercache is inconsistent
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soSyncCacheCluster (uint32_t n);
 
+/**
+ *  \brief Synchronize the whole storage area with the storage device.
+ *
+ *  The changed blocks of all the nodes are written back, sorted by block number, so that the blocks which follow each
+ *  other on the storage device are gathered into single vectored writes, and the storage device is forced to stable
+ *  storage.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing, now or previously by the flusher thread
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soSyncBufferCache (void);
+
+/**
+ *  \brief Pin a block of data and get a pointer to its contents in the buffercache.
+ *
+ *  The block is read into the storage area, if it is not there, and its node is not selected for replacement until
+ *  it is unpinned, so the contents may be read and changed in place, with no copy involved. Changes must be followed
+ *  by soMarkCacheBlock to be written to the storage device. A block may be pinned more than once; it has to be
+ *  unpinned as many times.
+ *
+ *  \param n physical number of the data block to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the block is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ENOBUFS, if all the nodes which could store the block, or all the private copies, are pinned
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soGetCacheBlock (uint32_t n, void **p_buf);
+
+/**
+ *  \brief Mark a pinned block of data as changed.
+ *
+ *  The block is written to the storage device later on, as if it had been written by soWriteCacheBlock; with an
+ *  unbuffered communication channel, it is written at once.
+ *
+ *  \param n physical number of the data block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+extern int soMarkCacheBlock (uint32_t n);
+
+/**
+ *  \brief Unpin a block of data.
+ *
+ *  The pointer to its contents is no longer valid, unless it is still pinned by a previous call.
+ *
+ *  \param n physical number of the data block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not pinned
+ */
+
+extern int soPutCacheBlock (uint32_t n);
+
+/**
+ *  \brief Pin a cluster of data and get a pointer to its contents in the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The cluster must be stored in a single node, which is the case of every data cluster, since the node clusters end
+ *  where the data zone ends. Otherwise, it behaves as soGetCacheBlock.
+ *
+ *  \param n physical number of the first block of the data cluster to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL, the <em>block number</em> is out of range or the cluster
+ *          is not aligned on a node cluster
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ENOBUFS, if all the nodes which could store the cluster, or all the private copies, are pinned
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soGetCacheCluster (uint32_t n, void **p_buf);
+
+/**
+ *  \brief Mark a pinned cluster of data as changed.
+ *
+ *  The cluster is written to the storage device later on, as if it had been written by soWriteCacheCluster; with an
+ *  unbuffered communication channel, it is written at once.
+ *
+ *  \param n physical number of the first block of the data cluster
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+extern int soMarkCacheCluster (uint32_t n);
+
+/**
+ *  \brief Unpin a cluster of data.
+ *
+ *  The pointer to its contents is no longer valid, unless it is still pinned by a previous call.
+ *
+ *  \param n physical number of the first block of the data cluster
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not pinned
+ */
+
+extern int soPutCacheCluster (uint32_t n);
+
+/**
+ *  \brief Get the statistics of the buffercache and of the storage device.
+ *
+ *  The statistics of the shards are added up one shard at a time, so accesses may go on meanwhile.
+ *
+ *  \param p_stats pointer to a location where the statistics are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ */
+
+extern int soGetBufferCacheStats (SOBufferCacheStats *p_stats);
+
+/**
+ *  \brief Get the generation of the storage area.
+ *
+ *  It is incremented each time the storage device is opened or closed, so that a layer above which keeps pointers to
+ *  pinned blocks or clusters can find out they belong to a storage area which no longer exists.
+ *
+ *  \return generation of the storage area
+ */
+
+extern uint32_t soGetBufferCacheGen (void);
+
 #endif /* SOFS_BUFFERCACHE_H_ */
@@ -0,0 +1,287 @@
+/**
+ *  \file sofs_buffercacheinternals.c (implementation file)
+ *
+ *  \brief Set of operations to internally manage the buffercache.
+ *
+ *  The buffercache is conceived as a hash table of double-linked lists, indexed by the number of the cluster of the
+ *  storage device it is referencing, and a double-linked list based on the order of last access to the cluster. Hence,
+ *  one needs to define operations to insert, retrieve and access its nodes.
+ *  One should notice that this module does not stand alone: it supposes a very tight coupling with the buffercache
+ *  implementation, its only application.
+ *
+ *  The following operations are defined:
+ *    \li access the first node of the double-linked list based on the last access time
+ *    \li access the next node of the double-linked list based on the last access time
+ *    \li check if a given cluster, whose number is given, has already been stored in the storage area
+ *    \li insert a node in the hash table and in the double-linked list based on the last access time
+ *    \li retrieve a node from the hash table and from the double-linked list based on the last access time
+ *    \li move a node already present in the storage area to the head of the double-linked list based on the last access
+ *        time
+ *    \li check if a given cluster, whose number is given, is remembered by a ghost entry (2Q policy)
+ *    \li insert a ghost entry of a given cluster
+ *    \li remove a ghost entry.
+ *
+ *  \author António Rui Borges - July 2010 / August 2011
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "sofs_buffercachenode.h"
+#include "sofs_buffercacheinternals.h"
+
+/*
+ *  Internal data structure
+ */
+/** \brief Iterator over the double-linked list based on the last access time */
+static SOBufferCacheNode *nodeIt = NULL;
+
+/**
+ *  \brief Access the first node of the double-linked list based on the last access time.
+ *
+ *  An iterator internal variable is set to the value of the argument and a pointer to the node pointed to by the
+ *  iterator variable is returned.
+ *
+ *  \param head pointer to the head of the linked list based on the last access time
+ *
+ *  \return value of the <em>iterator</em> variable
+ */
+
+SOBufferCacheNode *getFirstNodeOnLAT (SOBufferCacheNode *head)
+{
+  nodeIt = head;
+
+  return nodeIt;
+}
+
+/**
+ *  \brief Access the next node of the double-linked list based on the last access time.
+ *
+ *  The iterator internal variable is iterated if it does not already point to the last node of the linked list, and
+ *  a pointer to the node pointed to by the iterator variable is returned.
+ *
+ *  \return value of the <em>iterator</em> variable
+ */
+
+SOBufferCacheNode *getNextNodeOnLAT (void)
+{
+  if (nodeIt != NULL)
+     nodeIt = nodeIt->access_next;
+
+  return nodeIt;
+}
+
+/**
+ *  \brief Check if a given cluster, whose number is given, has already been stored in the storage area.
+ *
+ *  The double-linked list of the hash table entry which the cluster falls on, is traversed to find out if there is a
+ *  node whose contents belongs to the cluster whose number is passed as the first argument.
+ *
+ *  \param nClust cluster number
+ *  \param nHTable pointer to the hash table based on the cluster number of the storage device
+ *  \param nHMask number of entries of the hash table minus one
+ *
+ *  \return pointer to the node where the cluster contents is stored, or \c NULL if the cluster has not been stored yet
+ */
+
+SOBufferCacheNode *searchNodeOnN (uint32_t nClust, SOBufferCacheNode **nHTable, uint32_t nHMask)
+{
+  SOBufferCacheNode *node;                       /* node being checked */
+
+  for (node = nHTable[NHASH (nClust, nHMask)]; node != NULL; node = node->n_next)
+    if (node->n == nClust) break;
+
+  return node;
+}
+
+/**
+ *  \brief Insert a node in the hash table and in the double-linked list based on the last access time.
+ *
+ *  A node whose contents belongs to a cluster of the storage device, which is supposed not to be stored in the storage
+ *  area yet, is inserted at the head of the list of its hash table entry and at the head of the double-linked list
+ *  based on the last access time. If the node pointer is \c NULL, nothing is done.
+ *
+ *  \param node pointer to the node to be inserted
+ *  \param nHTable pointer to the hash table based on the cluster number of the storage device
+ *  \param nHMask number of entries of the hash table minus one
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ */
+
+void insertNode (SOBufferCacheNode *node, SOBufferCacheNode **nHTable, uint32_t nHMask,
+                 SOBufferCacheNode **p_lATLHead, SOBufferCacheNode **p_lATLTail)
+{
+  SOBufferCacheNode **p_entry;                   /* pointer to the hash table entry of the node */
+
+  if (node == NULL) return;
+
+  /* insertion in the list of the hash table entry */
+
+  p_entry = &nHTable[NHASH (node->n, nHMask)];
+  node->n_prev = NULL;
+  node->n_next = *p_entry;
+  if (*p_entry != NULL)
+     (*p_entry)->n_prev = node;
+  *p_entry = node;
+
+  /* insertion at the head of the list based on the last access time */
+
+  node->access_prev = NULL;
+  node->access_next = *p_lATLHead;
+  if (*p_lATLHead != NULL)
+     (*p_lATLHead)->access_prev = node;
+     else *p_lATLTail = node;
+  *p_lATLHead = node;
+}
+
+/**
+ *  \brief Retrieve a node from the hash table and from the double-linked list based on the last access time.
+ *
+ *  The node which the tail of the double-linked list based on last access time points to, is retrieved from the list
+ *  of its hash table entry and from the double-linked list based on the last access time.
+ *
+ *  \param nHTable pointer to the hash table based on the cluster number of the storage device
+ *  \param nHMask number of entries of the hash table minus one
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ *
+ *  \return pointer to the retrieved node, or \c NULL if the storage area is empty
+ */
+
+SOBufferCacheNode *retrieveNode (SOBufferCacheNode **nHTable, uint32_t nHMask, SOBufferCacheNode **p_lATLHead,
+                                 SOBufferCacheNode **p_lATLTail)
+{
+  SOBufferCacheNode *node = *p_lATLTail;         /* node to be retrieved */
+
+  if (node == NULL) return NULL;
+
+  /* retrieval from the list of the hash table entry */
+
+  if (node->n_prev != NULL)
+     node->n_prev->n_next = node->n_next;
+     else nHTable[NHASH (node->n, nHMask)] = node->n_next;
+  if (node->n_next != NULL)
+     node->n_next->n_prev = node->n_prev;
+
+  /* retrieval from the tail of the list based on the last access time */
+
+  *p_lATLTail = node->access_prev;
+  if (node->access_prev != NULL)
+     node->access_prev->access_next = NULL;
+     else *p_lATLHead = NULL;
+
+  node->n_prev = node->n_next = node->access_prev = node->access_next = NULL;
+
+  return node;
+}
+
+/**
+ *  \brief Move the node to the head of the double-linked list based on last access time.
+ *
+ *  The node which is supposed to have been accessed, is retrieved from its location in the double-linked list based on
+ *  the last access time and placed at the head of the list. If the node pointer is \c NULL, nothing is done.
+ *
+ *  \param node pointer to the node to be inserted
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ */
+
+void moveNodeAtHeadLAT (SOBufferCacheNode *node, SOBufferCacheNode **p_lATLHead, SOBufferCacheNode **p_lATLTail)
+{
+  if ((node == NULL) || (node == *p_lATLHead)) return;
+
+  /* retrieval from its present location (it is not the head, so it has a predecessor) */
+
+  node->access_prev->access_next = node->access_next;
+  if (node->access_next != NULL)
+     node->access_next->access_prev = node->access_prev;
+     else *p_lATLTail = node->access_prev;
+
+  /* insertion at the head */
+
+  node->access_prev = NULL;
+  node->access_next = *p_lATLHead;
+  (*p_lATLHead)->access_prev = node;
+  *p_lATLHead = node;
+}
+
+/**
+ *  \brief Check if a given cluster, whose number is given, is remembered by a ghost entry.
+ *
+ *  The single-linked list of the hash table entry which the cluster falls on, is traversed to find out if there is a
+ *  ghost entry of the cluster whose number is passed as the first argument.
+ *
+ *  \param nClust cluster number
+ *  \param ghost pointer to the array of ghost entries
+ *  \param gHTable pointer to the hash table of the ghost entries based on the cluster number
+ *  \param gHMask number of entries of the hash table minus one
+ *
+ *  \return index of the ghost entry, or <tt>-1</tt> if the cluster is not remembered
+ */
+
+int32_t searchGhostOnN (uint32_t nClust, SOBufferCacheGhost *ghost, int32_t *gHTable, uint32_t gHMask)
+{
+  int32_t g;                                     /* ghost entry being checked */
+
+  for (g = gHTable[NHASH (nClust, gHMask)]; g != -1; g = ghost[g].n_next)
+    if (ghost[g].n == nClust) break;
+
+  return g;
+}
+
+/**
+ *  \brief Insert a ghost entry of a given cluster.
+ *
+ *  The ghost entry which the circular index points to is reused for the cluster whose number is passed as the first
+ *  argument (it is first removed from the list of its hash table entry, if it is in use), inserted at the head of the
+ *  list of its new hash table entry, and the circular index is advanced.
+ *
+ *  \param nClust cluster number
+ *  \param ghost pointer to the array of ghost entries
+ *  \param gSize number of ghost entries
+ *  \param p_gNext pointer to a location where the circular index of the next ghost entry to be used is stored
+ *  \param gHTable pointer to the hash table of the ghost entries based on the cluster number
+ *  \param gHMask number of entries of the hash table minus one
+ */
+
+void insertGhost (uint32_t nClust, SOBufferCacheGhost *ghost, uint32_t gSize, uint32_t *p_gNext, int32_t *gHTable,
+                  uint32_t gHMask)
+{
+  int32_t g = (int32_t) *p_gNext;                /* ghost entry to be used */
+
+  if (ghost[g].n != NULL_GHOST)
+     removeGhost (g, ghost, gHTable, gHMask);
+  ghost[g].n = nClust;
+  ghost[g].n_next = gHTable[NHASH (nClust, gHMask)];
+  gHTable[NHASH (nClust, gHMask)] = g;
+  *p_gNext = (*p_gNext + 1) % gSize;
+}
+
+/**
+ *  \brief Remove a ghost entry.
+ *
+ *  The ghost entry is retrieved from the list of its hash table entry and marked as not in use.
+ *
+ *  \param g index of the ghost entry
+ *  \param ghost pointer to the array of ghost entries
+ *  \param gHTable pointer to the hash table of the ghost entries based on the cluster number
+ *  \param gHMask number of entries of the hash table minus one
+ */
+
+void removeGhost (int32_t g, SOBufferCacheGhost *ghost, int32_t *gHTable, uint32_t gHMask)
+{
+  int32_t *p_g;                                  /* link to the ghost entry being checked */
+
+  for (p_g = &gHTable[NHASH (ghost[g].n, gHMask)]; *p_g != -1; p_g = &ghost[*p_g].n_next)
+    if (*p_g == g)
+       { *p_g = ghost[g].n_next;
+         break;
+       }
+  ghost[g].n = NULL_GHOST;
+}
@@ -3,20 +3,28 @@
  *
  *  \brief Set of operations to internally manage the buffercache.
  *
- *  The buffercache is conceived as two double-linked lists: the first, based on the physical block number of the
- *  storage device it is referencing; the second, based on the order of last access to the block. Hence, one needs to
- *  define operations to insert, retrieve and access its nodes.
+ *  The buffercache is conceived as a hash table of double-linked lists, indexed by the number of the cluster of the
+ *  storage device it is referencing, and a double-linked list based on the order of last access to the cluster. Hence,
+ *  one needs to define operations to insert, retrieve and access its nodes.
+ *  The hash table has a power of two number of entries, not less than the number of nodes of the storage area, and the
+ *  entry of a cluster is given by the least significant bits of the upper half of the product of its number by a large
+ *  odd constant (Fibonacci hashing): the clusters of a shard of the storage area, whose numbers are congruent modulo
+ *  the number of shards, are spread over all the entries and each list holds, on average, at most one node, so the
+ *  search for a cluster takes constant time whatever the size of the storage area.
  *  One should notice that this module does not stand alone: it supposes a very tight coupling with the buffercache
  *  implementation, its only application.
  *
  *  The following operations are defined:
- *    \li access the first node of the double-linked list based on the physical block number of the storage device
- *    \li access the next node of the double-linked list based on the physical block number of the storage device
- *    \li check if a given block, whose physical number is given, has already been stored in the storage area
- *    \li insert a node in the two double-linked lists infrastructure
- *    \li retrieve a node from the two double-linked lists infrastructure
+ *    \li access the first node of the double-linked list based on the last access time
+ *    \li access the next node of the double-linked list based on the last access time
+ *    \li check if a given cluster, whose number is given, has already been stored in the storage area
+ *    \li insert a node in the hash table and in the double-linked list based on the last access time
+ *    \li retrieve a node from the hash table and from the double-linked list based on the last access time
  *    \li move a node already present in the storage area to the head of the double-linked list based on the last access
- *        time.
+ *        time
+ *    \li check if a given cluster, whose number is given, is remembered by a ghost entry (2Q policy)
+ *    \li insert a ghost entry of a given cluster
+ *    \li remove a ghost entry.
  *
  *  \author António Rui Borges - July 2010 / August 2011
  */
@@ -28,21 +36,24 @@
 
 #include "sofs_buffercachenode.h"
 
+/** \brief entry of the hash table where the node of a cluster is stored */
+#define NHASH(nClust,mask) ((uint32_t) (((uint64_t) (nClust) * 0x9E3779B97F4A7C15ULL) >> 32) & (mask))
+
 /**
- *  \brief Access the first node of the double-linked list based on the physical block number of the storage device.
+ *  \brief Access the first node of the double-linked list based on the last access time.
  *
  *  An iterator internal variable is set to the value of the argument and a pointer to the node pointed to by the
  *  iterator variable is returned.
  *
- *  \param head pointer to the head of the linked list based on the physical block number of the storage device
+ *  \param head pointer to the head of the linked list based on the last access time
  *
  *  \return value of the <em>iterator</em> variable
  */
 
-extern SOBufferCacheNode *getFirstNodeOnN (SOBufferCacheNode *head);
+extern SOBufferCacheNode *getFirstNodeOnLAT (SOBufferCacheNode *head);
 
 /**
- *  \brief Access the next node of the double-linked list based on the physical block number of the storage device.
+ *  \brief Access the next node of the double-linked list based on the last access time.
  *
  *  The iterator internal variable is iterated if it does not already point to the last node of the linked list, and
  *  a pointer to the node pointed to by the iterator variable is returned.
@@ -50,67 +61,66 @@ extern SOBufferCacheNode *getFirstNodeOnN (SOBufferCacheNode *head);
  *  \return value of the <em>iterator</em> variable
  */
 
-extern SOBufferCacheNode *getNextNodeOnN (void);
+extern SOBufferCacheNode *getNextNodeOnLAT (void);
 
 /**
- *  \brief Check if a given block, whose physical number is given, has already been stored in the storage area.
+ *  \brief Check if a given cluster, whose number is given, has already been stored in the storage area.
  *
- *  The double-linked list based on the physical block number of the storage device is traversed from the node pointed
- *  to by the second argument to find out if there is a node whose contents belongs to the block whose physical number
- *  is passed as the first argument.
+ *  The double-linked list of the hash table entry which the cluster falls on, is traversed to find out if there is a
+ *  node whose contents belongs to the cluster whose number is passed as the first argument.
  *
- *  \param nBlock physical block number
- *  \param head pointer to the head of the linked list based on the block number of the storage device
+ *  \param nClust cluster number
+ *  \param nHTable pointer to the hash table based on the cluster number of the storage device
+ *  \param nHMask number of entries of the hash table minus one
  *
- *  \return pointer to the node where the block contents is stored, or \c NULL if the block has not been stored yet
+ *  \return pointer to the node where the cluster contents is stored, or \c NULL if the cluster has not been stored yet
  */
 
-extern SOBufferCacheNode *searchNodeOnN (uint32_t nBlock, SOBufferCacheNode *head);
+extern SOBufferCacheNode *searchNodeOnN (uint32_t nClust, SOBufferCacheNode **nHTable, uint32_t nHMask);
 
 /**
- *  \brief Insert a node in the two double-linked lists infrastructure.
+ *  \brief Insert a node in the hash table and in the double-linked list based on the last access time.
  *
- *  A node whose contents belongs to a block of the storage device, which is supposed not to be stored in the storage
- *  area yet, is inserted in the two double-linked lists infrastructure. If the node is already present or the storage
- *  area is inconsistent, nothing is done.
+ *  A node whose contents belongs to a cluster of the storage device, which is supposed not to be stored in the storage
+ *  area yet, is inserted at the head of the list of its hash table entry and at the head of the double-linked list
+ *  based on the last access time. If the node pointer is \c NULL, nothing is done.
  *
  *  \param node pointer to the node to be inserted
- *  \param p_nLHead pointer to a location where the pointer to the head of the double linked list based on the physical
- *                  block number of the storage device, is stored
+ *  \param nHTable pointer to the hash table based on the cluster number of the storage device
+ *  \param nHMask number of entries of the hash table minus one
  *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
  *                    access time, is stored
  *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
  *                    access time, is stored
  */
 
-extern void insertNode (SOBufferCacheNode *node, SOBufferCacheNode **p_nLHead, SOBufferCacheNode **p_lATLHead,
-                        SOBufferCacheNode **p_lATLTail);
+extern void insertNode (SOBufferCacheNode *node, SOBufferCacheNode **nHTable, uint32_t nHMask,
+                        SOBufferCacheNode **p_lATLHead, SOBufferCacheNode **p_lATLTail);
 
 /**
- *  \brief Retrieve a node from the two double-linked lists infrastructure.
+ *  \brief Retrieve a node from the hash table and from the double-linked list based on the last access time.
  *
- *  The node which the tail of the double-linked list based on last access time points to, is retrieved from the two
- *  double-linked lists infrastructure. If the storage area is inconsistent, nothing is done.
+ *  The node which the tail of the double-linked list based on last access time points to, is retrieved from the list
+ *  of its hash table entry and from the double-linked list based on the last access time.
  *
- *  \param p_nLHead pointer to a location where the pointer to the head of the double linked list based on the physical
- *                  block number of the storage device, is stored
+ *  \param nHTable pointer to the hash table based on the cluster number of the storage device
+ *  \param nHMask number of entries of the hash table minus one
  *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
  *                    access time, is stored
  *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
  *                    access time, is stored
  *
- *  \return pointer to the retrieved node, or \c NULL if the storage area is empty or inconsistent
+ *  \return pointer to the retrieved node, or \c NULL if the storage area is empty
  */
 
-extern SOBufferCacheNode *retrieveNode (SOBufferCacheNode **p_nLHead, SOBufferCacheNode **p_lATLHead,
+extern SOBufferCacheNode *retrieveNode (SOBufferCacheNode **nHTable, uint32_t nHMask, SOBufferCacheNode **p_lATLHead,
                                         SOBufferCacheNode **p_lATLTail);
 
 /**
  *  \brief Move the node to the head of the double-linked list based on last access time.
  *
  *  The node which is supposed to have been accessed, is retrieved from its location in the double-linked list based on
- *  the last access time and placed at the head of the list. If the node pointer is \c NULL or the storage area is
- *  inconsistent, nothing is done.
+ *  the last access time and placed at the head of the list. If the node pointer is \c NULL, nothing is done.
  *
  *  \param node pointer to the node to be inserted
  *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
@@ -121,4 +131,51 @@ extern SOBufferCacheNode *retrieveNode (SOBufferCacheNode **p_nLHead, SOBufferCa
 
 extern void moveNodeAtHeadLAT (SOBufferCacheNode *node, SOBufferCacheNode **p_lATLHead, SOBufferCacheNode **p_lATLTail);
 
+/**
+ *  \brief Check if a given cluster, whose number is given, is remembered by a ghost entry.
+ *
+ *  The single-linked list of the hash table entry which the cluster falls on, is traversed to find out if there is a
+ *  ghost entry of the cluster whose number is passed as the first argument.
+ *
+ *  \param nClust cluster number
+ *  \param ghost pointer to the array of ghost entries
+ *  \param gHTable pointer to the hash table of the ghost entries based on the cluster number
+ *  \param gHMask number of entries of the hash table minus one
+ *
+ *  \return index of the ghost entry, or <tt>-1</tt> if the cluster is not remembered
+ */
+
+extern int32_t searchGhostOnN (uint32_t nClust, SOBufferCacheGhost *ghost, int32_t *gHTable, uint32_t gHMask);
+
+/**
+ *  \brief Insert a ghost entry of a given cluster.
+ *
+ *  The ghost entry which the circular index points to is reused for the cluster whose number is passed as the first
+ *  argument (it is first removed from the list of its hash table entry, if it is in use), inserted at the head of the
+ *  list of its new hash table entry, and the circular index is advanced.
+ *
+ *  \param nClust cluster number
+ *  \param ghost pointer to the array of ghost entries
+ *  \param gSize number of ghost entries
+ *  \param p_gNext pointer to a location where the circular index of the next ghost entry to be used is stored
+ *  \param gHTable pointer to the hash table of the ghost entries based on the cluster number
+ *  \param gHMask number of entries of the hash table minus one
+ */
+
+extern void insertGhost (uint32_t nClust, SOBufferCacheGhost *ghost, uint32_t gSize, uint32_t *p_gNext,
+                         int32_t *gHTable, uint32_t gHMask);
+
+/**
+ *  \brief Remove a ghost entry.
+ *
+ *  The ghost entry is retrieved from the list of its hash table entry and marked as not in use.
+ *
+ *  \param g index of the ghost entry
+ *  \param ghost pointer to the array of ghost entries
+ *  \param gHTable pointer to the hash table of the ghost entries based on the cluster number
+ *  \param gHMask number of entries of the hash table minus one
+ */
+
+extern void removeGhost (int32_t g, SOBufferCacheGhost *ghost, int32_t *gHTable, uint32_t gHMask);
+
 #endif /* SOFS_BUFFERCACHEINTERNALS_H_ */
@@ -1,7 +1,7 @@
 /**
  *  \file sofs_buffercachenode.h (interface file)
  *
- *  \brief Definition of the buffercache node data type.
+ *  \brief Definition of the buffercache node, ghost entry and shard data types.
  *
  *  \author António Rui Borges - July 2010
  */
@@ -10,39 +10,66 @@
 #define SOFS_BUFFERCACHENODE_H_
 
 #include <stdint.h>
+#include <pthread.h>
 
 #include "sofs_const.h"
 
 /**
  *  \brief Definition of the buffercache node data type.
  *
- *  The buffercache is conceived as two double-linked lists: the first, based on the block number of the storage device
- *  it is referencing; the second, based on the order of last access to the block.
+ *  The buffercache is conceived as a hash table of double-linked lists, indexed by the number of the cluster of the
+ *  storage device it is referencing, a double-linked list based on the order of last access to the cluster and a
+ *  double-linked list, of the nodes whose contents was changed, based on the time the change took place.
  *  So, besides the pointers which are required to implement this dynamic structure, each node contains:
- *    \li a buffer area to store locally the contents of the referenced block
- *    \li the physical block number
- *    \li a status flag which signals whether the block contents is, or is not, synchronized with the contents of the
- *        corresponding block in the storage device.
+ *    \li a pointer to the buffer area where the contents of the referenced cluster is stored locally
+ *    \li the cluster number (the clusters are shifted so that the last one ends at the end of the storage device)
+ *    \li the set of blocks of the cluster whose contents is stored
+ *    \li the set of blocks of the cluster whose contents is not synchronized with the contents of the corresponding
+ *        block in the storage device
+ *    \li the time the cluster contents was first changed, if it is not synchronized
+ *    \li the list based on the last access time the node is on
+ *    \li the read-ahead status of the cluster
+ *    \li the number of times it is pinned.
+ *
+ *  The buffer areas are kept apart from the nodes, in an arena of their own, so that the nodes are small and packed
+ *  together: the fields looked at on a lookup come first, so that a hash table chain is followed touching a single
+ *  cache line per node.
  */
 
 typedef struct soBufferCacheNode
 {
-   /** \brief contents of the data block */
-    unsigned char buffer[BLOCK_SIZE];
-   /** \brief physical block number */
+   /** \brief cluster number (its first block is <tt>n * BLOCKS_PER_CLUSTER</tt> minus the shift) */
     uint32_t n;
-   /** \brief status of the data block
-    *  \li <em>same</em> - the contents is the same as the corresponding block in the storage device
-    *  \li <em>changed</em> - the contents is potentially different
+   /** \brief read-ahead status of the data cluster: <tt>0 (zero)</tt>, or a combination of
+    *  \li <em>pending</em> - the contents is being read ahead from the storage device
+    *  \li <em>trigger</em> - the cluster is the first of a read-ahead window
+    */
+    uint32_t ahead;
+   /** \brief double-linked list of the hash table entry based on block number:
+    *         pointer to next node */
+    struct soBufferCacheNode *n_next;
+   /** \brief pointer to the contents of the data cluster (in the arena of the storage area) */
+    unsigned char *buffer;
+   /** \brief set of blocks whose contents is stored (bit \e i stands for block \e i of the cluster) */
+    uint32_t valid;
+   /** \brief status of the data cluster: set of blocks whose contents is potentially different from the corresponding
+    *         block in the storage device (<em>same</em>, if there are none)
     */
     uint32_t stat;
+   /** \brief time in milliseconds the contents was first changed (only meaningful if the status is not
+    *         <em>same</em>) */
+    uint64_t dirtyTime;
+   /** \brief list the node is on
+    *  \li <em>Am</em> - the list based on the last access time
+    *  \li <em>A1in</em> - the FIFO list of the nodes accessed once (2Q policy)
+    */
+    uint32_t queue;
+   /** \brief number of pins of the node: a pinned node is not selected for replacement */
+    uint32_t pins;
 
-   /** \brief double-linked list based on block number:
+   /** \brief double-linked list of the hash table entry based on block number:
     *         pointer to previous node */
     struct soBufferCacheNode *n_prev;
-   /** \brief double-linked list based on block number:
-    *         pointer to next node */
-    struct soBufferCacheNode *n_next;
 
    /** \brief double-linked list based on last access time:
     *         pointer to previous node */
@@ -50,12 +77,137 @@ typedef struct soBufferCacheNode
    /** \brief double-linked list based on last access time:
     *         pointer to next node */
     struct soBufferCacheNode *access_next;
+
+   /** \brief double-linked list based on the time the contents was changed:
+    *         pointer to previous node (changed later) */
+    struct soBufferCacheNode *d_prev;
+   /** \brief double-linked list based on the time the contents was changed:
+    *         pointer to next node (changed earlier) */
+    struct soBufferCacheNode *d_next;
 } SOBufferCacheNode;
 
-/** \brief the contents of a block in the storage area is the same as the corresponding block in the storage device */
+/** \brief the contents of a cluster in the storage area is the same as the corresponding cluster in the storage
+ *         device */
 #define SAME    0
-/** \brief the contents of a block in the storage area is potentially different from the corresponding block in the
- *         storage device */
-#define CHANGED 1
+
+/** \brief the node is on the list based on the last access time */
+#define AM      0
+/** \brief the node is on the FIFO list of the nodes accessed once (2Q policy) */
+#define A1IN    1
+
+/** \brief the contents of the cluster is being read ahead and can not be accessed until the transfer is complete */
+#define RA_PENDING  0x1
+/** \brief the cluster is the first of a read-ahead window: an access to it gives rise to the read ahead of the next
+ *         one */
+#define RA_TRIGGER  0x2
+
+/**
+ *  \brief Definition of the ghost entry data type.
+ *
+ *  With the 2Q replacement policy, the clusters recently replaced from the FIFO list of the nodes accessed once are
+ *  remembered by ghost entries, without their contents. The ghost entries are kept on a circular array, the oldest one
+ *  being reused for a new cluster, and are indexed by a hash table of single-linked lists based on the cluster number.
+ */
+
+typedef struct soBufferCacheGhost
+{
+   /** \brief cluster number (<em>null ghost</em>, if the entry is not in use) */
+    uint32_t n;
+   /** \brief single-linked list of the hash table entry based on cluster number:
+    *         index of next entry (-1, if there is none) */
+    int32_t n_next;
+} SOBufferCacheGhost;
+
+/** \brief the ghost entry is not in use */
+#define NULL_GHOST 0xFFFFFFFF
+
+/**
+ *  \brief Definition of the buffercache shard data type.
+ *
+ *  The storage area is split in shards, a cluster being stored in the shard given by its number modulo the number of
+ *  shards. Each shard is a buffercache on its own: it has a slice of the nodes of the storage area, its own hash table,
+ *  its own lists for replacement and for write back, its own statistics and its own locking flag, so the accesses to
+ *  clusters of different shards are carried out in parallel.
+ */
+
+typedef struct soBufferCacheShard
+{
+   /** \brief locking flag which warrants mutual exclusion on the access to the shard */
+    pthread_mutex_t accessCR;
+   /** \brief writers are waiting for the number of changed nodes of the shard to go down */
+    pthread_cond_t flushDone;
+
+   /** \brief pointer to the first node of the slice of the storage area */
+    SOBufferCacheNode *buffer;
+   /** \brief number of nodes of the slice */
+    uint32_t nNodes;
+   /** \brief number of nodes of the slice which were never used */
+    uint32_t nFreeBlocks;
+   /** \brief list of nodes which were released (linked through the access list pointers) */
+    SOBufferCacheNode *freeList;
+   /** \brief hash table based on the number of the node cluster */
+    SOBufferCacheNode **nHTable;
+   /** \brief number of entries of the hash table minus one */
+    uint32_t nHMask;
+   /** \brief head of the double-linked list based on the last access time */
+    SOBufferCacheNode *lATLHead;
+   /** \brief tail of the double-linked list based on the last access time */
+    SOBufferCacheNode *lATLTail;
+
+   /** \brief head of the FIFO list of the nodes accessed once (2Q policy) */
+    SOBufferCacheNode *a1inHead;
+   /** \brief tail of the FIFO list of the nodes accessed once (2Q policy) */
+    SOBufferCacheNode *a1inTail;
+   /** \brief number of nodes on the FIFO list of the nodes accessed once */
+    uint32_t nA1in;
+   /** \brief number of nodes of the FIFO list of the nodes accessed once above which they are replaced first */
+    uint32_t kIn;
+   /** \brief ghost entries of the clusters recently replaced from the FIFO list (2Q policy) */
+    SOBufferCacheGhost *ghost;
+   /** \brief number of ghost entries */
+    uint32_t kOut;
+   /** \brief index of the ghost entry to be used next */
+    uint32_t gNext;
+   /** \brief hash table of the ghost entries based on the cluster number */
+    int32_t *gHTable;
+   /** \brief number of entries of the hash table of the ghost entries minus one */
+    uint32_t gHMask;
+
+   /** \brief head of the double-linked list based on the time the contents was changed (most recent) */
+    SOBufferCacheNode *dLHead;
+   /** \brief tail of the double-linked list based on the time the contents was changed (oldest) */
+    SOBufferCacheNode *dLTail;
+   /** \brief number of nodes whose contents was changed */
+    uint32_t nDirty;
+   /** \brief number of changed nodes above which they are written back */
+    uint32_t nDirtyBg;
+   /** \brief number of changed nodes from which writers are held back */
+    uint32_t nDirtyMax;
+   /** \brief error on writing back a block by the flusher thread, to be reported by the next synchronization */
+    int flushErr;
+   /** \brief number of transfers to the storage device (a cluster read ahead while it changes is discarded) */
+    uint32_t nWrites;
+
+   /** \brief number of accesses whose cluster was stored in the shard with all the blocks required */
+    uint64_t nHits;
+   /** \brief number of accesses whose cluster, or some of the blocks required, had to be set up */
+    uint64_t nMisses;
+   /** \brief number of nodes replaced */
+    uint64_t nEvictions;
+   /** \brief number of nodes whose changed blocks were written back */
+    uint64_t nWritebacks;
+   /** \brief number of groups of successive blocks written back, each by a single transfer, which start in the shard */
+    uint64_t nWbTransfers;
+   /** \brief number of bytes written back */
+    uint64_t bytesWb;
+   /** \brief number of flush and synchronization accesses */
+    uint64_t nFlushes;
+   /** \brief number of clusters read ahead */
+    uint64_t nReadAhead;
+   /** \brief number of bytes read from the shard */
+    uint64_t bytesRead;
+   /** \brief number of bytes written to the shard, or flushed through it */
+    uint64_t bytesWritten;
+} SOBufferCacheShard;
 
 #endif /* SOFS_BUFFERCACHENODE_H_ */
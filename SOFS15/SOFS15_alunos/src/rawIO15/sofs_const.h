@@ -3,6 +3,15 @@
  *
  *  \brief Definition of basic constants.
  *
+ *  The file system supports only the default geometry of the storage device: blocks of 512 bytes and clusters of 4
+ *  blocks. The prebuilt binary libraries (<tt>libsofs15bin</tt> and <tt>libsyscalls15bin</tt>), which every program
+ *  that operates on the file system is linked with, are compiled for it, so the file system layers refuse to be built
+ *  with any other. The superblock keeps the block size and the number of blocks in a cluster only so that a storage
+ *  device formatted otherwise is not accepted.
+ *
+ *  \remarks Only the raw disk and buffercache layers, and the tools built on them alone (simcache and benchcache), may
+ *           be built with another geometry, by defining both constants through <tt>GEOMETRY</tt> on the command line.
+ *
  *  \author Artur Carneiro Pereira - September 2008
  *  \author Miguel Oliveira e Silva - September 2009
  *  \author António Rui Borges - July 2010 / August 2011
@@ -11,16 +20,34 @@
 #ifndef SOFS_CONST_H_
 #define SOFS_CONST_H_
 
-/** \brief block size (in bytes) */
-#define BLOCK_SIZE (512)
+/** \brief default block size (in bytes) */
+#define DEF_BLOCK_SIZE (512)
+
+/** \brief default number of contiguous blocks in a cluster */
+#define DEF_BLOCKS_PER_CLUSTER (4)
+
+/** \brief block size (in bytes): a power of two between 512 and 65536 */
+#ifndef BLOCK_SIZE
+#define BLOCK_SIZE (DEF_BLOCK_SIZE)
+#endif
 
 /** \brief block size (in bits) */
 #define BITS_PER_BLOCK (8 * BLOCK_SIZE)
 
-/** \brief number of contiguous blocks in a cluster */
-#define BLOCKS_PER_CLUSTER (4)
+/** \brief number of contiguous blocks in a cluster: a power of two between 1 and 16 */
+#ifndef BLOCKS_PER_CLUSTER
+#define BLOCKS_PER_CLUSTER (DEF_BLOCKS_PER_CLUSTER)
+#endif
 
 /** \brief cluster size (in bytes) */
 #define CLUSTER_SIZE (BLOCKS_PER_CLUSTER * BLOCK_SIZE)
 
+#if (BLOCK_SIZE < 512) || (BLOCK_SIZE > 65536) || ((BLOCK_SIZE & (BLOCK_SIZE - 1)) != 0)
+#error "BLOCK_SIZE must be a power of two between 512 and 65536"
+#endif
+
+#if (BLOCKS_PER_CLUSTER < 1) || (BLOCKS_PER_CLUSTER > 16) || ((BLOCKS_PER_CLUSTER & (BLOCKS_PER_CLUSTER - 1)) != 0)
+#error "BLOCKS_PER_CLUSTER must be a power of two between 1 and 16"
+#endif
+
 #endif /* SOFS_CONST_H_ */
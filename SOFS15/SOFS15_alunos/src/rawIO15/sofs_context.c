@@ -0,0 +1,161 @@
+/**
+ *  \file sofs_context.c (implementation file)
+ *
+ *  \brief SOFS contexts: independent instances of the internal state of the file system engine.
+ *
+ *  Each layer of the engine (raw disk and its backends, buffercache, basic operations, allocation of the data clusters
+ *  of files and path traversal) keeps its internal state in a context, instead of in file-static variables. A context
+ *  is bound to each thread and every operation carried out by the thread acts on the state of that context; a thread
+ *  that does not select one works on the default context, which is the only one there is for a single-image
+ *  application.
+ *
+ *  The following operations are defined:
+ *    \li create a context
+ *    \li destroy a context
+ *    \li bind a context to the calling thread
+ *    \li get the context bound to the calling thread
+ *    \li register the state of a layer of the engine.
+ */
+
+#include <stdlib.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include "sofs_probe.h"
+#include "sofs_context.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief Default context */
+static SOContext defContext;
+
+/** \brief Context bound to the calling thread */
+__thread SOContext *soCurContext = &defContext;
+
+/** \brief Size in bytes of the state of each layer of the engine (zero, if the layer is not linked in) */
+static size_t stateSize[CTX_LAYERS];
+
+/** \brief Function which sets up the state of each layer of the engine */
+static void (*stateInit[CTX_LAYERS]) (void *);
+
+/**
+ *  \brief Create a context.
+ *
+ *  The state of every layer is set up as the one of the default context was at start up.
+ *
+ *  \param p_ctx pointer to the location where the pointer to the new context is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL
+ *  \return -\c ENOMEM, if there is not enough memory
+ */
+
+int soNewContext (SOContext **p_ctx)
+{
+  soColorProbe (881, "07;31", "soNewContext (%p)\n", p_ctx);
+
+  SOContext *ctx;                                /* pointer to the new context */
+  uint32_t k;                                    /* layer counter */
+
+  if (p_ctx == NULL) return -EINVAL;
+
+  if ((ctx = calloc (1, sizeof (SOContext))) == NULL)
+     return -ENOMEM;
+  for (k = 0; k < CTX_LAYERS; k++)
+    if (stateSize[k] != 0)
+       { if ((ctx->state[k] = calloc (1, stateSize[k])) == NULL)
+            { soFreeContext (ctx);
+              return -ENOMEM;
+            }
+         stateInit[k] (ctx->state[k]);
+       }
+  *p_ctx = ctx;
+
+  return 0;
+}
+
+/**
+ *  \brief Destroy a context.
+ *
+ *  The storage device opened in it, if any, must have been closed first.
+ *
+ *  \param ctx pointer to the context
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL or it is the default context
+ *  \return -\c EBUSY, if it is bound to the calling thread
+ */
+
+int soFreeContext (SOContext *ctx)
+{
+  soColorProbe (882, "07;31", "soFreeContext (%p)\n", ctx);
+
+  uint32_t k;                                    /* layer counter */
+
+  if ((ctx == NULL) || (ctx == &defContext)) return -EINVAL;
+  if (ctx == soCurContext) return -EBUSY;
+
+  for (k = 0; k < CTX_LAYERS; k++)
+    free (ctx->state[k]);
+  free (ctx);
+
+  return 0;
+}
+
+/**
+ *  \brief Bind a context to the calling thread.
+ *
+ *  \param ctx pointer to the context (\c NULL, for the default context)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ */
+
+int soSetContext (SOContext *ctx)
+{
+  soColorProbe (883, "07;31", "soSetContext (%p)\n", ctx);
+
+  soCurContext = (ctx != NULL) ? ctx : &defContext;
+
+  return 0;
+}
+
+/**
+ *  \brief Get the context bound to the calling thread.
+ *
+ *  \return pointer to the context
+ */
+
+SOContext *soGetContext (void)
+{
+  soColorProbe (884, "07;31", "soGetContext ()\n");
+
+  return soCurContext;
+}
+
+/**
+ *  \brief Register the state of a layer of the engine.
+ *
+ *  It is meant to be called by a constructor of the layer, before <tt>main</tt> is called and any context is created.
+ *
+ *  \param layer layer of the engine
+ *  \param size size in bytes of its state
+ *  \param init function which sets up its state
+ *  \param defState pointer to its state in the default context (it is set up here)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the layer is out of range or any of the pointers is \c NULL
+ */
+
+int soRegisterContextState (uint32_t layer, size_t size, void (*init) (void *), void *defState)
+{
+  if ((layer >= CTX_LAYERS) || (init == NULL) || (defState == NULL)) return -EINVAL;
+
+  stateSize[layer] = size;
+  stateInit[layer] = init;
+  init (defState);
+  defContext.state[layer] = defState;
+
+  return 0;
+}
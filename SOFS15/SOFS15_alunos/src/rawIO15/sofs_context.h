@@ -0,0 +1,128 @@
+/**
+ *  \file sofs_context.h (interface file)
+ *
+ *  \brief SOFS contexts: independent instances of the internal state of the file system engine.
+ *
+ *  Each layer of the engine (raw disk and its backends, buffercache, basic operations, allocation of the data clusters
+ *  of files and path traversal) keeps its internal state in a context, instead of in file-static variables. A context
+ *  is bound to each thread and every operation carried out by the thread acts on the state of that context; a thread
+ *  that does not select one works on the default context, which is the only one there is for a single-image
+ *  application. Thus, several storage devices may be opened in one process, each one in its own context, and threads
+ *  working on different contexts do not interfere.
+ *
+ *  The state of a layer is set up by the layer itself: it registers its size and its initialization function before
+ *  <tt>main</tt> is called, and the state of the default context is provided by the layer as a static variable.
+ *
+ *  The following operations are defined:
+ *    \li create a context
+ *    \li destroy a context
+ *    \li bind a context to the calling thread
+ *    \li get the context bound to the calling thread
+ *    \li register the state of a layer of the engine.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_CONTEXT_H_
+#define SOFS_CONTEXT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Layers of the engine which keep their state in a context */
+
+/** \brief raw disk */
+#define CTX_RAWDISK      0
+/** \brief io_uring backend of the raw disk */
+#define CTX_RAWURING     1
+/** \brief direct I/O backend of the raw disk */
+#define CTX_RAWDIRECT    2
+/** \brief buffercache */
+#define CTX_BUFFERCACHE  3
+/** \brief basic operations */
+#define CTX_BASICOPER    4
+/** \brief path traversal */
+#define CTX_DIRPATH      5
+/** \brief allocation of the data clusters of files */
+#define CTX_FILECLUST    6
+/** \brief number of layers */
+#define CTX_LAYERS       7
+
+/** \brief SOFS context */
+
+typedef struct soContext
+{ /** \brief internal state of each layer of the engine (\c NULL, if the layer is not linked in) */
+    void *state[CTX_LAYERS];
+} SOContext;
+
+/** \brief context bound to the calling thread */
+extern __thread SOContext *soCurContext;
+
+/** \brief internal state of a layer of the engine in the context bound to the calling thread */
+#define CTX_STATE(layer)  (soCurContext->state[(layer)])
+
+/**
+ *  \brief Create a context.
+ *
+ *  The state of every layer is set up as the one of the default context was at start up.
+ *
+ *  \param p_ctx pointer to the location where the pointer to the new context is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL
+ *  \return -\c ENOMEM, if there is not enough memory
+ */
+
+extern int soNewContext (SOContext **p_ctx);
+
+/**
+ *  \brief Destroy a context.
+ *
+ *  The storage device opened in it, if any, must have been closed first.
+ *
+ *  \param ctx pointer to the context
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL or it is the default context
+ *  \return -\c EBUSY, if it is bound to the calling thread
+ */
+
+extern int soFreeContext (SOContext *ctx);
+
+/**
+ *  \brief Bind a context to the calling thread.
+ *
+ *  \param ctx pointer to the context (\c NULL, for the default context)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ */
+
+extern int soSetContext (SOContext *ctx);
+
+/**
+ *  \brief Get the context bound to the calling thread.
+ *
+ *  \return pointer to the context
+ */
+
+extern SOContext *soGetContext (void);
+
+/**
+ *  \brief Register the state of a layer of the engine.
+ *
+ *  It is meant to be called by a constructor of the layer, before <tt>main</tt> is called and any context is created.
+ *
+ *  \param layer layer of the engine
+ *  \param size size in bytes of its state
+ *  \param init function which sets up its state
+ *  \param defState pointer to its state in the default context (it is set up here)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the layer is out of range or any of the pointers is \c NULL
+ */
+
+extern int soRegisterContextState (uint32_t layer, size_t size, void (*init) (void *), void *defState);
+
+#endif /* SOFS_CONTEXT_H_ */
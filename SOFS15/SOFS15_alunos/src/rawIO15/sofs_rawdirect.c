@@ -0,0 +1,439 @@
+/**
+ *  \file sofs_rawdirect.c (implementation file)
+ *
+ *  \brief Access to the storage device bypassing the host page cache (O_DIRECT).
+ *
+ *  Direct I/O requires the buffer address, the file position and the transfer size to be multiples of the logical
+ *  block size of the host. Transfers which do not meet these requirements go through a pool of suitably aligned
+ *  buffers, the positions being rounded to the logical block size of the host (partial blocks are written by a read,
+ *  modify and write sequence). The pool has a fixed number of buffers and is shared by all threads; a thread which
+ *  finds it empty waits for a buffer to be released.
+ *
+ *  Writes hold a lock on every logical block of the host they touch, taken from a small table of locks indexed by the
+ *  block number, so that two threads updating different parts of the same logical block of the host do not undo each
+ *  other's changes.
+ *
+ *  The logical block size is taken from \e statx (direct I/O alignment), when the host supports it; otherwise, from
+ *  the sector size of a block device or the preferred I/O size of a regular file, which are safe upper bounds.
+ *
+ *  The following operations are defined:
+ *    \li open the storage device for direct I/O
+ *    \li close the storage device previously opened for direct I/O
+ *    \li get the alignment required for direct I/O
+ *    \li transfer a contiguous byte range between a buffer and the storage device
+ *    \li transfer a contiguous byte range between a list of buffers and the storage device.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/fs.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_rawdirect.h"
+#include "sofs_context.h"
+
+/** \brief Number of aligned buffers of the pool */
+#define DIRECT_POOL_SIZE  8
+/** \brief Size in bytes of each aligned buffer (also the largest alignment which is supported) */
+#define DIRECT_BUF_SIZE   (64 * 1024)
+/** \brief Number of locks on the logical blocks of the host (a power of two) */
+#define DIRECT_STRIPES    64
+
+/*
+ *  Internal data structure
+ */
+/** \brief State of the direct I/O backend (one per SOFS context) */
+
+typedef struct
+{ /** \brief File descriptor of the Linux file that simulates the magnetic disk, opened for direct I/O */
+    int dfd;
+  /** \brief File descriptor of the Linux file that simulates the magnetic disk, opened in the usual way */
+    int bfd;
+  /** \brief Size in bytes of the storage device */
+    uint64_t devsize;
+  /** \brief Start of the final part of the device which is not a whole number of logical blocks of the host */
+    uint64_t tailstart;
+  /** \brief Alignment required for direct I/O */
+    uint32_t align;
+  /** \brief Pool of aligned buffers */
+    unsigned char *pool[DIRECT_POOL_SIZE];
+  /** \brief Stack of free buffers of the pool */
+    unsigned char *freebuf[DIRECT_POOL_SIZE];
+  /** \brief Number of free buffers of the pool */
+    uint32_t nfreebuf;
+  /** \brief Locking flag which warrants mutual exclusion on the access to the pool */
+    pthread_mutex_t poolAccess;
+  /** \brief Synchronization point where threads wait for a free buffer */
+    pthread_cond_t poolFree;
+  /** \brief Locks on the logical blocks of the host which are being written (block number modulo DIRECT_STRIPES) */
+    pthread_mutex_t stripe[DIRECT_STRIPES];
+} SORawDirectState;
+
+/** \brief State of the direct I/O backend in the default context */
+static SORawDirectState defState;
+
+/** \brief State of the direct I/O backend in the context bound to the calling thread */
+#define RX  ((SORawDirectState *) CTX_STATE (CTX_RAWDIRECT))
+
+/* Allusion to internal functions */
+
+static uint32_t soDirectGetAlignment (int fd);
+static int soDirectIO (int fd, int wr, unsigned char *p, size_t len, uint64_t off);
+static unsigned char *soDirectGetBuffer (void);
+static void soDirectPutBuffer (unsigned char *b);
+static void soDirectLockRange (int lock, uint64_t start, uint64_t end);
+static void soInitState (void *state);
+
+/**
+ *  \brief Open the storage device for direct I/O.
+ *
+ *  A second communication channel, bypassing the host page cache, is established with the storage device and the pool
+ *  of aligned buffers is set up. The channel already opened in the usual way is kept for the final part of the device,
+ *  when its size is not a multiple of the logical block size of the host.
+ *
+ *  \param devname absolute path to the Linux file that simulates the storage device
+ *  \param fd file descriptor of the channel already opened in the usual way
+ *  \param size size in bytes of the storage device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the device is already opened for direct I/O
+ *  \return -\c ENOMEM, if the pool of aligned buffers can not be set up
+ *  \return -<em>other specific error</em> issued by \e open system call (-\c EINVAL, if direct I/O is not supported
+ *          by the host file system)
+ */
+
+int soDirectOpen (const char *devname, int fd, uint64_t size)
+{
+  uint32_t i;                                    /* counter */
+
+  if (RX->dfd != -1) return -EBUSY;              /* checking for device already opened for direct I/O */
+
+  if ((RX->dfd = open (devname, O_RDWR | O_DIRECT)) == -1)
+     return -errno;                              /* checking for opening error */
+
+  RX->align = soDirectGetAlignment (RX->dfd);
+  for (i = 0; i < DIRECT_POOL_SIZE; i++)
+    if (posix_memalign ((void **) &RX->pool[i], RX->align, DIRECT_BUF_SIZE) != 0)
+       { while (i > 0)
+           free (RX->pool[--i]);
+         close (RX->dfd);
+         RX->dfd = -1;
+         return -ENOMEM;
+       }
+       else RX->freebuf[i] = RX->pool[i];
+  RX->nfreebuf = DIRECT_POOL_SIZE;
+
+  RX->bfd = fd;
+  RX->devsize = size;
+  RX->tailstart = size / RX->align * RX->align;
+
+  return 0;
+}
+
+/**
+ *  \brief Close the storage device previously opened for direct I/O.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not opened for direct I/O
+ */
+
+int soDirectClose (void)
+{
+  uint32_t i;                                    /* counter */
+
+  if (RX->dfd == -1) return -EBADF;              /* checking for device not opened for direct I/O */
+
+  for (i = 0; i < DIRECT_POOL_SIZE; i++)
+    free (RX->pool[i]);
+  RX->nfreebuf = 0;
+  close (RX->dfd);
+  RX->dfd = RX->bfd = -1;
+  RX->devsize = RX->tailstart = 0;
+  RX->align = 1;
+
+  return 0;
+}
+
+/**
+ *  \brief Get the alignment required for direct I/O.
+ *
+ *  Buffers whose address is a multiple of this value, and transfers whose position and size are multiples of it, are
+ *  moved straight from / to the storage device, with no intermediate copy.
+ *
+ *  \return the alignment in bytes, if the device is opened for direct I/O
+ *  \return <tt>1</tt>, otherwise
+ */
+
+uint32_t soDirectAlignment (void)
+{
+  return RX->align;
+}
+
+/**
+ *  \brief Transfer a contiguous byte range between a buffer and the storage device.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param buf pointer to the buffer
+ *  \param len number of bytes to be transferred
+ *  \param off byte position on the device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ */
+
+int soDirectTransfer (int wr, void *buf, size_t len, uint64_t off)
+{
+  unsigned char *p = buf;                        /* current position in the buffer */
+  unsigned char *b;                              /* aligned buffer */
+  uint64_t start, end;                           /* limits of the aligned range enclosing the current piece */
+  size_t piece;                                  /* size of the current piece */
+  int stat = 0;                                  /* function return status */
+
+  /* the buffer and the range are suitably aligned: straight transfer */
+
+  if ((((uintptr_t) p % RX->align) == 0) && ((off % RX->align) == 0) && ((len % RX->align) == 0) &&
+      (off + len <= RX->tailstart))
+     { if (!wr) return soDirectIO (RX->dfd, 0, p, len, off);
+       soDirectLockRange (1, off, off + len);
+       stat = soDirectIO (RX->dfd, 1, p, len, off);
+       soDirectLockRange (0, off, off + len);
+       return stat;
+     }
+
+  b = soDirectGetBuffer ();
+  while ((len > 0) && (stat == 0))
+  { if (off >= RX->tailstart)                    /* final part of the device: it can not be accessed directly */
+       { stat = soDirectIO (RX->bfd, wr, p, len, off);
+         break;
+       }
+
+    /* move the piece which fits in the aligned buffer and does not cross into the final part of the device */
+
+    start = off / RX->align * RX->align;
+    end = (off + len + RX->align - 1) / RX->align * RX->align;
+    if (end > start + DIRECT_BUF_SIZE) end = start + DIRECT_BUF_SIZE;
+    if (end > RX->tailstart) end = RX->tailstart;
+    piece = ((off + len) < end) ? len : (size_t) (end - off);
+
+    if (wr) soDirectLockRange (1, start, end);   /* no other write may touch the range until it is written back */
+    if (!wr || (start != off) || (end != off + piece))
+       stat = soDirectIO (RX->dfd, 0, b, end - start, start);  /* whole range is not overwritten: read it first */
+    if (wr)
+       { if (stat == 0)
+            { memcpy (b + (off - start), p, piece);
+              stat = soDirectIO (RX->dfd, 1, b, end - start, start);
+            }
+         soDirectLockRange (0, start, end);
+       }
+       else if (stat == 0) memcpy (p, b + (off - start), piece);
+    if (stat != 0) break;
+    p += piece;
+    off += piece;
+    len -= piece;
+  }
+  soDirectPutBuffer (b);
+
+  return stat;
+}
+
+/**
+ *  \brief Transfer a contiguous byte range between a list of buffers and the storage device.
+ *
+ *  The transfer is performed by a single vectored system call, provided every buffer meets the alignment requirements
+ *  of direct I/O; otherwise, nothing is transferred and the caller must fall back to soDirectTransfer.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param iov pointer to the array of buffers
+ *  \param cnt number of buffers
+ *  \param off byte position on the device
+ *
+ *  \return the number of bytes transferred (<tt>0 (zero)</tt>, if the buffers are not suitably aligned)
+ *  \return <tt>-1</tt>, if it fails on reading or writing (\e errno is set accordingly)
+ */
+
+ssize_t soDirectTransferv (int wr, const struct iovec *iov, int cnt, uint64_t off)
+{
+  uint64_t len = 0;                              /* number of bytes to be transferred */
+  int i;                                         /* counter */
+
+  if ((off % RX->align) != 0) return 0;
+  for (i = 0; i < cnt; i++)
+  { if ((((uintptr_t) iov[i].iov_base % RX->align) != 0) || ((iov[i].iov_len % RX->align) != 0))
+       return 0;
+    len += iov[i].iov_len;
+  }
+  if (off + len > RX->tailstart) return 0;
+  if (!wr) return preadv (RX->dfd, iov, cnt, off);
+
+  ssize_t done;                                  /* number of bytes written */
+
+  soDirectLockRange (1, off, off + len);
+  done = pwritev (RX->dfd, iov, cnt, off);
+  soDirectLockRange (0, off, off + len);
+
+  return done;
+}
+
+/**
+ *  \brief Get the alignment required for direct I/O on an opened file.
+ *
+ *  \param fd file descriptor
+ *
+ *  \return the alignment in bytes (a power of two between 512 and DIRECT_BUF_SIZE)
+ */
+
+static uint32_t soDirectGetAlignment (int fd)
+{
+  uint32_t a = 0;                                /* alignment */
+  struct stat st;                                /* file attributes */
+
+#ifdef STATX_DIOALIGN
+  struct statx stx;                              /* extended file attributes */
+
+  if ((statx (fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0) && (stx.stx_mask & STATX_DIOALIGN) &&
+      (stx.stx_dio_offset_align != 0))
+     a = (stx.stx_dio_mem_align > stx.stx_dio_offset_align) ? stx.stx_dio_mem_align : stx.stx_dio_offset_align;
+#endif
+  if ((a == 0) && (fstat (fd, &st) == 0))
+     { int ssz;                                  /* logical sector size of a block device */
+
+       if (S_ISBLK (st.st_mode) && (ioctl (fd, BLKSSZGET, &ssz) == 0))
+          a = (uint32_t) ssz;
+          else a = (uint32_t) st.st_blksize;
+     }
+
+  if ((a < 512) || (a > DIRECT_BUF_SIZE) || ((a & (a - 1)) != 0))
+     a = (a > DIRECT_BUF_SIZE) ? DIRECT_BUF_SIZE : 4096;
+
+  return a;
+}
+
+/**
+ *  \brief Transfer a contiguous byte range resuming partial transfers and interrupted system calls.
+ *
+ *  \param fd file descriptor
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param p pointer to the buffer
+ *  \param len number of bytes to be transferred
+ *  \param off byte position on the device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ */
+
+static int soDirectIO (int fd, int wr, unsigned char *p, size_t len, uint64_t off)
+{
+  ssize_t done;                                  /* number of bytes moved by the last system call */
+
+  while (len > 0)
+  { done = (wr) ? pwrite (fd, p, len, off) : pread (fd, p, len, off);
+    if (done == -1)
+       { if (errno == EINTR) continue;
+         return -EIO;
+       }
+    if (done == 0) return -EIO;                  /* unexpected end of the supporting file */
+    p += done;
+    off += done;
+    len -= done;
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Take a buffer from the pool, waiting for one to be released if the pool is empty.
+ *
+ *  \return pointer to the buffer
+ */
+
+static unsigned char *soDirectGetBuffer (void)
+{
+  unsigned char *b;                              /* buffer */
+
+  pthread_mutex_lock (&RX->poolAccess);
+  while (RX->nfreebuf == 0)
+    pthread_cond_wait (&RX->poolFree, &RX->poolAccess);
+  b = RX->freebuf[--RX->nfreebuf];
+  pthread_mutex_unlock (&RX->poolAccess);
+
+  return b;
+}
+
+/**
+ *  \brief Return a buffer to the pool.
+ *
+ *  \param b pointer to the buffer
+ */
+
+static void soDirectPutBuffer (unsigned char *b)
+{
+  pthread_mutex_lock (&RX->poolAccess);
+  RX->freebuf[RX->nfreebuf++] = b;
+  pthread_cond_signal (&RX->poolFree);
+  pthread_mutex_unlock (&RX->poolAccess);
+}
+
+/**
+ *  \brief Lock, or unlock, the logical blocks of the host a write touches.
+ *
+ *  The locks are taken in increasing order of their index in the table, so that writes whose ranges overlap can not
+ *  deadlock; a range which spans as many blocks as there are locks takes all of them.
+ *
+ *  \param lock operation: \c 1, lock; \c 0, unlock
+ *  \param start byte position of the start of the range on the device (a multiple of the alignment)
+ *  \param end byte position of the end of the range on the device (a multiple of the alignment)
+ */
+
+static void soDirectLockRange (int lock, uint64_t start, uint64_t end)
+{
+  uint64_t first = start / RX->align;            /* number of the first logical block of the host */
+  uint64_t n = (end - start) / RX->align;        /* number of logical blocks of the host */
+  uint32_t k;                                    /* lock index */
+
+  for (k = 0; k < DIRECT_STRIPES; k++)
+    if ((n >= DIRECT_STRIPES) || (((k - first) & (DIRECT_STRIPES - 1)) < n))
+       { if (lock)
+            pthread_mutex_lock (&RX->stripe[k]);
+            else pthread_mutex_unlock (&RX->stripe[k]);
+       }
+}
+
+/**
+ *  \brief Set up the state of the direct I/O backend in a context.
+ *
+ *  \param state pointer to the state
+ */
+
+static void soInitState (void *state)
+{
+  SORawDirectState *rx = state;                  /* pointer to the state */
+  uint32_t k;                                    /* lock index */
+
+  memset (rx, 0, sizeof (SORawDirectState));
+  rx->dfd = -1;
+  rx->bfd = -1;
+  rx->align = 1;
+  pthread_mutex_init (&rx->poolAccess, NULL);
+  pthread_cond_init (&rx->poolFree, NULL);
+  for (k = 0; k < DIRECT_STRIPES; k++)
+    pthread_mutex_init (&rx->stripe[k], NULL);
+}
+
+/**
+ *  \brief Register the state of the direct I/O backend, before <tt>main</tt> is called.
+ */
+
+static void __attribute__ ((constructor)) soRegisterState (void)
+{
+  soRegisterContextState (CTX_RAWDIRECT, sizeof (SORawDirectState), soInitState, &defState);
+}
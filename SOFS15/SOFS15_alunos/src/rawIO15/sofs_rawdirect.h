@@ -0,0 +1,104 @@
+/**
+ *  \file sofs_rawdirect.h (interface file)
+ *
+ *  \brief Access to the storage device bypassing the host page cache (O_DIRECT).
+ *
+ *  Direct I/O requires the buffer address, the file position and the transfer size to be multiples of the logical
+ *  block size of the host. Transfers which do not meet these requirements go through a pool of suitably aligned
+ *  buffers, the positions being rounded to the logical block size of the host (partial blocks are written by a read,
+ *  modify and write sequence).
+ *  One should notice that this module does not stand alone: it supposes a very tight coupling with the raw disk
+ *  implementation, its only application.
+ *
+ *  The following operations are defined:
+ *    \li open the storage device for direct I/O
+ *    \li close the storage device previously opened for direct I/O
+ *    \li get the alignment required for direct I/O
+ *    \li transfer a contiguous byte range between a buffer and the storage device
+ *    \li transfer a contiguous byte range between a list of buffers and the storage device.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_RAWDIRECT_H_
+#define SOFS_RAWDIRECT_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ *  \brief Open the storage device for direct I/O.
+ *
+ *  A second communication channel, bypassing the host page cache, is established with the storage device and the pool
+ *  of aligned buffers is set up. The channel already opened in the usual way is kept for the final part of the device,
+ *  when its size is not a multiple of the logical block size of the host.
+ *
+ *  \param devname absolute path to the Linux file that simulates the storage device
+ *  \param fd file descriptor of the channel already opened in the usual way
+ *  \param size size in bytes of the storage device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the device is already opened for direct I/O
+ *  \return -\c ENOMEM, if the pool of aligned buffers can not be set up
+ *  \return -<em>other specific error</em> issued by \e open system call (-\c EINVAL, if direct I/O is not supported
+ *          by the host file system)
+ */
+
+extern int soDirectOpen (const char *devname, int fd, uint64_t size);
+
+/**
+ *  \brief Close the storage device previously opened for direct I/O.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not opened for direct I/O
+ */
+
+extern int soDirectClose (void);
+
+/**
+ *  \brief Get the alignment required for direct I/O.
+ *
+ *  Buffers whose address is a multiple of this value, and transfers whose position and size are multiples of it, are
+ *  moved straight from / to the storage device, with no intermediate copy.
+ *
+ *  \return the alignment in bytes, if the device is opened for direct I/O
+ *  \return <tt>1</tt>, otherwise
+ */
+
+extern uint32_t soDirectAlignment (void);
+
+/**
+ *  \brief Transfer a contiguous byte range between a buffer and the storage device.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param buf pointer to the buffer
+ *  \param len number of bytes to be transferred
+ *  \param off byte position on the device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ */
+
+extern int soDirectTransfer (int wr, void *buf, size_t len, uint64_t off);
+
+/**
+ *  \brief Transfer a contiguous byte range between a list of buffers and the storage device.
+ *
+ *  The transfer is performed by a single vectored system call, provided every buffer meets the alignment requirements
+ *  of direct I/O; otherwise, nothing is transferred and the caller must fall back to soDirectTransfer.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param iov pointer to the array of buffers
+ *  \param cnt number of buffers
+ *  \param off byte position on the device
+ *
+ *  \return the number of bytes transferred (<tt>0 (zero)</tt>, if the buffers are not suitably aligned)
+ *  \return <tt>-1</tt>, if it fails on reading or writing (\e errno is set accordingly)
+ */
+
+extern ssize_t soDirectTransferv (int wr, const struct iovec *iov, int cnt, uint64_t off);
+
+#endif /* SOFS_RAWDIRECT_H_ */
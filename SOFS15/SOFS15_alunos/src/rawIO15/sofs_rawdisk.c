@@ -10,7 +10,38 @@
  *    \li read a block of data from the storage device
  *    \li write a block of data to the storage device
  *    \li read a cluster of data from the storage device
- *    \li write a cluster of data to the storage device.
+ *    \li write a cluster of data to the storage device
+ *    \li read / write a run of contiguous blocks or clusters from / to the storage device
+ *    \li read / write a list of blocks or clusters, not necessarily contiguous, from / to the storage device
+ *    \li select the device backend (synchronous, io_uring, memory-mapped or direct) to be used on the next open
+ *    \li submit a block or cluster transfer without waiting for it to complete
+ *    \li collect the outcome of previously submitted transfers
+ *    \li get a direct pointer to a block of a memory-mapped device
+ *    \li force previous writes to a range of blocks to reach stable storage
+ *    \li get the buffer alignment which allows transfers with no intermediate copy
+ *    \li get the statistics of the transfers carried out since the device was opened.
+ *
+ *  All synchronous transfers use positional I/O (\e pread / \e pwrite), so there is no shared file offset: each
+ *  operation is a single system call and concurrent transfers on different blocks do not interfere with each other.
+ *
+ *  Asynchronous transfers go through an io_uring instance when the \c RAW_URING backend was selected and the host
+ *  supports it: submissions are batched and handed to the kernel when the submission ring fills up or completions are
+ *  requested, so many of them may be in flight at once. Otherwise, they are carried out synchronously on submission
+ *  and their outcome is kept until collected, so callers do not need to care which backend is active.
+ *
+ *  When the \c RAW_MMAP backend is selected, the whole supporting file is mapped in memory on open and every transfer,
+ *  synchronous or not, becomes a plain memory copy, with no system call involved. Writes reach the page cache at once,
+ *  as with \e pwrite; they are forced to stable storage by soSyncDevice and on close.
+ *
+ *  When the \c RAW_DIRECT backend is selected, transfers bypass the host page cache (\e O_DIRECT), so that blocks are
+ *  not cached twice, once in the buffercache and again by the host. Transfers whose buffer or range are not aligned to
+ *  the logical block size of the host go through a pool of aligned buffers.
+ *
+ *  Every transfer is accounted for, its duration being measured on a monotonic clock and counted on a logarithmic
+ *  latency histogram. The counters are updated by atomic operations, so concurrent transfers need no locking flag.
+ *
+ *  The communication channel, the backend and the statistics belong to the SOFS context bound to the calling thread
+ *  (see sofs_context.h), so a process may keep several storage devices open, one per context.
  *
  *  \author Artur Carneiro Pereira - September 2007
  *  \author Miguel Oliveira e Silva - September 2009
@@ -18,23 +49,89 @@
  */
 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
+#include <time.h>
 #define __USE_GNU
 #include <fcntl.h>
 
 #include "sofs_const.h"
 #include "sofs_probe.h"
+#include "sofs_rawdisk.h"
+#include "sofs_rawuring.h"
+#include "sofs_rawdirect.h"
+#include "sofs_context.h"
 
 /*
  *  Internal data structure
  */
-/** \brief File descriptor of the Linux file that simulates the magnetic disk */
-static int fd = -1;
-/** \brief Number of blocks of the storage device */
-static uint32_t bnmax = 0;
+/** \brief maximum number of buffers transferred by a single vectored system call */
+#ifdef IOV_MAX
+#define RAW_IOV_MAX IOV_MAX
+#else
+#define RAW_IOV_MAX 1024
+#endif
+
+/** \brief maximum depth of the submission queue of asynchronous transfers */
+#define RAW_MAX_DEPTH 512
+/** \brief maximum number of asynchronous transfers whose outcome has not been collected */
+#define RAW_MAX_PENDING (2 * RAW_MAX_DEPTH)
+
+/** \brief State of the raw disk (one per SOFS context) */
+
+typedef struct
+{ /** \brief File descriptor of the Linux file that simulates the magnetic disk */
+    int fd;
+  /** \brief Number of blocks of the storage device */
+    uint32_t bnmax;
+  /** \brief Mapping of the Linux file that simulates the magnetic disk (memory-mapped backend) */
+    unsigned char *map;
+  /** \brief Backend selected for the next open */
+    uint32_t reqmode;
+  /** \brief Depth of the submission queue selected for the next open */
+    uint32_t reqdepth;
+  /** \brief Backend actually in use while the device is opened */
+    uint32_t curmode;
+  /** \brief Table of outstanding asynchronous transfers (io_uring backend): caller tag, expected length, direction
+   *         and time of submission */
+    struct
+    { uint64_t tag;
+      uint32_t len;
+      uint32_t wr;
+      uint64_t start;
+    } slot[RAW_MAX_PENDING];
+  /** \brief Stack of free entries of the table of outstanding asynchronous transfers */
+    uint32_t freeslot[RAW_MAX_PENDING];
+  /** \brief Number of free entries of the table of outstanding asynchronous transfers */
+    uint32_t nfreeslot;
+  /** \brief Queue of completed asynchronous transfers (synchronous backend) */
+    SORawCompletion done[RAW_MAX_PENDING];
+  /** \brief Head and number of entries of the queue of completed asynchronous transfers */
+    uint32_t donehead, ndone;
+  /** \brief Statistics of the transfers carried out since the device was opened */
+    SORawStats stats;
+} SORawDiskState;
+
+/** \brief State of the raw disk in the default context */
+static SORawDiskState defState;
+
+/** \brief State of the raw disk in the context bound to the calling thread */
+#define RD  ((SORawDiskState *) CTX_STATE (CTX_RAWDISK))
+
+/* Allusion to internal functions */
+
+static int soRawTransfer (int wr, void *buf, size_t len, off_t off);
+static int soRawTransferv (int wr, uint32_t count, const uint32_t *n, void * const *buf, uint32_t nblk);
+static int soRawSubmit (uint32_t op, uint32_t n, uint32_t nblk, void *buf, uint64_t tag);
+static void soRawAccount (int wr, size_t len, uint64_t start);
+static uint64_t soRawTime (void);
+static void soInitState (void *state);
 
 /**
  *  \brief Open the storage device.
@@ -42,6 +139,10 @@ static uint32_t bnmax = 0;
  *  A communication channel is established with the storage device.
  *  It is supposed that no communication channel was previously established.
  *  The Linux file that simulates the storage device must exist and have a size multiple of the block size.
+ *  If the \c RAW_URING backend was selected and an io_uring instance can not be set up, asynchronous transfers fall
+ *  back silently to the synchronous path. Likewise, if the \c RAW_MMAP backend was selected and the supporting file
+ *  can not be mapped in memory, or the \c RAW_DIRECT backend was selected and the host file system does not support
+ *  direct I/O, all transfers fall back to positional I/O through the host page cache.
  *
  *  \param devname absolute path to the Linux file that simulates the storage device
  *  \param p_bnmax pointer to a location where the number of blocks of the device is to be stored
@@ -50,7 +151,7 @@ static uint32_t bnmax = 0;
  *  \return -\c EINVAL, if \e devname or \e p_bnmax are \c NULL
  *  \return -\c EBUSY, if the device is already opened
  *  \return -\c ELIBBAD, if the supporting file size is invalid
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e open or \e fstat system calls
  */
 
 int soOpenDevice (const char *devname, uint32_t *p_bnmax)
@@ -59,21 +160,50 @@ int soOpenDevice (const char *devname, uint32_t *p_bnmax)
 
   if ((devname == NULL) || (p_bnmax == NULL))
      return -EINVAL;                             /* checking for null pointers */
-  if (fd != -1) return -EBUSY;                   /* checking for device open state */
+  if (RD->fd != -1) return -EBUSY;               /* checking for device open state */
 
   /* opening supporting file in async mode for read and write */
 
-  if ((fd = open (devname, O_RDWR)) == -1)
+  if ((RD->fd = open (devname, O_RDWR)) == -1)
      return -errno;                              /* checking for opening error */
 
   /* checking device for conformity */
 
   struct stat st;
-  if (stat (devname, &st) == -1) return -errno;
-  if ((st.st_size % BLOCK_SIZE) != 0) return -ELIBBAD;
+  if (fstat (RD->fd, &st) == -1)
+     { int err = errno;
+       close (RD->fd);
+       RD->fd = -1;
+       return -err;
+     }
+  if ((st.st_size % BLOCK_SIZE) != 0)
+     { close (RD->fd);
+       RD->fd = -1;
+       return -ELIBBAD;
+     }
+
+  RD->bnmax = st.st_size / BLOCK_SIZE;           /* get number of blocks of the device */
+  *p_bnmax = RD->bnmax;
 
-  bnmax = st.st_size / BLOCK_SIZE;               /* get number of blocks of the device */
-  *p_bnmax = bnmax;
+  /* set up the backend for asynchronous transfers */
+
+  uint32_t i;
+  RD->curmode = RAW_SYNC;
+  if ((RD->reqmode == RAW_URING) && (soUringOpen (RD->fd, RD->reqdepth) == 0))
+     RD->curmode = RAW_URING;
+  if ((RD->reqmode == RAW_MMAP) && (RD->bnmax > 0))
+     { RD->map = mmap (NULL, (size_t) RD->bnmax * BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, RD->fd, 0);
+       if (RD->map != MAP_FAILED)
+          RD->curmode = RAW_MMAP;
+          else RD->map = NULL;
+     }
+  if ((RD->reqmode == RAW_DIRECT) && (soDirectOpen (devname, RD->fd, (uint64_t) st.st_size) == 0))
+     RD->curmode = RAW_DIRECT;
+  for (i = 0; i < RAW_MAX_PENDING; i++)
+    RD->freeslot[i] = RAW_MAX_PENDING - 1 - i;
+  RD->nfreeslot = RAW_MAX_PENDING;
+  RD->donehead = RD->ndone = 0;
+  memset (&RD->stats, 0, sizeof (RD->stats));
 
   return 0;
 }
@@ -82,6 +212,8 @@ int soOpenDevice (const char *devname, uint32_t *p_bnmax)
  *  \brief Close the storage device.
  *
  *  The communication channel previously established with the storage device is closed.
+ *  Asynchronous transfers still in flight are waited for; the outcome of those not yet collected is discarded.
+ *  If the device is memory-mapped, the mapping is written back to stable storage before being removed.
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EBADF, if the device is not opened
@@ -91,11 +223,23 @@ int soCloseDevice (void)
 {
   soColorProbe (852, "07;31", "soCloseDevice()\n");
 
-  if (fd == -1) return -EBADF;                   /* checking for device close state */
+  if (RD->fd == -1) return -EBADF;               /* checking for device close state */
+
+  if (RD->curmode == RAW_URING)                  /* wait for transfers in flight and tear down io_uring */
+     soUringClose ();
+  if (RD->curmode == RAW_DIRECT)                 /* close the channel bypassing the host page cache */
+     soDirectClose ();
+  if (RD->map != NULL)                           /* write back and remove the mapping */
+     { msync (RD->map, (size_t) RD->bnmax * BLOCK_SIZE, MS_SYNC);
+       munmap (RD->map, (size_t) RD->bnmax * BLOCK_SIZE);
+       RD->map = NULL;
+     }
+  RD->curmode = RAW_SYNC;
+  RD->ndone = 0;                                 /* outcome of uncollected transfers is lost */
 
-  close (fd);                                    /* close the device */
-  bnmax = 0;                                     /* reset number of blocks of the storage device */
-  fd = -1;                                       /* reset file descriptor of the Linux file that simulates the
+  close (RD->fd);                                /* close the device */
+  RD->bnmax = 0;                                 /* reset number of blocks of the storage device */
+  RD->fd = -1;                                   /* reset file descriptor of the Linux file that simulates the
                                                     magnetic disk */
 
   return 0;
@@ -115,7 +259,6 @@ int soCloseDevice (void)
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 int soReadRawBlock (uint32_t n, void *buf)
@@ -123,15 +266,12 @@ int soReadRawBlock (uint32_t n, void *buf)
   soColorProbe (853, "07;31", "soReadRawBlock(%"PRIu32", %p)\n", n, buf);
 
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
-  if (n >= bnmax) return -EINVAL;                /* checking for block number */
-  if (fd == -1) return -EBADF;                   /* checking for device closed state */
-
-  /* set file current position to the required block and read its contents */
+  if (n >= RD->bnmax) return -EINVAL;            /* checking for block number */
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (read (fd, buf, BLOCK_SIZE) != BLOCK_SIZE) return -EIO;
+  /* read the contents of the required block at its position in the supporting file */
 
-  return 0;
+  return soRawTransfer (0, buf, BLOCK_SIZE, (off_t) BLOCK_SIZE * n);
 }
 
 /**
@@ -148,7 +288,6 @@ int soReadRawBlock (uint32_t n, void *buf)
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 int soWriteRawBlock (uint32_t n, void *buf)
@@ -156,15 +295,12 @@ int soWriteRawBlock (uint32_t n, void *buf)
   soColorProbe (854, "07;31", "soWriteRawBlock(%"PRIu32", %p)\n", n, buf);
 
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
-  if (n >= bnmax) return -EINVAL;                /* checking for block number */
-  if (fd == -1) return -EBADF;                   /* checking for device closed state */
-
-  /* set file current position to the required block and write its contents */
+  if (n >= RD->bnmax) return -EINVAL;            /* checking for block number */
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (write (fd, buf, BLOCK_SIZE) != BLOCK_SIZE) return -EIO;
+  /* write the contents of the required block at its position in the supporting file */
 
-  return 0;
+  return soRawTransfer (1, buf, BLOCK_SIZE, (off_t) BLOCK_SIZE * n);
 }
 
 /**
@@ -181,7 +317,6 @@ int soWriteRawBlock (uint32_t n, void *buf)
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 int soReadRawCluster (uint32_t n, void *buf)
@@ -189,16 +324,13 @@ int soReadRawCluster (uint32_t n, void *buf)
   soColorProbe (855, "07;31", "soReadRawCluster(%"PRIu32", %p)\n", n, buf);
 
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
-  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+  if ((n + BLOCKS_PER_CLUSTER) > RD->bnmax)      /* checking for cluster number */
      return -EINVAL;
-  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
 
-  /* Set file current position to first block of the required cluster and read blocks contents in succession */
+  /* read the contents of the blocks of the required cluster in succession, starting at its first block */
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (read (fd, buf, CLUSTER_SIZE) != CLUSTER_SIZE) return -EIO;
-
-  return 0;
+  return soRawTransfer (0, buf, CLUSTER_SIZE, (off_t) BLOCK_SIZE * n);
 }
 
 /**
@@ -215,7 +347,6 @@ int soReadRawCluster (uint32_t n, void *buf)
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 int soWriteRawCluster (uint32_t n, void *buf)
@@ -223,14 +354,738 @@ int soWriteRawCluster (uint32_t n, void *buf)
   soColorProbe (856, "07;31", "soWriteRawCluster(%"PRIu32", %p)\n", n, buf);
 
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
-  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+  if ((n + BLOCKS_PER_CLUSTER) > RD->bnmax)      /* checking for cluster number */
+     return -EINVAL;
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  /* write the contents of the blocks of the required cluster in succession, starting at its first block */
+
+  return soRawTransfer (1, buf, CLUSTER_SIZE, (off_t) BLOCK_SIZE * n);
+}
+
+/**
+ *  \brief Read a run of contiguous blocks of data from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block to be read, the number of blocks and a pointer to a previously allocated
+ *  buffer, large enough to hold all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first data block to be read from
+ *  \param count number of blocks to be read
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+int soReadRawBlocks (uint32_t n, uint32_t count, void *buf)
+{
+  soColorProbe (857, "07;31", "soReadRawBlocks(%"PRIu32", %"PRIu32", %p)\n", n, count, buf);
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + count) > RD->bnmax)        /* checking for block numbers */
+     return -EINVAL;
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  return soRawTransfer (0, buf, (size_t) count * BLOCK_SIZE, (off_t) BLOCK_SIZE * n);
+}
+
+/**
+ *  \brief Write a run of contiguous blocks of data to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block to be written, the number of blocks and a pointer to a previously
+ *  allocated buffer, holding all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first data block to be written into
+ *  \param count number of blocks to be written
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+int soWriteRawBlocks (uint32_t n, uint32_t count, void *buf)
+{
+  soColorProbe (858, "07;31", "soWriteRawBlocks(%"PRIu32", %"PRIu32", %p)\n", n, count, buf);
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + count) > RD->bnmax)        /* checking for block numbers */
+     return -EINVAL;
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  return soRawTransfer (1, buf, (size_t) count * BLOCK_SIZE, (off_t) BLOCK_SIZE * n);
+}
+
+/**
+ *  \brief Read a run of contiguous clusters of data from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster to be read, the number of clusters and a pointer
+ *  to a previously allocated buffer, large enough to hold all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first block of the first data cluster to be read from
+ *  \param count number of clusters to be read
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+int soReadRawClusters (uint32_t n, uint32_t count, void *buf)
+{
+  soColorProbe (859, "07;31", "soReadRawClusters(%"PRIu32", %"PRIu32", %p)\n", n, count, buf);
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + (uint64_t) count * BLOCKS_PER_CLUSTER) > RD->bnmax)
+     return -EINVAL;                             /* checking for cluster numbers */
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  return soRawTransfer (0, buf, (size_t) count * CLUSTER_SIZE, (off_t) BLOCK_SIZE * n);
+}
+
+/**
+ *  \brief Write a run of contiguous clusters of data to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster to be written, the number of clusters and a
+ *  pointer to a previously allocated buffer, holding all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first block of the first data cluster to be written into
+ *  \param count number of clusters to be written
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+int soWriteRawClusters (uint32_t n, uint32_t count, void *buf)
+{
+  soColorProbe (860, "07;31", "soWriteRawClusters(%"PRIu32", %"PRIu32", %p)\n", n, count, buf);
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + (uint64_t) count * BLOCKS_PER_CLUSTER) > RD->bnmax)
+     return -EINVAL;                             /* checking for cluster numbers */
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  return soRawTransfer (1, buf, (size_t) count * CLUSTER_SIZE, (off_t) BLOCK_SIZE * n);
+}
+
+/**
+ *  \brief Read a list of blocks of data, not necessarily contiguous, from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  An array with the physical numbers of the data blocks to be read and an array of pointers to previously allocated
+ *  buffers, one per block, are supplied as arguments.
+ *  Blocks whose physical numbers follow each other in the list are gathered into a single system call.
+ *
+ *  \param count number of blocks to be read
+ *  \param n pointer to the array of physical numbers of the data blocks to be read from
+ *  \param buf pointer to the array of pointers to the buffers where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+int soReadRawBlockv (uint32_t count, const uint32_t *n, void * const *buf)
+{
+  soColorProbe (861, "07;31", "soReadRawBlockv(%"PRIu32", %p, %p)\n", count, n, buf);
+
+  return soRawTransferv (0, count, n, buf, 1);
+}
+
+/**
+ *  \brief Write a list of blocks of data, not necessarily contiguous, to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  An array with the physical numbers of the data blocks to be written and an array of pointers to previously
+ *  allocated buffers, one per block, are supplied as arguments.
+ *  Blocks whose physical numbers follow each other in the list are gathered into a single system call.
+ *
+ *  \param count number of blocks to be written
+ *  \param n pointer to the array of physical numbers of the data blocks to be written into
+ *  \param buf pointer to the array of pointers to the buffers containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+int soWriteRawBlockv (uint32_t count, const uint32_t *n, void * const *buf)
+{
+  soColorProbe (862, "07;31", "soWriteRawBlockv(%"PRIu32", %p, %p)\n", count, n, buf);
+
+  return soRawTransferv (1, count, n, buf, 1);
+}
+
+/**
+ *  \brief Read a list of clusters of data, not necessarily contiguous, from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  An array with the physical numbers of the first block of the data clusters to be read and an array of pointers to
+ *  previously allocated buffers, one per cluster, are supplied as arguments.
+ *  Clusters which follow each other in the list and on the device are gathered into a single system call.
+ *
+ *  \param count number of clusters to be read
+ *  \param n pointer to the array of physical numbers of the first block of the data clusters to be read from
+ *  \param buf pointer to the array of pointers to the buffers where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+int soReadRawClusterv (uint32_t count, const uint32_t *n, void * const *buf)
+{
+  soColorProbe (863, "07;31", "soReadRawClusterv(%"PRIu32", %p, %p)\n", count, n, buf);
+
+  return soRawTransferv (0, count, n, buf, BLOCKS_PER_CLUSTER);
+}
+
+/**
+ *  \brief Write a list of clusters of data, not necessarily contiguous, to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  An array with the physical numbers of the first block of the data clusters to be written and an array of pointers
+ *  to previously allocated buffers, one per cluster, are supplied as arguments.
+ *  Clusters which follow each other in the list and on the device are gathered into a single system call.
+ *
+ *  \param count number of clusters to be written
+ *  \param n pointer to the array of physical numbers of the first block of the data clusters to be written into
+ *  \param buf pointer to the array of pointers to the buffers containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+int soWriteRawClusterv (uint32_t count, const uint32_t *n, void * const *buf)
+{
+  soColorProbe (864, "07;31", "soWriteRawClusterv(%"PRIu32", %p, %p)\n", count, n, buf);
+
+  return soRawTransferv (1, count, n, buf, BLOCKS_PER_CLUSTER);
+}
+
+/**
+ *  \brief Select the device backend.
+ *
+ *  The selection takes effect on the next opening of the storage device (either directly, or through the opening of
+ *  the buffercache) and remains in force for subsequent openings.
+ *
+ *  \param mode backend: \c RAW_SYNC, synchronous transfers; \c RAW_URING, io_uring, if supported by the host;
+ *              \c RAW_MMAP, memory-mapped supporting file; \c RAW_DIRECT, direct I/O, bypassing the host page cache
+ *  \param depth depth of the submission queue (\c 0 selects the default, \c RAW_DEFAULT_DEPTH)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>mode</em> is not valid or the <em>depth</em> is out of range
+ *  \return -\c EBUSY, if the device is already opened
+ */
+
+int soSetDeviceMode (uint32_t mode, uint32_t depth)
+{
+  soColorProbe (865, "07;31", "soSetDeviceMode(%"PRIu32", %"PRIu32")\n", mode, depth);
+
+  if ((mode != RAW_SYNC) && (mode != RAW_URING) && (mode != RAW_MMAP) && (mode != RAW_DIRECT))
+     return -EINVAL;                             /* checking for mode */
+  if (depth > RAW_MAX_DEPTH) return -EINVAL;     /* checking for depth */
+  if (RD->fd != -1) return -EBUSY;               /* checking for device open state */
+
+  RD->reqmode = mode;
+  RD->reqdepth = (depth == 0) ? RAW_DEFAULT_DEPTH : depth;
+
+  return 0;
+}
+
+/**
+ *  \brief Get the device backend which is actually in use.
+ *
+ *  \return \c RAW_URING, if the device is opened and an io_uring instance was set up
+ *  \return \c RAW_MMAP, if the device is opened and the supporting file was mapped in memory
+ *  \return \c RAW_DIRECT, if the device is opened and direct I/O is supported by the host file system
+ *  \return \c RAW_SYNC, otherwise
+ */
+
+uint32_t soGetDeviceMode (void)
+{
+  soColorProbe (866, "07;31", "soGetDeviceMode()\n");
+
+  return RD->curmode;
+}
+
+/**
+ *  \brief Submit a transfer of a block of data without waiting for it to complete.
+ *
+ *  The buffer must not be touched by the caller until the outcome of the transfer is collected by soCompleteRaw.
+ *
+ *  \param op direction of the transfer: \c RAW_READ, from the device; \c RAW_WRITE, to the device
+ *  \param n physical number of the data block
+ *  \param buf pointer to the buffer
+ *  \param tag value returned on completion to identify the transfer
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>operation</em> is not valid, the <em>buffer pointer</em> is \c NULL or the
+ *          <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EAGAIN, if too many transfers are outstanding (some must be collected first)
+ */
+
+int soSubmitRawBlock (uint32_t op, uint32_t n, void *buf, uint64_t tag)
+{
+  soColorProbe (867, "07;31", "soSubmitRawBlock(%"PRIu32", %"PRIu32", %p, %"PRIu64")\n", op, n, buf, tag);
+
+  return soRawSubmit (op, n, 1, buf, tag);
+}
+
+/**
+ *  \brief Submit a transfer of a cluster of data without waiting for it to complete.
+ *
+ *  The buffer must not be touched by the caller until the outcome of the transfer is collected by soCompleteRaw.
+ *
+ *  \param op direction of the transfer: \c RAW_READ, from the device; \c RAW_WRITE, to the device
+ *  \param n physical number of the first block of the data cluster
+ *  \param buf pointer to the buffer
+ *  \param tag value returned on completion to identify the transfer
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>operation</em> is not valid, the <em>buffer pointer</em> is \c NULL or the
+ *          <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EAGAIN, if too many transfers are outstanding (some must be collected first)
+ */
+
+int soSubmitRawCluster (uint32_t op, uint32_t n, void *buf, uint64_t tag)
+{
+  soColorProbe (868, "07;31", "soSubmitRawCluster(%"PRIu32", %"PRIu32", %p, %"PRIu64")\n", op, n, buf, tag);
+
+  return soRawSubmit (op, n, BLOCKS_PER_CLUSTER, buf, tag);
+}
+
+/**
+ *  \brief Collect the outcome of previously submitted transfers.
+ *
+ *  Pending submissions are handed to the device and the function waits until at least \e min transfers (bounded by
+ *  the number of outstanding ones) have completed. Up to \e max outcomes are then stored in the array supplied.
+ *
+ *  \param min minimum number of outcomes to wait for
+ *  \param cmp pointer to an array where the outcomes are to be stored: the tag of the transfer and its status
+ *             (<tt>0 (zero)</tt>, on success, -\c EIO, or -<em>other specific error</em>, on failure)
+ *  \param max number of elements of the array
+ *
+ *  \return the number of outcomes stored, on success
+ *  \return -\c EINVAL, if the <em>array pointer</em> is \c NULL or <em>min</em> is greater than <em>max</em>
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -<em>other specific error</em> issued by \e io_uring_enter system call
+ */
+
+int soCompleteRaw (uint32_t min, SORawCompletion *cmp, uint32_t max)
+{
+  soColorProbe (869, "07;31", "soCompleteRaw(%"PRIu32", %p, %"PRIu32")\n", min, cmp, max);
+
+  uint32_t k;                                    /* number of outcomes stored */
+  uint64_t idx;                                  /* entry of the table of outstanding transfers */
+  int res, stat;                                 /* result of a transfer and function return status */
+
+  if ((cmp == NULL) || (min > max)) return -EINVAL;
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  if (RD->curmode != RAW_URING)
+     { for (k = 0; (k < max) && (RD->ndone > 0); k++)
+       { cmp[k] = RD->done[RD->donehead];
+         RD->donehead = (RD->donehead + 1) % RAW_MAX_PENDING;
+         RD->ndone -= 1;
+       }
+       return k;
+     }
+
+  if ((stat = soUringSubmit (min)) != 0) return stat;
+  for (k = 0; (k < max) && (soUringReap (&idx, &res) == 1); k++)
+  { cmp[k].tag = RD->slot[idx].tag;
+    cmp[k].stat = (res == (int) RD->slot[idx].len) ? 0 : ((res < 0) ? res : -EIO);
+    soRawAccount (RD->slot[idx].wr, RD->slot[idx].len, RD->slot[idx].start);
+    RD->freeslot[RD->nfreeslot++] = (uint32_t) idx;
+  }
+
+  return k;
+}
+
+/**
+ *  \brief Get a direct pointer to a block of a memory-mapped device.
+ *
+ *  The pointer refers to the mapping of the supporting file, so reading through it is the same as reading the block
+ *  and writing through it is the same as writing the block. It remains valid until the device is closed.
+ *
+ *  \param n physical number of the data block
+ *  \param p_ptr pointer to a location where the pointer to the block is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the device is not memory-mapped
+ */
+
+int soMapRawBlock (uint32_t n, void **p_ptr)
+{
+  soColorProbe (870, "07;31", "soMapRawBlock(%"PRIu32", %p)\n", n, p_ptr);
+
+  if (p_ptr == NULL) return -EINVAL;             /* checking for null pointer */
+  if (n >= RD->bnmax) return -EINVAL;            /* checking for block number */
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+  if (RD->map == NULL) return -ENOTSUP;          /* checking for memory-mapped device */
+
+  *p_ptr = RD->map + (size_t) BLOCK_SIZE * n;
+
+  return 0;
+}
+
+/**
+ *  \brief Force previous writes to a range of blocks to reach stable storage.
+ *
+ *  If the device is memory-mapped, the pages of the mapping which hold the range are written back; otherwise, the
+ *  data of the supporting file is synchronized as a whole.
+ *
+ *  \param n physical number of the first data block of the range
+ *  \param count number of blocks of the range
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing back
+ */
+
+int soSyncDevice (uint32_t n, uint32_t count)
+{
+  soColorProbe (871, "07;31", "soSyncDevice(%"PRIu32", %"PRIu32")\n", n, count);
+
+  size_t pg, start, end;                         /* page size and page aligned limits of the range */
+
+  if (((uint64_t) n + count) > RD->bnmax)        /* checking for block numbers */
+     return -EINVAL;
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  __atomic_fetch_add (&RD->stats.nSyncs, 1, __ATOMIC_RELAXED);
+  if (RD->map == NULL)
+     return (fdatasync (RD->fd) == 0) ? 0 : -EIO;
+  if (count == 0) return 0;
+  pg = (size_t) sysconf (_SC_PAGESIZE);
+  start = ((size_t) BLOCK_SIZE * n) / pg * pg;
+  end = (size_t) BLOCK_SIZE * (n + count);
+  if (msync (RD->map + start, end - start, MS_SYNC) != 0) return -EIO;
+
+  return 0;
+}
+
+/**
+ *  \brief Get the buffer alignment which allows transfers with no intermediate copy.
+ *
+ *  With the direct backend, buffers whose address is a multiple of this value are moved straight from / to the
+ *  storage device, provided the transfer covers whole logical blocks of the host. Buffers may be allocated
+ *  accordingly (by \e posix_memalign, for instance).
+ *
+ *  \return the alignment in bytes, if the device is opened with the direct backend
+ *  \return <tt>1</tt>, otherwise
+ */
+
+uint32_t soGetDeviceAlignment (void)
+{
+  soColorProbe (872, "07;31", "soGetDeviceAlignment()\n");
+
+  return (RD->curmode == RAW_DIRECT) ? soDirectAlignment () : 1;
+}
+
+/**
+ *  \brief Get the statistics of the transfers carried out since the device was opened.
+ *
+ *  Transfers may go on while the statistics are taken, so the counters are consistent one by one, but not necessarily
+ *  with each other. If the device is not opened, the statistics of the last time it was are got.
+ *
+ *  \param p_stats pointer to a location where the statistics are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL
+ */
+
+int soGetRawStats (SORawStats *p_stats)
+{
+  soColorProbe (873, "07;31", "soGetRawStats(%p)\n", p_stats);
+
+  uint32_t i;                                    /* bucket counter */
+
+  if (p_stats == NULL) return -EINVAL;           /* checking for null pointer */
+
+  p_stats->nReads = __atomic_load_n (&RD->stats.nReads, __ATOMIC_RELAXED);
+  p_stats->nWrites = __atomic_load_n (&RD->stats.nWrites, __ATOMIC_RELAXED);
+  p_stats->bytesRead = __atomic_load_n (&RD->stats.bytesRead, __ATOMIC_RELAXED);
+  p_stats->bytesWritten = __atomic_load_n (&RD->stats.bytesWritten, __ATOMIC_RELAXED);
+  p_stats->nSyncs = __atomic_load_n (&RD->stats.nSyncs, __ATOMIC_RELAXED);
+  for (i = 0; i < RAW_LAT_BUCKETS; i++)
+  { p_stats->readLat[i] = __atomic_load_n (&RD->stats.readLat[i], __ATOMIC_RELAXED);
+    p_stats->writeLat[i] = __atomic_load_n (&RD->stats.writeLat[i], __ATOMIC_RELAXED);
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Transfer a contiguous byte range between a buffer and the storage device.
+ *
+ *  Partial transfers and interrupted system calls are resumed until the whole range has been moved. If the device
+ *  is memory-mapped, the range is just copied from / to the mapping.
+ *  If the device is opened for direct I/O, the transfer is handed to the direct I/O module. Either way, it is accounted
+ *  for in the statistics of the device as a single transfer.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param buf pointer to the buffer
+ *  \param len number of bytes to be transferred
+ *  \param off byte position on the device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on reading or writing
+ */
+
+static int soRawTransfer (int wr, void *buf, size_t len, off_t off)
+{
+  unsigned char *p = buf;                        /* current position in the buffer */
+  size_t left = len;                             /* number of bytes still to be moved */
+  ssize_t done;                                  /* number of bytes moved by the last system call */
+  uint64_t start = soRawTime ();                 /* time the transfer started */
+  int stat = 0;                                  /* status of operation */
+
+  if (RD->map != NULL)                           /* memory-mapped device: no system call is needed */
+     { if (wr)
+          memcpy (RD->map + off, p, len);
+          else memcpy (p, RD->map + off, len);
+       left = 0;
+     }
+     else if (RD->curmode == RAW_DIRECT)         /* direct I/O: alignment constraints are dealt with elsewhere */
+             { if ((stat = soDirectTransfer (wr, buf, len, (uint64_t) off)) == 0)
+                  left = 0;
+             }
+     else while ((left > 0) && (stat == 0))
+          { done = (wr) ? pwrite (RD->fd, p, left, off) : pread (RD->fd, p, left, off);
+            if ((done == -1) && (errno == EINTR)) continue;
+            if (done <= 0)                       /* error or unexpected end of the supporting file */
+               stat = -EIO;
+               else { p += done;
+                      off += done;
+                      left -= done;
+                    }
+          }
+  soRawAccount (wr, len - left, start);
+
+  return stat;
+}
+
+/**
+ *  \brief Transfer a list of groups of blocks between separate buffers and the storage device.
+ *
+ *  Each group comprises \e nblk successive blocks. Runs of groups which are contiguous on the device are moved by a
+ *  single vectored system call (up to RAW_IOV_MAX buffers each). If the device is memory-mapped, groups are just
+ *  copied one at a time.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param count number of groups
+ *  \param n pointer to the array of physical numbers of the first block of each group
+ *  \param buf pointer to the array of pointers to the buffers, one per group
+ *  \param nblk number of blocks per group
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ */
+
+static int soRawTransferv (int wr, uint32_t count, const uint32_t *n, void * const *buf, uint32_t nblk)
+{
+  struct iovec iov[RAW_IOV_MAX];                 /* buffers of the current run */
+  size_t glen = (size_t) nblk * BLOCK_SIZE;      /* size in bytes of a group */
+  uint32_t i, k, r;                              /* counters */
+  ssize_t done;                                  /* number of bytes moved by the last system call */
+  uint64_t start;                                /* time the last system call started */
+
+  if ((n == NULL) || (buf == NULL)) return -EINVAL;
+  for (i = 0; i < count; i++)                    /* checking for null pointers and block numbers */
+    if ((buf[i] == NULL) || (((uint64_t) n[i] + nblk) > RD->bnmax))
+       return -EINVAL;
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
+
+  for (i = 0; i < count; i += r)
+  { /* gather the run of groups which follow each other on the device */
+
+    for (r = 1; (RD->map == NULL) && (i + r < count) && (r < RAW_IOV_MAX) && (n[i+r] == n[i+r-1] + nblk); r++) ;
+    if (r == 1)
+       { if (soRawTransfer (wr, buf[i], glen, (off_t) BLOCK_SIZE * n[i]) != 0) return -EIO;
+         continue;
+       }
+    for (k = 0; k < r; k++)
+    { iov[k].iov_base = buf[i+k];
+      iov[k].iov_len = glen;
+    }
+
+    start = soRawTime ();
+    if (RD->curmode == RAW_DIRECT)               /* not suitably aligned buffers are moved group by group below */
+       done = soDirectTransferv (wr, iov, r, (uint64_t) BLOCK_SIZE * n[i]);
+       else done = (wr) ? pwritev (RD->fd, iov, r, (off_t) BLOCK_SIZE * n[i])
+                        : preadv (RD->fd, iov, r, (off_t) BLOCK_SIZE * n[i]);
+    soRawAccount (wr, (done > 0) ? (size_t) done : 0, start);
+    if (done == (ssize_t) (r * glen)) continue;
+
+    /* partial or interrupted transfer: complete it group by group */
+
+    if ((done == -1) && (errno != EINTR)) return -EIO;
+    if (done < 0) done = 0;
+    for (k = 0; k < r; k++)
+    { size_t skip = ((size_t) done > glen) ? glen : (size_t) done;
+      done -= skip;
+      if ((skip < glen) && (soRawTransfer (wr, (unsigned char *) buf[i+k] + skip, glen - skip,
+                                           (off_t) BLOCK_SIZE * n[i+k] + skip) != 0))
+         return -EIO;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Submit a transfer of a group of blocks without waiting for it to complete.
+ *
+ *  With the io_uring backend, the request is queued in the submission ring, which is handed to the kernel only when
+ *  it fills up or completions are requested. Otherwise, the transfer is carried out at once and its outcome is queued
+ *  until collected.
+ *
+ *  \param op direction of the transfer: \c RAW_READ, from the device; \c RAW_WRITE, to the device
+ *  \param n physical number of the first block of the group
+ *  \param nblk number of blocks of the group
+ *  \param buf pointer to the buffer
+ *  \param tag value returned on completion to identify the transfer
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>operation</em> is not valid, the <em>buffer pointer</em> is \c NULL or the
+ *          <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EAGAIN, if too many transfers are outstanding
+ */
+
+static int soRawSubmit (uint32_t op, uint32_t n, uint32_t nblk, void *buf, uint64_t tag)
+{
+  uint32_t idx;                                  /* entry of the table of outstanding transfers */
+  int stat;                                      /* function return status */
+
+  if ((op != RAW_READ) && (op != RAW_WRITE))
+     return -EINVAL;                             /* checking for operation */
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (((uint64_t) n + nblk) > RD->bnmax)         /* checking for block number */
      return -EINVAL;
-  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  if (RD->fd == -1) return -EBADF;               /* checking for device closed state */
 
-  /* Set file current position to first block of the required cluster and write blocks contents in succession */
+  if (RD->curmode != RAW_URING)
+     { if (RD->ndone == RAW_MAX_PENDING) return -EAGAIN;
+       stat = soRawTransfer (op == RAW_WRITE, buf, (size_t) nblk * BLOCK_SIZE, (off_t) BLOCK_SIZE * n);
+       RD->done[(RD->donehead + RD->ndone) % RAW_MAX_PENDING].tag = tag;
+       RD->done[(RD->donehead + RD->ndone) % RAW_MAX_PENDING].stat = stat;
+       RD->ndone += 1;
+       return 0;
+     }
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (write (fd, buf, CLUSTER_SIZE) != CLUSTER_SIZE) return -EIO;
+  if (RD->nfreeslot == 0) return -EAGAIN;
+  idx = RD->freeslot[RD->nfreeslot-1];
+  stat = soUringPrepare (op == RAW_WRITE, buf, nblk * BLOCK_SIZE, (uint64_t) BLOCK_SIZE * n, idx);
+  if (stat == -EAGAIN)                           /* submission ring full: hand it to the kernel and retry */
+     { if ((stat = soUringSubmit (0)) != 0) return stat;
+       stat = soUringPrepare (op == RAW_WRITE, buf, nblk * BLOCK_SIZE, (uint64_t) BLOCK_SIZE * n, idx);
+     }
+  if (stat != 0) return stat;
+  RD->slot[idx].tag = tag;
+  RD->slot[idx].len = nblk * BLOCK_SIZE;
+  RD->slot[idx].wr = (op == RAW_WRITE);
+  RD->slot[idx].start = soRawTime ();
+  RD->nfreeslot -= 1;
 
   return 0;
 }
+
+/**
+ *  \brief Account for a transfer in the statistics of the storage device.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param len number of bytes transferred
+ *  \param start time the transfer started, in nanoseconds
+ */
+
+static void soRawAccount (int wr, size_t len, uint64_t start)
+{
+  uint64_t us = (soRawTime () - start) / 1000;  /* latency of the transfer in microseconds */
+  uint32_t b;                                    /* bucket of the latency histogram */
+
+  b = (us == 0) ? 0 : 64 - (uint32_t) __builtin_clzll (us);
+  if (b >= RAW_LAT_BUCKETS) b = RAW_LAT_BUCKETS - 1;
+  if (wr)
+     { __atomic_fetch_add (&RD->stats.nWrites, 1, __ATOMIC_RELAXED);
+       __atomic_fetch_add (&RD->stats.bytesWritten, len, __ATOMIC_RELAXED);
+       __atomic_fetch_add (&RD->stats.writeLat[b], 1, __ATOMIC_RELAXED);
+     }
+     else { __atomic_fetch_add (&RD->stats.nReads, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add (&RD->stats.bytesRead, len, __ATOMIC_RELAXED);
+            __atomic_fetch_add (&RD->stats.readLat[b], 1, __ATOMIC_RELAXED);
+          }
+}
+
+/**
+ *  \brief Get the present time.
+ *
+ *  \return the time in nanoseconds elapsed since an unspecified starting point
+ */
+
+static uint64_t soRawTime (void)
+{
+  struct timespec ts;                            /* present time */
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ *  \brief Set up the state of the raw disk in a context.
+ *
+ *  \param state pointer to the state
+ */
+
+static void soInitState (void *state)
+{
+  SORawDiskState *rd = state;                    /* pointer to the state */
+
+  rd->fd = -1;
+  rd->bnmax = 0;
+  rd->map = NULL;
+  rd->reqmode = RAW_SYNC;
+  rd->reqdepth = RAW_DEFAULT_DEPTH;
+  rd->curmode = RAW_SYNC;
+  rd->nfreeslot = 0;
+  rd->donehead = rd->ndone = 0;
+}
+
+/**
+ *  \brief Register the state of the raw disk, before <tt>main</tt> is called.
+ */
+
+static void __attribute__ ((constructor)) soRegisterState (void)
+{
+  soRegisterContextState (CTX_RAWDISK, sizeof (SORawDiskState), soInitState, &defState);
+}
@@ -10,7 +10,23 @@
  *    \li read a block of data from the storage device
  *    \li write a block of data to the storage device
  *    \li read a cluster of data from the storage device
- *    \li write a cluster of data to the storage device.
+ *    \li write a cluster of data to the storage device
+ *    \li read / write a run of contiguous blocks or clusters from / to the storage device
+ *    \li read / write a list of blocks or clusters, not necessarily contiguous, from / to the storage device
+ *    \li select the device backend (synchronous, io_uring, memory-mapped or direct) to be used on the next open
+ *    \li submit a block or cluster transfer without waiting for it to complete
+ *    \li collect the outcome of previously submitted transfers
+ *    \li get a direct pointer to a block of a memory-mapped device
+ *    \li force previous writes to a range of blocks to reach stable storage
+ *    \li get the buffer alignment which allows transfers with no intermediate copy
+ *    \li get the statistics of the transfers carried out since the device was opened.
+ *
+ *  All synchronous transfers use positional I/O, so there is no shared file offset and concurrent transfers on
+ *  different blocks do not interfere with each other. Asynchronous transfers go through io_uring, when selected and
+ *  supported by the host, and are otherwise carried out synchronously on submission. With the memory-mapped backend,
+ *  every transfer is a plain memory copy from / to a mapping of the whole supporting file. With the direct backend,
+ *  transfers bypass the host page cache. Every transfer is accounted for, whatever the backend, with its duration
+ *  kept on a latency histogram.
  *
  *  \author Artur Carneiro Pereira - September 2007
  *  \author Miguel Oliveira e Silva - September 2009
@@ -26,12 +42,76 @@
 
 #include <stdint.h>
 
+/** \brief asynchronous transfers are carried out synchronously on submission */
+#define RAW_SYNC   0
+/** \brief asynchronous transfers go through an io_uring instance */
+#define RAW_URING  1
+/** \brief the supporting file is mapped in memory and all transfers are memory copies */
+#define RAW_MMAP   2
+/** \brief all transfers bypass the host page cache (O_DIRECT) */
+#define RAW_DIRECT 3
+
+/** \brief default depth of the submission queue of asynchronous transfers */
+#define RAW_DEFAULT_DEPTH  64
+
+/** \brief transfer from the storage device */
+#define RAW_READ   0
+/** \brief transfer to the storage device */
+#define RAW_WRITE  1
+
+/** \brief number of buckets of the latency histograms of the transfers */
+#define RAW_LAT_BUCKETS  24
+
+/**
+ *  \brief Definition of the outcome of an asynchronous transfer.
+ */
+
+typedef struct soRawCompletion
+{
+   /** \brief value supplied on submission to identify the transfer */
+    uint64_t tag;
+   /** \brief status of the transfer: <tt>0 (zero)</tt>, on success; a negative error, on failure */
+    int stat;
+} SORawCompletion;
+
+/**
+ *  \brief Definition of the statistics of the transfers of the storage device.
+ *
+ *  A transfer is a single operation on the supporting file (a vectored one counts once) or a single asynchronous
+ *  request. Its latency, measured from the start of the operation, or from the submission of the request, to its
+ *  completion, is counted in bucket \e i of the histogram, if it is at least <tt>2^(i-1)</tt> and less than
+ *  <tt>2^i</tt> microseconds; bucket <tt>0</tt> counts the ones shorter than a microsecond and the last bucket all the
+ *  longer ones.
+ */
+
+typedef struct soRawStats
+{
+   /** \brief number of transfers from the storage device */
+    uint64_t nReads;
+   /** \brief number of transfers to the storage device */
+    uint64_t nWrites;
+   /** \brief number of bytes transferred from the storage device */
+    uint64_t bytesRead;
+   /** \brief number of bytes transferred to the storage device */
+    uint64_t bytesWritten;
+   /** \brief number of times previous writes were forced to stable storage */
+    uint64_t nSyncs;
+   /** \brief latency histogram of the transfers from the storage device */
+    uint64_t readLat[RAW_LAT_BUCKETS];
+   /** \brief latency histogram of the transfers to the storage device */
+    uint64_t writeLat[RAW_LAT_BUCKETS];
+} SORawStats;
+
 /**
  *  \brief Open the storage device.
  *
  *  A communication channel is established with the storage device.
  *  It is supposed that no communication channel was previously established.
  *  The Linux file that simulates the storage device must exist and have a size multiple of the block size.
+ *  If the \c RAW_URING backend was selected and an io_uring instance can not be set up, asynchronous transfers fall
+ *  back silently to the synchronous path. Likewise, if the \c RAW_MMAP backend was selected and the supporting file
+ *  can not be mapped in memory, or the \c RAW_DIRECT backend was selected and the host file system does not support
+ *  direct I/O, all transfers fall back to positional I/O through the host page cache.
  *
  *  \param devname absolute path to the Linux file that simulates the storage device
  *  \param p_bnmax pointer to a location where the number of blocks of the device is to be stored
@@ -40,7 +120,7 @@
  *  \return -\c EINVAL, if \e devname or \e p_bnmax are \c NULL
  *  \return -\c EBUSY, if the device is already opened
  *  \return -\c ELIBBAD, if the supporting file size is invalid
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e open or \e fstat system calls
  */
 
 extern int soOpenDevice (const char *devname, uint32_t *p_bnmax);
@@ -49,6 +129,8 @@ extern int soOpenDevice (const char *devname, uint32_t *p_bnmax);
  *  \brief Close the storage device.
  *
  *  The communication channel previously established with the storage device is closed.
+ *  Asynchronous transfers still in flight are waited for; the outcome of those not yet collected is discarded.
+ *  If the device is memory-mapped, the mapping is written back to stable storage before being removed.
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EBADF, if the device is not opened
@@ -70,7 +152,6 @@ extern int soCloseDevice (void);
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soReadRawBlock (uint32_t n, void *buf);
@@ -89,7 +170,6 @@ extern int soReadRawBlock (uint32_t n, void *buf);
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soWriteRawBlock (uint32_t n, void *buf);
@@ -108,7 +188,6 @@ extern int soWriteRawBlock (uint32_t n, void *buf);
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soReadRawCluster (uint32_t n, void *buf);
@@ -127,9 +206,314 @@ extern int soReadRawCluster (uint32_t n, void *buf);
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soWriteRawCluster (uint32_t n, void *buf);
 
+/**
+ *  \brief Read a run of contiguous blocks of data from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block to be read, the number of blocks and a pointer to a previously allocated
+ *  buffer, large enough to hold all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first data block to be read from
+ *  \param count number of blocks to be read
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+extern int soReadRawBlocks (uint32_t n, uint32_t count, void *buf);
+
+/**
+ *  \brief Write a run of contiguous blocks of data to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block to be written, the number of blocks and a pointer to a previously
+ *  allocated buffer, holding all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first data block to be written into
+ *  \param count number of blocks to be written
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+extern int soWriteRawBlocks (uint32_t n, uint32_t count, void *buf);
+
+/**
+ *  \brief Read a run of contiguous clusters of data from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster to be read, the number of clusters and a pointer
+ *  to a previously allocated buffer, large enough to hold all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first block of the first data cluster to be read from
+ *  \param count number of clusters to be read
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+extern int soReadRawClusters (uint32_t n, uint32_t count, void *buf);
+
+/**
+ *  \brief Write a run of contiguous clusters of data to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster to be written, the number of clusters and a
+ *  pointer to a previously allocated buffer, holding all of them in succession, are supplied as arguments.
+ *  The whole run is transferred by a single system call.
+ *
+ *  \param n physical number of the first block of the first data cluster to be written into
+ *  \param count number of clusters to be written
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+extern int soWriteRawClusters (uint32_t n, uint32_t count, void *buf);
+
+/**
+ *  \brief Read a list of blocks of data, not necessarily contiguous, from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  An array with the physical numbers of the data blocks to be read and an array of pointers to previously allocated
+ *  buffers, one per block, are supplied as arguments.
+ *  Blocks whose physical numbers follow each other in the list are gathered into a single system call.
+ *
+ *  \param count number of blocks to be read
+ *  \param n pointer to the array of physical numbers of the data blocks to be read from
+ *  \param buf pointer to the array of pointers to the buffers where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+extern int soReadRawBlockv (uint32_t count, const uint32_t *n, void * const *buf);
+
+/**
+ *  \brief Write a list of blocks of data, not necessarily contiguous, to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  An array with the physical numbers of the data blocks to be written and an array of pointers to previously
+ *  allocated buffers, one per block, are supplied as arguments.
+ *  Blocks whose physical numbers follow each other in the list are gathered into a single system call.
+ *
+ *  \param count number of blocks to be written
+ *  \param n pointer to the array of physical numbers of the data blocks to be written into
+ *  \param buf pointer to the array of pointers to the buffers containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+extern int soWriteRawBlockv (uint32_t count, const uint32_t *n, void * const *buf);
+
+/**
+ *  \brief Read a list of clusters of data, not necessarily contiguous, from the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  An array with the physical numbers of the first block of the data clusters to be read and an array of pointers to
+ *  previously allocated buffers, one per cluster, are supplied as arguments.
+ *  Clusters which follow each other in the list and on the device are gathered into a single system call.
+ *
+ *  \param count number of clusters to be read
+ *  \param n pointer to the array of physical numbers of the first block of the data clusters to be read from
+ *  \param buf pointer to the array of pointers to the buffers where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ */
+
+extern int soReadRawClusterv (uint32_t count, const uint32_t *n, void * const *buf);
+
+/**
+ *  \brief Write a list of clusters of data, not necessarily contiguous, to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  An array with the physical numbers of the first block of the data clusters to be written and an array of pointers
+ *  to previously allocated buffers, one per cluster, are supplied as arguments.
+ *  Clusters which follow each other in the list and on the device are gathered into a single system call.
+ *
+ *  \param count number of clusters to be written
+ *  \param n pointer to the array of physical numbers of the first block of the data clusters to be written into
+ *  \param buf pointer to the array of pointers to the buffers containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or any <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ */
+
+extern int soWriteRawClusterv (uint32_t count, const uint32_t *n, void * const *buf);
+
+/**
+ *  \brief Select the device backend.
+ *
+ *  The selection takes effect on the next opening of the storage device (either directly, or through the opening of
+ *  the buffercache) and remains in force for subsequent openings.
+ *
+ *  \param mode backend: \c RAW_SYNC, synchronous transfers; \c RAW_URING, io_uring, if supported by the host;
+ *              \c RAW_MMAP, memory-mapped supporting file; \c RAW_DIRECT, direct I/O, bypassing the host page cache
+ *  \param depth depth of the submission queue (\c 0 selects the default, \c RAW_DEFAULT_DEPTH)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>mode</em> is not valid or the <em>depth</em> is out of range
+ *  \return -\c EBUSY, if the device is already opened
+ */
+
+extern int soSetDeviceMode (uint32_t mode, uint32_t depth);
+
+/**
+ *  \brief Get the device backend which is actually in use.
+ *
+ *  \return \c RAW_URING, if the device is opened and an io_uring instance was set up
+ *  \return \c RAW_MMAP, if the device is opened and the supporting file was mapped in memory
+ *  \return \c RAW_DIRECT, if the device is opened and direct I/O is supported by the host file system
+ *  \return \c RAW_SYNC, otherwise
+ */
+
+extern uint32_t soGetDeviceMode (void);
+
+/**
+ *  \brief Submit a transfer of a block of data without waiting for it to complete.
+ *
+ *  The buffer must not be touched by the caller until the outcome of the transfer is collected by soCompleteRaw.
+ *
+ *  \param op direction of the transfer: \c RAW_READ, from the device; \c RAW_WRITE, to the device
+ *  \param n physical number of the data block
+ *  \param buf pointer to the buffer
+ *  \param tag value returned on completion to identify the transfer
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>operation</em> is not valid, the <em>buffer pointer</em> is \c NULL or the
+ *          <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EAGAIN, if too many transfers are outstanding (some must be collected first)
+ */
+
+extern int soSubmitRawBlock (uint32_t op, uint32_t n, void *buf, uint64_t tag);
+
+/**
+ *  \brief Submit a transfer of a cluster of data without waiting for it to complete.
+ *
+ *  The buffer must not be touched by the caller until the outcome of the transfer is collected by soCompleteRaw.
+ *
+ *  \param op direction of the transfer: \c RAW_READ, from the device; \c RAW_WRITE, to the device
+ *  \param n physical number of the first block of the data cluster
+ *  \param buf pointer to the buffer
+ *  \param tag value returned on completion to identify the transfer
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>operation</em> is not valid, the <em>buffer pointer</em> is \c NULL or the
+ *          <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EAGAIN, if too many transfers are outstanding (some must be collected first)
+ */
+
+extern int soSubmitRawCluster (uint32_t op, uint32_t n, void *buf, uint64_t tag);
+
+/**
+ *  \brief Collect the outcome of previously submitted transfers.
+ *
+ *  Pending submissions are handed to the device and the function waits until at least \e min transfers (bounded by
+ *  the number of outstanding ones) have completed. Up to \e max outcomes are then stored in the array supplied.
+ *
+ *  \param min minimum number of outcomes to wait for
+ *  \param cmp pointer to an array where the outcomes are to be stored: the tag of the transfer and its status
+ *             (<tt>0 (zero)</tt>, on success, -\c EIO, or -<em>other specific error</em>, on failure)
+ *  \param max number of elements of the array
+ *
+ *  \return the number of outcomes stored, on success
+ *  \return -\c EINVAL, if the <em>array pointer</em> is \c NULL or <em>min</em> is greater than <em>max</em>
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -<em>other specific error</em> issued by \e io_uring_enter system call
+ */
+
+extern int soCompleteRaw (uint32_t min, SORawCompletion *cmp, uint32_t max);
+
+/**
+ *  \brief Get a direct pointer to a block of a memory-mapped device.
+ *
+ *  The pointer refers to the mapping of the supporting file, so reading through it is the same as reading the block
+ *  and writing through it is the same as writing the block. It remains valid until the device is closed.
+ *
+ *  \param n physical number of the data block
+ *  \param p_ptr pointer to a location where the pointer to the block is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the device is not memory-mapped
+ */
+
+extern int soMapRawBlock (uint32_t n, void **p_ptr);
+
+/**
+ *  \brief Force previous writes to a range of blocks to reach stable storage.
+ *
+ *  If the device is memory-mapped, the pages of the mapping which hold the range are written back; otherwise, the
+ *  data of the supporting file is synchronized as a whole.
+ *
+ *  \param n physical number of the first data block of the range
+ *  \param count number of blocks of the range
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block numbers</em> are out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing back
+ */
+
+extern int soSyncDevice (uint32_t n, uint32_t count);
+
+/**
+ *  \brief Get the buffer alignment which allows transfers with no intermediate copy.
+ *
+ *  With the direct backend, buffers whose address is a multiple of this value are moved straight from / to the
+ *  storage device, provided the transfer covers whole logical blocks of the host. Buffers may be allocated
+ *  accordingly (by \e posix_memalign, for instance).
+ *
+ *  \return the alignment in bytes, if the device is opened with the direct backend
+ *  \return <tt>1</tt>, otherwise
+ */
+
+extern uint32_t soGetDeviceAlignment (void);
+
+/**
+ *  \brief Get the statistics of the transfers carried out since the device was opened.
+ *
+ *  Transfers may go on while the statistics are taken, so the counters are consistent one by one, but not necessarily
+ *  with each other. If the device is not opened, the statistics of the last time it was are got.
+ *
+ *  \param p_stats pointer to a location where the statistics are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL
+ */
+
+extern int soGetRawStats (SORawStats *p_stats);
+
 #endif /* SOFS_RAWDISK_H_ */
@@ -0,0 +1,394 @@
+/**
+ *  \file sofs_rawuring.c (implementation file)
+ *
+ *  \brief Asynchronous access to the storage device through a Linux io_uring instance.
+ *
+ *  Transfer requests are queued in the submission ring and handed to the kernel in batches, so that many of them may
+ *  be outstanding at the same time; their outcome is later collected from the completion ring.
+ *  The rings are driven directly through the \e io_uring_setup and \e io_uring_enter system calls, so there is no
+ *  dependency on any external library. When the host kernel headers do not provide io_uring, soUringOpen always
+ *  fails with -ENOSYS and the raw disk module keeps to synchronous transfers.
+ *
+ *  The following operations are defined:
+ *    \li set up an io_uring instance over an already opened file
+ *    \li tear down the io_uring instance
+ *    \li queue a transfer request in the submission ring
+ *    \li submit the queued requests and, optionally, wait for their completion
+ *    \li collect the outcome of a completed request.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sofs_rawuring.h"
+#include "sofs_context.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/*
+ *  Internal data structure
+ */
+/** \brief State of the io_uring backend (one per SOFS context) */
+
+typedef struct
+{ /** \brief File descriptor of the io_uring instance */
+    int ringfd;
+  /** \brief File descriptor of the Linux file that simulates the magnetic disk */
+    int devfd;
+  /** \brief Mapped area of the submission ring and its size */
+    void *sqmap;
+    size_t sqmapsz;
+  /** \brief Mapped area of the completion ring and its size (same as sqmap for single mmap kernels) */
+    void *cqmap;
+    size_t cqmapsz;
+  /** \brief Mapped array of submission queue entries and its size */
+    struct io_uring_sqe *sqes;
+    size_t sqesz;
+  /** \brief Submission ring: head, tail, mask and index array */
+    unsigned *sqhead, *sqtail, *sqmask, *sqarray;
+  /** \brief Submission ring: number of entries */
+    unsigned sqentries;
+  /** \brief Completion ring: head, tail, mask and entries */
+    unsigned *cqhead, *cqtail, *cqmask;
+    struct io_uring_cqe *cqes;
+  /** \brief Completion ring: number of entries */
+    unsigned cqentries;
+  /** \brief Number of requests queued but not yet handed to the kernel */
+    unsigned nqueued;
+  /** \brief Number of requests whose outcome has not been collected yet */
+    uint32_t npending;
+} SORawUringState;
+
+/** \brief State of the io_uring backend in the default context */
+static SORawUringState defState;
+
+/** \brief State of the io_uring backend in the context bound to the calling thread */
+#define RU  ((SORawUringState *) CTX_STATE (CTX_RAWURING))
+
+/**
+ *  \brief Set up an io_uring instance over an already opened file.
+ *
+ *  \param fd file descriptor of the Linux file that simulates the storage device
+ *  \param depth number of entries of the submission ring (rounded up by the kernel to a power of two)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if an instance is already set up
+ *  \return -\c ENOSYS, if io_uring is not supported by the host
+ *  \return -<em>other specific error</em> issued by \e io_uring_setup or \e mmap system calls
+ */
+
+int soUringOpen (int fd, uint32_t depth)
+{
+  struct io_uring_params p;                      /* parameters returned by the kernel */
+  int stat;                                      /* function return status */
+
+  if (RU->ringfd != -1) return -EBUSY;           /* checking for instance already set up */
+
+  memset (&p, 0, sizeof (p));
+  if ((RU->ringfd = (int) syscall (__NR_io_uring_setup, (depth == 0) ? 1 : depth, &p)) < 0)
+     { stat = -errno;
+       RU->ringfd = -1;
+       return stat;
+     }
+
+  /* map the rings and the submission queue entries */
+
+  RU->sqmapsz = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+  RU->cqmapsz = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+  if ((p.features & IORING_FEAT_SINGLE_MMAP) && (RU->cqmapsz > RU->sqmapsz))
+     RU->sqmapsz = RU->cqmapsz;
+  RU->sqmap = mmap (NULL, RU->sqmapsz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RU->ringfd,
+                    IORING_OFF_SQ_RING);
+  if (RU->sqmap == MAP_FAILED)
+     { stat = -errno;
+       RU->sqmap = NULL;
+       goto fail;
+     }
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+     { RU->cqmap = RU->sqmap;
+       RU->cqmapsz = RU->sqmapsz;
+     }
+     else { RU->cqmap = mmap (NULL, RU->cqmapsz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RU->ringfd,
+                              IORING_OFF_CQ_RING);
+            if (RU->cqmap == MAP_FAILED)
+               { stat = -errno;
+                 RU->cqmap = NULL;
+                 goto fail;
+               }
+          }
+  RU->sqesz = p.sq_entries * sizeof (struct io_uring_sqe);
+  RU->sqes = mmap (NULL, RU->sqesz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RU->ringfd, IORING_OFF_SQES);
+  if (RU->sqes == MAP_FAILED)
+     { stat = -errno;
+       RU->sqes = NULL;
+       goto fail;
+     }
+
+  RU->sqhead = (unsigned *) ((char *) RU->sqmap + p.sq_off.head);
+  RU->sqtail = (unsigned *) ((char *) RU->sqmap + p.sq_off.tail);
+  RU->sqmask = (unsigned *) ((char *) RU->sqmap + p.sq_off.ring_mask);
+  RU->sqarray = (unsigned *) ((char *) RU->sqmap + p.sq_off.array);
+  RU->sqentries = p.sq_entries;
+  RU->cqhead = (unsigned *) ((char *) RU->cqmap + p.cq_off.head);
+  RU->cqtail = (unsigned *) ((char *) RU->cqmap + p.cq_off.tail);
+  RU->cqmask = (unsigned *) ((char *) RU->cqmap + p.cq_off.ring_mask);
+  RU->cqes = (struct io_uring_cqe *) ((char *) RU->cqmap + p.cq_off.cqes);
+  RU->cqentries = p.cq_entries;
+
+  RU->devfd = fd;
+  RU->nqueued = 0;
+  RU->npending = 0;
+
+  return 0;
+
+fail:
+  if (RU->sqes != NULL) munmap (RU->sqes, RU->sqesz);
+  if ((RU->cqmap != NULL) && (RU->cqmap != RU->sqmap)) munmap (RU->cqmap, RU->cqmapsz);
+  if (RU->sqmap != NULL) munmap (RU->sqmap, RU->sqmapsz);
+  RU->sqes = NULL;
+  RU->sqmap = RU->cqmap = NULL;
+  close (RU->ringfd);
+  RU->ringfd = -1;
+
+  return stat;
+}
+
+/**
+ *  \brief Tear down the io_uring instance.
+ *
+ *  All requests still outstanding are waited for before the rings are unmapped; their outcome is lost.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if no instance is set up
+ */
+
+int soUringClose (void)
+{
+  uint64_t tag;                                  /* tag of a discarded completion */
+  int res;                                       /* result of a discarded completion */
+
+  if (RU->ringfd == -1) return -EBADF;           /* checking for instance not set up */
+
+  /* drain the outstanding requests, so that no buffer is touched by the kernel after return */
+
+  while (RU->npending > 0)
+  { if (soUringSubmit (1) != 0) break;
+    while (soUringReap (&tag, &res) == 1) ;
+  }
+
+  munmap (RU->sqes, RU->sqesz);
+  if (RU->cqmap != RU->sqmap) munmap (RU->cqmap, RU->cqmapsz);
+  munmap (RU->sqmap, RU->sqmapsz);
+  RU->sqes = NULL;
+  RU->sqmap = RU->cqmap = NULL;
+  close (RU->ringfd);
+  RU->ringfd = -1;
+  RU->devfd = -1;
+  RU->nqueued = 0;
+  RU->npending = 0;
+
+  return 0;
+}
+
+/**
+ *  \brief Queue a transfer request in the submission ring.
+ *
+ *  The request is not seen by the kernel until the next call to soUringSubmit.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param buf pointer to the buffer
+ *  \param len number of bytes to be transferred
+ *  \param off byte position on the device
+ *  \param tag value returned on completion to identify the request
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if no instance is set up
+ *  \return -\c EAGAIN, if the submission ring is full or too many requests are outstanding
+ */
+
+int soUringPrepare (int wr, void *buf, uint32_t len, uint64_t off, uint64_t tag)
+{
+  struct io_uring_sqe *sqe;                      /* entry being filled in */
+  unsigned tail, idx;                            /* position in the submission ring */
+
+  if (RU->ringfd == -1) return -EBADF;           /* checking for instance not set up */
+
+  /* the completion ring must never overflow, so the number of outstanding requests is bounded by its size */
+
+  tail = *RU->sqtail;
+  if ((tail - __atomic_load_n (RU->sqhead, __ATOMIC_ACQUIRE) >= RU->sqentries) || (RU->npending >= RU->cqentries))
+     return -EAGAIN;
+
+  idx = tail & *RU->sqmask;
+  sqe = &RU->sqes[idx];
+  memset (sqe, 0, sizeof (*sqe));
+  sqe->opcode = (wr) ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = RU->devfd;
+  sqe->addr = (uint64_t) (uintptr_t) buf;
+  sqe->len = len;
+  sqe->off = off;
+  sqe->user_data = tag;
+  RU->sqarray[idx] = idx;
+  __atomic_store_n (RU->sqtail, tail + 1, __ATOMIC_RELEASE);
+
+  RU->nqueued += 1;
+  RU->npending += 1;
+
+  return 0;
+}
+
+/**
+ *  \brief Submit the queued requests and wait for a minimum number of completions.
+ *
+ *  \param wait minimum number of completions that must be available on return
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if no instance is set up
+ *  \return -<em>other specific error</em> issued by \e io_uring_enter system call
+ */
+
+int soUringSubmit (uint32_t wait)
+{
+  long done;                                     /* number of entries consumed by the kernel */
+  unsigned avail;                                /* number of completions already available */
+
+  if (RU->ringfd == -1) return -EBADF;           /* checking for instance not set up */
+
+  if (wait > RU->npending) wait = RU->npending;
+  avail = __atomic_load_n (RU->cqtail, __ATOMIC_ACQUIRE) - *RU->cqhead;
+  while ((RU->nqueued > 0) || (avail < wait))
+  { done = syscall (__NR_io_uring_enter, RU->ringfd, RU->nqueued, (avail < wait) ? wait - avail : 0,
+                    (avail < wait) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (done < 0)
+       { if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)) continue;
+         return -errno;
+       }
+    RU->nqueued -= (unsigned) done;
+    avail = __atomic_load_n (RU->cqtail, __ATOMIC_ACQUIRE) - *RU->cqhead;
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Collect the outcome of a completed request.
+ *
+ *  \param p_tag pointer to a location where the tag of the request is to be stored
+ *  \param p_res pointer to a location where the result of the transfer (number of bytes, or a negative error) is to
+ *               be stored
+ *
+ *  \return <tt>1</tt>, if a completion was collected
+ *  \return <tt>0 (zero)</tt>, if no completion is available
+ *  \return -\c EBADF, if no instance is set up
+ */
+
+int soUringReap (uint64_t *p_tag, int *p_res)
+{
+  unsigned head;                                 /* position in the completion ring */
+  struct io_uring_cqe *cqe;                      /* entry being collected */
+
+  if (RU->ringfd == -1) return -EBADF;           /* checking for instance not set up */
+
+  head = *RU->cqhead;
+  if (head == __atomic_load_n (RU->cqtail, __ATOMIC_ACQUIRE)) return 0;
+  cqe = &RU->cqes[head & *RU->cqmask];
+  *p_tag = cqe->user_data;
+  *p_res = cqe->res;
+  __atomic_store_n (RU->cqhead, head + 1, __ATOMIC_RELEASE);
+  RU->npending -= 1;
+
+  return 1;
+}
+
+/**
+ *  \brief Get the number of requests which were queued but whose outcome has not been collected yet.
+ *
+ *  \return number of outstanding requests
+ */
+
+uint32_t soUringPending (void)
+{
+  return RU->npending;
+}
+
+/**
+ *  \brief Set up the state of the io_uring backend in a context.
+ *
+ *  \param state pointer to the state
+ */
+
+static void soInitState (void *state)
+{
+  SORawUringState *ru = state;                   /* pointer to the state */
+
+  memset (ru, 0, sizeof (SORawUringState));
+  ru->ringfd = -1;
+  ru->devfd = -1;
+}
+
+/**
+ *  \brief Register the state of the io_uring backend, before <tt>main</tt> is called.
+ */
+
+static void __attribute__ ((constructor)) soRegisterState (void)
+{
+  soRegisterContextState (CTX_RAWURING, sizeof (SORawUringState), soInitState, &defState);
+}
+
+#else /* HAVE_IO_URING */
+
+/* io_uring is not available: every operation fails and the raw disk module keeps to synchronous transfers */
+
+int soUringOpen (int fd, uint32_t depth)
+{
+  (void) fd;
+  (void) depth;
+  return -ENOSYS;
+}
+
+int soUringClose (void)
+{
+  return -EBADF;
+}
+
+int soUringPrepare (int wr, void *buf, uint32_t len, uint64_t off, uint64_t tag)
+{
+  (void) wr;
+  (void) buf;
+  (void) len;
+  (void) off;
+  (void) tag;
+  return -EBADF;
+}
+
+int soUringSubmit (uint32_t wait)
+{
+  (void) wait;
+  return -EBADF;
+}
+
+int soUringReap (uint64_t *p_tag, int *p_res)
+{
+  (void) p_tag;
+  (void) p_res;
+  return -EBADF;
+}
+
+uint32_t soUringPending (void)
+{
+  return 0;
+}
+
+#endif /* HAVE_IO_URING */
@@ -0,0 +1,106 @@
+/**
+ *  \file sofs_rawuring.h (interface file)
+ *
+ *  \brief Asynchronous access to the storage device through a Linux io_uring instance.
+ *
+ *  Transfer requests are queued in the submission ring and handed to the kernel in batches, so that many of them may
+ *  be outstanding at the same time; their outcome is later collected from the completion ring.
+ *  One should notice that this module does not stand alone: it supposes a very tight coupling with the raw disk
+ *  implementation, its only application, which owns the file descriptor of the storage device and falls back to
+ *  synchronous transfers whenever an io_uring instance can not be set up.
+ *
+ *  The following operations are defined:
+ *    \li set up an io_uring instance over an already opened file
+ *    \li tear down the io_uring instance
+ *    \li queue a transfer request in the submission ring
+ *    \li submit the queued requests and, optionally, wait for their completion
+ *    \li collect the outcome of a completed request.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_RAWURING_H_
+#define SOFS_RAWURING_H_
+
+#include <stdint.h>
+
+/**
+ *  \brief Set up an io_uring instance over an already opened file.
+ *
+ *  \param fd file descriptor of the Linux file that simulates the storage device
+ *  \param depth number of entries of the submission ring (rounded up by the kernel to a power of two)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if an instance is already set up
+ *  \return -\c ENOSYS, if io_uring is not supported by the host
+ *  \return -<em>other specific error</em> issued by \e io_uring_setup or \e mmap system calls
+ */
+
+extern int soUringOpen (int fd, uint32_t depth);
+
+/**
+ *  \brief Tear down the io_uring instance.
+ *
+ *  All requests still outstanding are waited for before the rings are unmapped; their outcome is lost.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if no instance is set up
+ */
+
+extern int soUringClose (void);
+
+/**
+ *  \brief Queue a transfer request in the submission ring.
+ *
+ *  The request is not seen by the kernel until the next call to soUringSubmit.
+ *
+ *  \param wr direction of the transfer: \c 0, read from the device; \c 1, write to the device
+ *  \param buf pointer to the buffer
+ *  \param len number of bytes to be transferred
+ *  \param off byte position on the device
+ *  \param tag value returned on completion to identify the request
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if no instance is set up
+ *  \return -\c EAGAIN, if the submission ring is full or too many requests are outstanding
+ */
+
+extern int soUringPrepare (int wr, void *buf, uint32_t len, uint64_t off, uint64_t tag);
+
+/**
+ *  \brief Submit the queued requests and wait for a minimum number of completions.
+ *
+ *  \param wait minimum number of completions that must be available on return
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if no instance is set up
+ *  \return -<em>other specific error</em> issued by \e io_uring_enter system call
+ */
+
+extern int soUringSubmit (uint32_t wait);
+
+/**
+ *  \brief Collect the outcome of a completed request.
+ *
+ *  \param p_tag pointer to a location where the tag of the request is to be stored
+ *  \param p_res pointer to a location where the result of the transfer (number of bytes, or a negative error) is to
+ *               be stored
+ *
+ *  \return <tt>1</tt>, if a completion was collected
+ *  \return <tt>0 (zero)</tt>, if no completion is available
+ *  \return -\c EBADF, if no instance is set up
+ */
+
+extern int soUringReap (uint64_t *p_tag, int *p_res);
+
+/**
+ *  \brief Get the number of requests which were queued but whose outcome has not been collected yet.
+ *
+ *  \return number of outstanding requests
+ */
+
+extern uint32_t soUringPending (void);
+
+#endif /* SOFS_RAWURING_H_ */
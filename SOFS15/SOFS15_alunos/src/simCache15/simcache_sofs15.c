@@ -0,0 +1,441 @@
+/**
+ *  \file simcache_sofs15.c (implementation file)
+ *
+ *  \brief The SOFS15 buffercache simulator.
+ *
+ *  It replays a trace of accesses to the buffercache, as recorded by the probing system, and compares the hit ratio of
+ *  the available replacement policies for one or more sizes of the storage area.
+ *  The buffercache is the one of the library, but the storage device is simulated: the raw disk operations are replaced
+ *  by functions which only count the transfers, so no supporting file is required and the flusher thread is disabled
+ *  to make the replay deterministic. The storage area is split in shards, each one replacing its own nodes, so the hit
+ *  ratio of a large storage area also depends on the number of shards.
+ *  A read access to the buffercache is a hit if it does not give rise to any transfer from the storage device other
+ *  than the read ahead of the clusters that follow; those are only accounted for in the number of blocks read.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                   simcache_sofs15 [OPTIONS] trace-file
+ *
+ *                OPTIONS:
+ *                 -n blocks   --- number of blocks of the simulated storage device (default: the highest block number
+ *                                 found in the trace plus one)
+ *                 -s blocks   --- number of blocks of the storage area (default: 100); it may be repeated
+ *                 -r clusters --- maximum number of clusters read ahead (default: 0, read-ahead disabled)
+ *                 -p shards   --- number of shards of the storage area (default: 8)
+ *                 -h          --- print this help.</PRE>
+ *
+ *  \remarks A trace is recorded by mounting the file system with options <tt>-l 811,820 -L trace-file</tt>: only the
+ *           lines issued by the probes of soReadCacheBlock, soWriteCacheBlock, soFlushCacheBlock, soSyncCacheBlock,
+ *           soReadCacheCluster, soWriteCacheCluster, soFlushCacheCluster and soSyncCacheCluster are replayed.
+ *           The number of blocks of the simulated storage device should be the one of the device where the trace was
+ *           recorded, since the storage area is organized in clusters aligned on its end.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+
+/** \brief maximum number of sizes of the storage area */
+#define MAX_SIZES  16
+
+/** \brief type of access: read a block */
+#define READ_BLOCK      0
+/** \brief type of access: write a block */
+#define WRITE_BLOCK     1
+/** \brief type of access: flush a block */
+#define FLUSH_BLOCK     2
+/** \brief type of access: synchronize a block */
+#define SYNC_BLOCK      3
+/** \brief type of access: read a cluster */
+#define READ_CLUSTER    4
+/** \brief type of access: write a cluster */
+#define WRITE_CLUSTER   5
+/** \brief type of access: flush a cluster */
+#define FLUSH_CLUSTER   6
+/** \brief type of access: synchronize a cluster */
+#define SYNC_CLUSTER    7
+
+/** \brief Definition of the access data type. */
+typedef struct access
+{
+   /** \brief type of access */
+    uint32_t op;
+   /** \brief physical number of the block, or of the first block of the cluster */
+    uint32_t n;
+} ACCESS;
+
+/** \brief names of the buffercache functions, by type of access, as they are printed by the probing system */
+static const char *opName[] = { "soReadCacheBlock(", "soWriteCacheBlock(", "soFlushCacheBlock(", "soSyncCacheBlock(",
+                                "soReadCacheCluster(", "soWriteCacheCluster(", "soFlushCacheCluster(",
+                                "soSyncCacheCluster(" };
+
+/*
+ *  Simulated storage device
+ */
+/** \brief Number of blocks of the simulated storage device */
+static uint32_t nBlocks = 0;
+/** \brief Number of read operations */
+static uint64_t nReadOps = 0;
+/** \brief Number of blocks read */
+static uint64_t nReadBlocks = 0;
+/** \brief Number of write operations */
+static uint64_t nWriteOps = 0;
+/** \brief Number of blocks written */
+static uint64_t nWriteBlocks = 0;
+
+/* Allusion to internal functions */
+
+static int loadTrace (const char *name, ACCESS **p_trace, uint32_t *p_count, uint32_t *p_nmax);
+static int replay (ACCESS *trace, uint32_t count, uint32_t type, uint64_t *p_reads, uint64_t *p_hits);
+static void printUsage (char *cmd_name);
+static void printError (int errcode, char *cmd_name);
+
+/* The main function */
+
+int main (int argc, char *argv[])
+{
+  uint32_t size[MAX_SIZES];                      /* sizes of the storage area */
+  uint32_t nSizes = 0;                           /* number of sizes of the storage area */
+  uint32_t window = 0;                           /* maximum number of clusters read ahead */
+  uint32_t shards = DEF_CACHE_SHARDS;            /* number of shards of the storage area */
+  int64_t val;                                   /* value of a numeric option */
+
+  /* process command line options */
+
+  int opt;                                       /* selected option */
+
+  do
+  { switch ((opt = getopt (argc, argv, "n:s:r:p:h")))
+    { case 'n': /* number of blocks of the simulated storage device */
+                if (((val = atoll (optarg)) <= 0) || (val > UINT32_MAX))
+                   { fprintf (stderr, "%s: Bad argument to n option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nBlocks = (uint32_t) val;
+                break;
+      case 's': /* number of blocks of the storage area */
+                if (((val = atoll (optarg)) <= 0) || (val > UINT32_MAX) || (nSizes == MAX_SIZES))
+                   { fprintf (stderr, "%s: Bad argument to s option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                size[nSizes++] = (uint32_t) val;
+                break;
+      case 'r': /* maximum number of clusters read ahead */
+                if (((val = atoll (optarg)) < 0) || (val > MAX_READ_AHEAD) || ((val == 0) && (*optarg != '0')))
+                   { fprintf (stderr, "%s: Bad argument to r option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                window = (uint32_t) val;
+                break;
+      case 'p': /* number of shards of the storage area */
+                if (((val = atoll (optarg)) <= 0) || (val > MAX_CACHE_SHARDS))
+                   { fprintf (stderr, "%s: Bad argument to p option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                shards = (uint32_t) val;
+                break;
+      case 'h': /* help mode */
+                printUsage (basename (argv[0]));
+                return EXIT_SUCCESS;
+      case -1:  break;
+      default:  fprintf (stderr, "%s: Wrong option.\n", basename (argv[0]));
+                printUsage (basename (argv[0]));
+                return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+  if ((argc - optind) != 1)                      /* check existence of mandatory argument: trace file name */
+     { fprintf (stderr, "%s: Wrong number of mandatory arguments.\n", basename (argv[0]));
+       printUsage (basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (nSizes == 0)
+     size[nSizes++] = DEF_CACHE_SIZE;
+  soSetBufferCacheReadAhead (window);
+  soSetBufferCacheShards (shards);
+
+  /* load the trace */
+
+  ACCESS *trace;                                 /* recorded accesses */
+  uint32_t count;                                /* number of recorded accesses */
+  uint32_t nmax;                                 /* highest block number found in the trace plus one */
+  int status;                                    /* status of operation */
+
+  if ((status = loadTrace (argv[optind], &trace, &count, &nmax)) != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (nBlocks == 0)
+     nBlocks = nmax;
+  if (nBlocks < nmax)
+     { fprintf (stderr, "%s: The trace refers to block %"PRIu32", beyond the storage device.\n",
+                basename (argv[0]), nmax - 1);
+       free (trace);
+       return EXIT_FAILURE;
+     }
+
+  /* replay the trace for every size of the storage area and every replacement policy */
+
+  static const uint32_t type[] = { BUF, BUF2Q }; /* types of buffered communication channel */
+  static const char *policy[] = { "LRU", "2Q" }; /* names of the replacement policies */
+  uint64_t reads, hits;                          /* number of read accesses and of hits */
+  uint32_t i, p;                                 /* counters */
+
+  printf ("%"PRIu32" accesses to a storage device of %"PRIu32" blocks\n", count, nBlocks);
+  printf ("%-6s %10s %12s %12s %9s %14s %14s\n", "policy", "blocks", "reads", "hits", "hit ratio", "blocks read",
+          "blocks written");
+  for (i = 0; i < nSizes; i++)
+    for (p = 0; p < 2; p++)
+    { if (((status = soSetBufferCacheSize (size[i])) != 0) ||
+          ((status = replay (trace, count, type[p], &reads, &hits)) != 0))
+         { printError (status, basename (argv[0]));
+           free (trace);
+           return EXIT_FAILURE;
+         }
+      printf ("%-6s %10"PRIu32" %12"PRIu64" %12"PRIu64" %8.2f%% %14"PRIu64" %14"PRIu64"\n", policy[p], size[i], reads,
+              hits, (reads == 0) ? 0.0 : (100.0 * hits) / reads, nReadBlocks, nWriteBlocks);
+    }
+  free (trace);
+
+  /* that's all */
+
+  return EXIT_SUCCESS;
+
+} /* end of main */
+
+/*
+ * load the accesses recorded in a trace file
+ */
+
+static int loadTrace (const char *name, ACCESS **p_trace, uint32_t *p_count, uint32_t *p_nmax)
+{
+  FILE *fs;                                      /* trace file stream */
+  char line[256];                                /* line of the trace */
+  char *p;                                       /* pointer to the name of the function */
+  ACCESS *trace = NULL, *tmp;                    /* recorded accesses */
+  uint32_t count = 0, max = 0;                   /* number of recorded accesses and size of the array */
+  uint32_t op, n, nlast;                         /* type of access, block number and last block number plus one */
+
+  if ((fs = fopen (name, "r")) == NULL)
+     return -errno;
+  *p_nmax = 0;
+  while (fgets (line, sizeof (line), fs) != NULL)
+  { for (op = READ_BLOCK; op <= SYNC_CLUSTER; op++)
+      if ((p = strstr (line, opName[op])) != NULL) break;
+    if ((op > SYNC_CLUSTER) || (sscanf (p + strlen (opName[op]), "%"SCNu32, &n) != 1))
+       continue;
+    if (count == max)
+       { max = (max == 0) ? 1024 : 2 * max;
+         if ((tmp = realloc (trace, (size_t) max * sizeof (ACCESS))) == NULL)
+            { free (trace);
+              fclose (fs);
+              return -ENOMEM;
+            }
+         trace = tmp;
+       }
+    trace[count].op = op;
+    trace[count].n = n;
+    count += 1;
+    nlast = n + ((op >= READ_CLUSTER) ? BLOCKS_PER_CLUSTER : 1);
+    if (nlast > *p_nmax)
+       *p_nmax = nlast;
+  }
+  fclose (fs);
+  *p_trace = trace;
+  *p_count = count;
+
+  return 0;
+}
+
+/*
+ * replay the recorded accesses for a given type of buffered communication channel
+ */
+
+static int replay (ACCESS *trace, uint32_t count, uint32_t type, uint64_t *p_reads, uint64_t *p_hits)
+{
+  unsigned char buffer[CLUSTER_SIZE];            /* buffer to store block/cluster contents */
+  uint64_t ops;                                  /* number of read operations before the access */
+  uint32_t i;                                    /* counter */
+  int status;                                    /* status of operation */
+
+  if (((status = soSetBufferCacheFlush (0, DEF_DIRTY_RATIO, DEF_DIRTY_LIMIT)) != 0) ||
+      ((status = soOpenBufferCache ("simulated storage device", type)) != 0))
+     return status;
+  memset (buffer, 0, CLUSTER_SIZE);
+  nReadOps = nReadBlocks = nWriteOps = nWriteBlocks = 0;
+  *p_reads = *p_hits = 0;
+  for (i = 0; i < count; i++)
+  { ops = nReadOps;
+    switch (trace[i].op)
+    { case READ_BLOCK:    status = soReadCacheBlock (trace[i].n, buffer);
+                          break;
+      case WRITE_BLOCK:   status = soWriteCacheBlock (trace[i].n, buffer);
+                          break;
+      case FLUSH_BLOCK:   status = soFlushCacheBlock (trace[i].n, buffer);
+                          break;
+      case SYNC_BLOCK:    status = soSyncCacheBlock (trace[i].n);
+                          break;
+      case READ_CLUSTER:  status = soReadCacheCluster (trace[i].n, buffer);
+                          break;
+      case WRITE_CLUSTER: status = soWriteCacheCluster (trace[i].n, buffer);
+                          break;
+      case FLUSH_CLUSTER: status = soFlushCacheCluster (trace[i].n, buffer);
+                          break;
+      default:            status = soSyncCacheCluster (trace[i].n);
+    }
+    if (status != 0)
+       { soCloseBufferCache ();
+         return status;
+       }
+    if ((trace[i].op == READ_BLOCK) || (trace[i].op == READ_CLUSTER))
+       { *p_reads += 1;
+         if (nReadOps == ops) *p_hits += 1;
+       }
+  }
+
+  return soCloseBufferCache ();
+}
+
+/*
+ * print help message
+ */
+
+static void printUsage (char *cmd_name)
+{
+  printf ("Sinopsis: %s [OPTIONS] trace-file\n"
+          "  OPTIONS:\n"
+          "  -n blocks   --- number of blocks of the simulated storage device (default: the highest block number\n"
+          "                  found in the trace plus one)\n"
+          "  -s blocks   --- number of blocks of the storage area (default: %d); it may be repeated\n"
+          "  -r clusters --- maximum number of clusters read ahead (default: 0, read-ahead disabled)\n"
+          "  -p shards   --- number of shards of the storage area (default: %d)\n"
+          "  -h          --- print this help\n", cmd_name, DEF_CACHE_SIZE, DEF_CACHE_SHARDS);
+}
+
+/*
+ * print error message
+ */
+
+static void printError (int errcode, char *cmd_name)
+{
+  fprintf(stderr, "%s: error #%d - %s.\n", cmd_name, -errcode, strerror (-errcode));
+}
+
+/*
+ *  Simulated storage device: the raw disk operations used by the buffercache only count the transfers
+ */
+
+int soOpenDevice (const char *devname, uint32_t *p_bnmax)
+{
+  if ((devname == NULL) || (p_bnmax == NULL)) return -EINVAL;
+  *p_bnmax = nBlocks;
+  return 0;
+}
+
+int soCloseDevice (void)
+{
+  return 0;
+}
+
+int soReadRawBlocks (uint32_t n, uint32_t count, void *buf)
+{
+  if (((uint64_t) n + count) > nBlocks) return -EINVAL;
+  memset (buf, 0, (size_t) count * BLOCK_SIZE);
+  nReadOps += 1;
+  nReadBlocks += count;
+  return 0;
+}
+
+int soWriteRawBlocks (uint32_t n, uint32_t count, void *buf)
+{
+  if (((uint64_t) n + count) > nBlocks) return -EINVAL;
+  nWriteOps += 1;
+  nWriteBlocks += count;
+  return 0;
+}
+
+int soReadRawBlock (uint32_t n, void *buf)
+{
+  return soReadRawBlocks (n, 1, buf);
+}
+
+int soWriteRawBlock (uint32_t n, void *buf)
+{
+  return soWriteRawBlocks (n, 1, buf);
+}
+
+int soReadRawCluster (uint32_t n, void *buf)
+{
+  return soReadRawBlocks (n, BLOCKS_PER_CLUSTER, buf);
+}
+
+int soWriteRawCluster (uint32_t n, void *buf)
+{
+  return soWriteRawBlocks (n, BLOCKS_PER_CLUSTER, buf);
+}
+
+int soReadRawClusterv (uint32_t count, const uint32_t *n, void * const *buf)
+{
+  uint32_t i;
+
+  for (i = 0; i < count; i++)
+  { if (((uint64_t) n[i] + BLOCKS_PER_CLUSTER) > nBlocks) return -EINVAL;
+    memset (buf[i], 0, CLUSTER_SIZE);
+  }
+  nReadBlocks += (uint64_t) count * BLOCKS_PER_CLUSTER;
+  return 0;
+}
+
+int soWriteRawBlockv (uint32_t count, const uint32_t *n, void * const *buf)
+{
+  uint32_t i;
+
+  for (i = 0; i < count; i++)
+  { if (n[i] >= nBlocks) return -EINVAL;
+    if ((i == 0) || (n[i] != n[i-1] + 1))
+       nWriteOps += 1;
+  }
+  nWriteBlocks += count;
+  return 0;
+}
+
+uint32_t soGetDeviceMode (void)
+{
+  return RAW_SYNC;
+}
+
+int soSubmitRawCluster (uint32_t op, uint32_t n, void *buf, uint64_t tag)
+{
+  return -ENOTSUP;
+}
+
+int soCompleteRaw (uint32_t min, SORawCompletion *cmp, uint32_t max)
+{
+  return 0;
+}
+
+int soSyncDevice (uint32_t n, uint32_t count)
+{
+  return 0;
+}
+
+int soGetRawStats (SORawStats *p_stats)
+{
+  if (p_stats == NULL) return -EINVAL;
+  memset (p_stats, 0, sizeof (SORawStats));
+  p_stats->nReads = nReadOps;
+  p_stats->nWrites = nWriteOps;
+  p_stats->bytesRead = nReadBlocks * BLOCK_SIZE;
+  p_stats->bytesWritten = nWriteBlocks * BLOCK_SIZE;
+  return 0;
+}
@@ -5,6 +5,21 @@
  *
  *
  *  The aim is to provide an unique storage location when the file system is in operation.
+ *  The storage location is the buffercache itself: the block or the cluster loaded is pinned in it and accessed in
+ *  place, so no copy is involved, and storing it back just marks it as changed. Loading another block or cluster of
+ *  the same kind unpins the previous one, except for the blocks of the table of inodes: the ones recently loaded are
+ *  kept pinned in a small set-associative cache, so that an operation on inodes stored in different blocks does not
+ *  go back to the buffercache each time it switches between them.
+ *  In the same way, the clusters of references to data clusters last used to translate indexes to the list of direct
+ *  references of the files recently accessed are kept pinned in a small cache of file maps, so that translating the
+ *  index of a data cluster of a large file is a memory lookup.
+ *  The quick consistency checks of the superblock, of the table of inodes and of the data zone may be run on every call,
+ *  once per generation of the superblock (that is, again only after it has been stored) or once when the file system
+ *  is mounted.
+ *  All this internal storage is kept in the SOFS context bound to the calling thread, so that file systems stored in
+ *  different devices can be operated on at the same time by threads working on different contexts. It is tied to the
+ *  generation of the buffercache it was loaded from: once the storage device is closed, or closed and opened again, it
+ *  is discarded, since the pins it holds went away with the storage area.
  *
  *  The operations are:
  *      \li load the contents of the superblock into internal storage
@@ -35,7 +50,12 @@
  *          storage
  *      \li get a pointer to the contents of a specific cluster of the table of direct references to data clusters
  *      \li store the contents of a specific cluster of the table of direct references to data clusters resident in
- *          internal storage to the storage device.
+ *          internal storage to the storage device
+ *      \li translate an index to the list of direct references of a file into the logical number of the data cluster
+ *          it refers to
+ *      \li remove a file from the cache of file maps
+ *      \li set the level of the quick consistency checks
+ *      \li run a quick consistency check according to the level set.
  *
  *  \author António Rui Borges - August 2010 - August 2012
  */
@@ -43,80 +63,157 @@
 #include <stdio.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include "sofs_probe.h"
 #include "sofs_const.h"
 #include "sofs_buffercache.h"
+#include "sofs_context.h"
 #include "sofs_superblock.h"
 #include "sofs_inode.h"
 #include "sofs_datacluster.h"
 #include "sofs_direntry.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_bitmap.h"
+
+/** \brief number of sets of the cache of blocks of the table of inodes (a block goes to set <tt>nBlk % INT_SETS</tt>) */
+#define INT_SETS  4
+/** \brief number of blocks of the table of inodes kept pinned in each set */
+#define INT_WAYS  2
+/** \brief number of files whose clusters of references to data clusters are kept pinned in the cache of file maps */
+#define FMAP_SLOTS  4
+/** \brief number of quick consistency checks whose results are kept */
+#define N_QCHECKS   (QC_DZ + 1)
 
 /*
  *  Internal data structure
  */
 
-/** \brief Storage area for superblock */
-static SOSuperBlock sb;
-/** \brief area validation: -1 - an error has occurred while reading or writing superblock data
- *                           0 - superblock data has not been read yet
- *                           1 - superblock data has already been read
- */
-static int sbLoaded = 0;
-/** \brief status of reading or writing superblock data */
-static int sbError = 0;
-
-/** \brief storage area for one block of the table of inodes */
-static SOInode inode[IPB];
-/** \brief validation area: -2 - an error occurred while reading or writing a data block
- *                          -1 - no block of the table of inodes has been read yet
- *                           * - logical block number of table of inodes that has been read
- */
-static int nBlkInTLoaded = -1;
-/** \brief status of reading or writing a data block of the table of inodes */
-static int intError = 0;
-
-/** \brief storage area for one block of the table of free data clusters */
-static uint32_t ref[RPB];
-/** \brief validation area: -2 - an error occurred while reading or writing a data block
- *                          -1 - no block of the table of free data clusters has been read yet
- *                           * - logical block number of table of free data clusters that has been read
- */
-static int nBlkFCTLoaded = -1;
-/** \brief status of reading or writing a data block of the table of free data clusters */
-static int fctError = 0;
-
-/** \brief storage area for a cluster of single indirect references to data clusters */
-static SODataClust sngIndRefClust;
-/** \brief validation area: -2 - an error occurred while reading or writing a data cluster
- *                          -1 - no cluster of single indirect references to data clusters has been read yet
- *                           * - physical cluster number of single indirect references to data clusters that has been
- *                               read
- */
-static int nClustSIRef = 0;
-/** \brief status of reading or writing a cluster of single indirect references to data clusters */
-static int sircError = 0;
-
-/** \brief storage area for a cluster of direct references to data clusters */
-static SODataClust dirRefClust;
-/** \brief validation area: -2 - an error occurred while reading or writing a data cluster
- *                          -1 - no cluster of direct references to data clusters has been read yet
- *                           * - physical cluster number of direct references to data clusters that has been read
- */
-static int nClustDRef = 0;
-/** \brief status of reading or writing a cluster of direct references to data clusters */
-static int drcError = 0;
+/** \brief State of the basic operations (one per SOFS context) */
+
+typedef struct
+{ /** \brief generation of the buffercache the internal storage was loaded from */
+    uint32_t cacheGen;
+
+  /** \brief Storage area for superblock (pinned in the buffercache) */
+    SOSuperBlock *sb;
+  /** \brief area validation: -1 - an error has occurred while reading or writing superblock data
+   *                           0 - superblock data has not been read yet
+   *                           1 - superblock data has already been read
+   */
+    int sbLoaded;
+  /** \brief status of reading or writing superblock data */
+    int sbError;
+  /** \brief generation of the superblock data: it is incremented each time the superblock is stored */
+    uint32_t sbGen;
+
+  /** \brief level of the quick consistency checks (QCHECK_ALWAYS, QCHECK_STORE or QCHECK_MOUNT) */
+    uint32_t qcLevel;
+  /** \brief generation of the superblock data at which each of the quick consistency checks was last passed
+   *         (<tt>0 (zero)</tt>, if it was not) */
+    uint32_t qcGen[N_QCHECKS];
+
+  /** \brief storage area for the block of the table of inodes last loaded (pinned in the buffercache) */
+    SOInode *inode;
+  /** \brief validation area: -2 - an error occurred while reading or writing a data block
+   *                          -1 - no block of the table of inodes has been read yet
+   *                           * - logical block number of table of inodes that has been read last
+   */
+    int nBlkInTLoaded;
+  /** \brief cache of the blocks of the table of inodes recently loaded, which are kept pinned in the buffercache:
+   *         logical block number, pointer to the contents (\c NULL, if the slot is not in use) and time of last use */
+    struct
+    { uint32_t nBlk;
+      SOInode *inode;
+      uint32_t lastUse;
+    } intSlot[INT_SETS][INT_WAYS];
+  /** \brief clock of the uses of the cache of blocks of the table of inodes */
+    uint32_t intClock;
+  /** \brief status of reading or writing a data block of the table of inodes */
+    int intError;
+
+  /** \brief storage area for one block of the table of free data clusters (pinned in the buffercache) */
+    uint32_t *ref;
+  /** \brief validation area: -2 - an error occurred while reading or writing a data block
+   *                          -1 - no block of the table of free data clusters has been read yet
+   *                           * - logical block number of table of free data clusters that has been read
+   */
+    int nBlkFCTLoaded;
+  /** \brief status of reading or writing a data block of the table of free data clusters */
+    int fctError;
+
+  /** \brief storage area for a cluster of single indirect references to data clusters (pinned in the buffercache) */
+    SODataClust *sngIndRefClust;
+  /** \brief validation area: -2 - an error occurred while reading or writing a data cluster
+   *                          -1 - no cluster of single indirect references to data clusters has been read yet
+   *                           * - physical cluster number of single indirect references to data clusters that has
+   *                               been read
+   */
+    int nClustSIRef;
+  /** \brief status of reading or writing a cluster of single indirect references to data clusters */
+    int sircError;
+
+  /** \brief storage area for a cluster of direct references to data clusters (pinned in the buffercache) */
+    SODataClust *dirRefClust;
+  /** \brief validation area: -2 - an error occurred while reading or writing a data cluster
+   *                          -1 - no cluster of direct references to data clusters has been read yet
+   *                           * - physical cluster number of direct references to data clusters that has been read
+   */
+    int nClustDRef;
+  /** \brief status of reading or writing a cluster of direct references to data clusters */
+    int drcError;
+
+  /** \brief cache of the file maps: for each of the files recently accessed, the clusters of references to data
+   *         clusters last used to translate an index to its list of direct references, which are kept pinned in the
+   *         buffercache: inode number, logical number and contents of the cluster of direct references pointed to by
+   *         \e i1, of the cluster of single indirect references pointed to by \e i2 and of the cluster of direct
+   *         references last reached through the latter (a \c NULL pointer, if the cluster is not pinned) and time of
+   *         last use */
+    struct
+    { uint32_t nInode;
+      uint32_t nClustI1;
+      SODataClust *i1Ref;
+      uint32_t nClustI2;
+      SODataClust *i2Ref;
+      uint32_t nClustDRef;
+      SODataClust *dRef;
+      uint32_t lastUse;
+    } fmapSlot[FMAP_SLOTS];
+  /** \brief clock of the uses of the cache of file maps */
+    uint32_t fmapClock;
+  /** \brief status of reading a cluster of references to data clusters into the cache of file maps */
+    int fmapError;
+} SOBasicOperState;
+
+/** \brief State of the basic operations in the default context */
+static SOBasicOperState defState;
+
+/** \brief State of the basic operations in the context bound to the calling thread */
+#define BO  ((SOBasicOperState *) CTX_STATE (CTX_BASICOPER))
+
+/* Allusion to internal functions */
+
+static int soCheckGeometry (SOSuperBlock *p_sb);
+static int soQCheckSuperBlockBmp (SOSuperBlock *p_sb);
+static int soPinFileMapClust (uint32_t nClust, uint32_t *p_nClust, SODataClust **p_ref);
+static int soReleaseFileMap (uint32_t s);
+static void soCheckCacheGen (void);
+static void soInitState (void *state);
 
 /**
  *  \brief Load the contents of the superblock into internal storage.
  *
  *  Any type of previous error on loading / storing the superblock data will disable the operation.
+ *  The geometry of a formatted storage device must be the one the file system was built with; a storage device
+ *  formatted before the geometry was recorded is taken as having the default geometry.
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading or writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
  *                       store operation
+ *  \return -\c EMEDIUMTYPE, if the storage device was formatted with another geometry
  *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
@@ -124,15 +221,23 @@ int soLoadSuperBlock (void)
 {
   soColorProbe (711, "07;31", "soLoadSuperBlock ()\n");
 
+  void *buf;                                     /* pointer to the pinned block */
   int stat;                                      /* status of operation */
 
-  if (sbError != 0) return sbError;              /* a previous error has occurred */
-  if (sbLoaded == 1) return 0;                   /* superblock has already been read */
-  stat = soReadCacheBlock (0, &sb);
+  soCheckCacheGen ();
+  if (BO->sbError != 0) return BO->sbError;      /* a previous error has occurred */
+  if (BO->sbLoaded == 1) return 0;               /* superblock has already been read */
+  stat = soGetCacheBlock (0, &buf);
+  if ((stat == 0) && !soCheckGeometry (buf))
+     { soPutCacheBlock (0);
+       stat = -EMEDIUMTYPE;
+     }
   if (stat == 0)
-     sbLoaded = 1;                               /* operation carried out with success */
-     else { sbLoaded = -1;
-            sbError = stat;                      /* an error has occurred while reading */
+     { BO->sb = buf;
+       BO->sbLoaded = 1;                         /* operation carried out with success */
+     }
+     else { BO->sbLoaded = -1;
+            BO->sbError = stat;                  /* an error has occurred while reading */
           }
 
   return stat;
@@ -152,8 +257,9 @@ SOSuperBlock *soGetSuperBlock (void)
 {
   soColorProbe (712, "07;31", "soGetSuperBlock ()\n");
 
-  if (sbLoaded == 1)
-     return &sb;
+  soCheckCacheGen ();
+  if (BO->sbLoaded == 1)
+     return BO->sb;
      else return NULL;
 }
 
@@ -176,17 +282,20 @@ int soStoreSuperBlock (void)
 
   int stat;                                      /* status of operation */
 
-  if (sbError != 0) return sbError;              /* a previous error has occurred */
-  if (sbLoaded == 0)
-     { sbLoaded = -1;
-       sbError = -ELIBBAD;                       /* superblock has not been read yet */
-       return sbError;
+  soCheckCacheGen ();
+  if (BO->sbError != 0) return BO->sbError;      /* a previous error has occurred */
+  if (BO->sbLoaded == 0)
+     { BO->sbLoaded = -1;
+       BO->sbError = -ELIBBAD;                   /* superblock has not been read yet */
+       return BO->sbError;
      }
-  stat = soWriteCacheBlock (0, &sb);
-  if (stat != 0)
-     { sbLoaded = -1;
-       sbError = stat;                           /* an error has occurred while writing */
+  stat = soMarkCacheBlock (0);
+  if (stat == 0)
+     { if (++BO->sbGen == 0) BO->sbGen = 1;      /* the quick consistency checks are to be run again */
      }
+     else { BO->sbLoaded = -1;
+            BO->sbError = stat;                  /* an error has occurred while writing */
+          }
 
   return stat;
 }
@@ -216,7 +325,7 @@ int soConvertRefInT (uint32_t nInode, uint32_t *p_nBlk, uint32_t *p_offset)
   int stat;                                      /* status of operation */
 
   if ((stat = soLoadSuperBlock ()) != 0) return stat;
-  if ((nInode >= sb.itotal) || (p_nBlk == NULL) || (p_offset == NULL))
+  if ((nInode >= BO->sb->itotal) || (p_nBlk == NULL) || (p_offset == NULL))
      return -EINVAL;
 
   *p_nBlk = nInode / IPB;
@@ -228,6 +337,9 @@ int soConvertRefInT (uint32_t nInode, uint32_t *p_nBlk, uint32_t *p_offset)
 /**
  *  \brief Load the contents of a specific block of the table of inodes into internal storage.
  *
+ *  The blocks recently loaded are kept pinned in a small set-associative cache, so going back and forth between the
+ *  blocks of a few inodes does not involve the buffercache. When a set is full, its least recently used block is
+ *  unpinned to make room for the new one.
  *  Any type of previous / current error on loading / storing the data block will disable the operation.
  *
  *  \param nBlk logical number of the block to be read
@@ -245,18 +357,47 @@ int soLoadBlockInT (uint32_t nBlk)
 {
   soColorProbe (715, "07;31", "soLoadBlockInT (%"PRIu32")\n", nBlk);
 
+  void *buf;                                     /* pointer to the pinned block */
+  uint32_t set = nBlk % INT_SETS;                /* set of the block */
+  uint32_t w, v;                                 /* way counter and way of the slot to be used */
   int stat;                                      /* status of operation */
 
   if ((stat = soLoadSuperBlock ()) != 0) return stat;
-  if (nBlk >= sb.itable_size) return -EINVAL;
-
-  if (intError != 0) return intError;            /* a previous error has occurred */
-  if (nBlk == nBlkInTLoaded) return 0;           /* the block has already been read */
-  stat = soReadCacheBlock (sb.itable_start + nBlk, inode);
+  if (nBlk >= BO->sb->itable_size) return -EINVAL;
+
+  if (BO->intError != 0) return BO->intError;    /* a previous error has occurred */
+  if (nBlk == BO->nBlkInTLoaded) return 0;       /* the block has already been read */
+
+  /* look the block up in its set; otherwise, select a free slot or the least recently used one */
+
+  for (w = 0, v = 0; w < INT_WAYS; w++)
+  { if ((BO->intSlot[set][w].inode != NULL) && (BO->intSlot[set][w].nBlk == nBlk))
+       { BO->intSlot[set][w].lastUse = ++BO->intClock;
+         BO->inode = BO->intSlot[set][w].inode;
+         BO->nBlkInTLoaded = nBlk;               /* the block is still pinned */
+         return 0;
+       }
+    if ((BO->intSlot[set][v].inode != NULL) &&
+        ((BO->intSlot[set][w].inode == NULL) || (BO->intSlot[set][w].lastUse < BO->intSlot[set][v].lastUse)))
+       v = w;
+  }
+  if ((BO->intSlot[set][v].inode != NULL) &&
+      ((stat = soPutCacheBlock (BO->sb->itable_start + BO->intSlot[set][v].nBlk)) != 0))
+     { BO->nBlkInTLoaded = -2;
+       BO->intError = stat;                      /* an error has occurred while releasing the previous block */
+       return stat;
+     }
+  BO->intSlot[set][v].inode = NULL;
+  stat = soGetCacheBlock (BO->sb->itable_start + nBlk, &buf);
   if (stat == 0)
-     nBlkInTLoaded = nBlk;                       /* operation carried out with success */
-     else { nBlkInTLoaded = -1;
-            intError = stat;                     /* an error has occurred while reading */
+     { BO->intSlot[set][v].nBlk = nBlk;
+       BO->intSlot[set][v].inode = buf;
+       BO->intSlot[set][v].lastUse = ++BO->intClock;
+       BO->inode = buf;
+       BO->nBlkInTLoaded = nBlk;                 /* operation carried out with success */
+     }
+     else { BO->nBlkInTLoaded = -1;
+            BO->intError = stat;                 /* an error has occurred while reading */
           }
 
   return stat;
@@ -276,8 +417,9 @@ SOInode *soGetBlockInT (void)
 {
   soColorProbe (716, "07;31", "soGetBlockInT ()\n");
 
-  if (nBlkInTLoaded >= 0)
-     return inode;
+  soCheckCacheGen ();
+  if (BO->nBlkInTLoaded >= 0)
+     return BO->inode;
      else return NULL;
 }
 
@@ -299,17 +441,18 @@ int soStoreBlockInT (void)
 
   int stat;                                      /* status of operation */
 
-  if (intError != 0) return intError;            /* a previous error has occurred */
-  if (nBlkInTLoaded < 0)
-     { nBlkInTLoaded = -2;
-       intError = -ELIBBAD;                      /* no block of the bitmap table of inodes has not been
+  soCheckCacheGen ();
+  if (BO->intError != 0) return BO->intError;    /* a previous error has occurred */
+  if (BO->nBlkInTLoaded < 0)
+     { BO->nBlkInTLoaded = -2;
+       BO->intError = -ELIBBAD;                  /* no block of the bitmap table of inodes has not been
                                                     read yet */
-       return intError;
+       return BO->intError;
      }
-  stat = soWriteCacheBlock (sb.itable_start + nBlkInTLoaded, inode);
+  stat = soMarkCacheBlock (BO->sb->itable_start + BO->nBlkInTLoaded);
   if (stat != 0)
-     { nBlkInTLoaded = -2;
-       intError = stat;                          /* an error has occurred while writing */
+     { BO->nBlkInTLoaded = -2;
+       BO->intError = stat;                      /* an error has occurred while writing */
      }
 
   return stat;
@@ -340,7 +483,7 @@ int soConvertRefFCT (uint32_t ind, uint32_t *p_nBlk, uint32_t *p_offset)
   int stat;                                      /* status of operation */
 
   if ((stat = soLoadSuperBlock ()) != 0) return stat;
-  if ((ind >= sb.dzone_total) || (p_nBlk == NULL) || (p_offset == NULL))
+  if ((ind >= BO->sb->dzone_total) || (p_nBlk == NULL) || (p_offset == NULL))
      return -EINVAL;
 
   *p_nBlk = ind / RPB;
@@ -369,18 +512,26 @@ int soLoadBlockFCT (uint32_t nBlk)
 {
   soColorProbe (719, "07;31", "soLoadBlockFCT (%"PRIu32")\n", nBlk);
 
+  void *buf;                                     /* pointer to the pinned block */
   int stat;                                      /* status of operation */
 
   if ((stat = soLoadSuperBlock ()) != 0) return stat;
-  if (nBlk >= sb.dzone_total) return -EINVAL;
-
-  if (fctError != 0) return fctError;            /* a previous error has occurred */
-  if (nBlk == nBlkFCTLoaded) return 0;           /* the block has already been read */
-  stat = soReadCacheBlock (sb.tbfreeclust_start + nBlk, ref);
+  if (nBlk >= BO->sb->dzone_total) return -EINVAL;
+
+  if (BO->fctError != 0) return BO->fctError;    /* a previous error has occurred */
+  if (nBlk == BO->nBlkFCTLoaded) return 0;       /* the block has already been read */
+  if ((BO->nBlkFCTLoaded >= 0) && ((stat = soPutCacheBlock (BO->sb->tbfreeclust_start + BO->nBlkFCTLoaded)) != 0))
+     { BO->nBlkFCTLoaded = -2;
+       BO->fctError = stat;                      /* an error has occurred while releasing the previous block */
+       return stat;
+     }
+  stat = soGetCacheBlock (BO->sb->tbfreeclust_start + nBlk, &buf);
   if (stat == 0)
-     nBlkFCTLoaded = nBlk;                       /* operation carried out with success */
-     else { nBlkFCTLoaded = -1;
-            fctError = stat;                     /* an error has occurred while reading */
+     { BO->ref = buf;
+       BO->nBlkFCTLoaded = nBlk;                 /* operation carried out with success */
+     }
+     else { BO->nBlkFCTLoaded = -1;
+            BO->fctError = stat;                 /* an error has occurred while reading */
           }
 
   return stat;
@@ -400,8 +551,9 @@ uint32_t *soGetBlockFCT (void)
 {
   soColorProbe (720, "07;31", "soGetBlockFCT ()\n");
 
-  if (nBlkFCTLoaded >= 0)
-     return ref;
+  soCheckCacheGen ();
+  if (BO->nBlkFCTLoaded >= 0)
+     return BO->ref;
      else return NULL;
 }
 
@@ -424,17 +576,18 @@ int soStoreBlockFCT (void)
 
   int stat;                                      /* status of operation */
 
-  if (fctError != 0) return fctError;            /* a previous error has occurred */
-  if (nBlkFCTLoaded < 0)
-     { nBlkFCTLoaded = -2;
-       fctError = -ELIBBAD;                      /* no block of the bitmap table of inodes has not been
+  soCheckCacheGen ();
+  if (BO->fctError != 0) return BO->fctError;    /* a previous error has occurred */
+  if (BO->nBlkFCTLoaded < 0)
+     { BO->nBlkFCTLoaded = -2;
+       BO->fctError = -ELIBBAD;                  /* no block of the bitmap table of inodes has not been
                                                     read yet */
-       return fctError;
+       return BO->fctError;
      }
-  stat = soWriteCacheBlock (sb.tbfreeclust_start + nBlkFCTLoaded, ref);
+  stat = soMarkCacheBlock (BO->sb->tbfreeclust_start + BO->nBlkFCTLoaded);
   if (stat != 0)
-     { nBlkFCTLoaded = -2;
-       fctError = stat;                          /* an error has occurred while writing */
+     { BO->nBlkFCTLoaded = -2;
+       BO->fctError = stat;                      /* an error has occurred while writing */
      }
 
   return stat;
@@ -494,20 +647,28 @@ int soLoadSngIndRefClust (uint32_t nClust)
 {
   soColorProbe (723, "07;31", "soLoadSngIndRefClust (%"PRIu32")\n", nClust);
 
+  void *buf;                                     /* pointer to the pinned cluster */
   int stat;                                      /* status of operation */
 
   if ((stat = soLoadSuperBlock ()) != 0) return stat;
-  if ((nClust < sb.dzone_start) || (((nClust - sb.dzone_start) % BLOCKS_PER_CLUSTER) != 0) ||
-      (nClust >= (sb.dzone_start + sb.dzone_total * BLOCKS_PER_CLUSTER)))
+  if ((nClust < BO->sb->dzone_start) || (((nClust - BO->sb->dzone_start) % BLOCKS_PER_CLUSTER) != 0) ||
+      (nClust >= (BO->sb->dzone_start + BO->sb->dzone_total * BLOCKS_PER_CLUSTER)))
      return -EINVAL;
 
-  if (sircError != 0) return sircError;          /* a previous error has occurred */
-  if (nClust == nClustSIRef) return 0;           /* the cluster has already been read */
-  stat = soReadCacheCluster (nClust, &sngIndRefClust);
+  if (BO->sircError != 0) return BO->sircError;  /* a previous error has occurred */
+  if (nClust == BO->nClustSIRef) return 0;       /* the cluster has already been read */
+  if ((BO->nClustSIRef >= 0) && ((stat = soPutCacheCluster (BO->nClustSIRef)) != 0))
+     { BO->nClustSIRef = -2;
+       BO->sircError = stat;                     /* an error has occurred while releasing the previous cluster */
+       return stat;
+     }
+  stat = soGetCacheCluster (nClust, &buf);
   if (stat == 0)
-     nClustSIRef = nClust;                       /* operation carried out with success */
-     else { nClustSIRef = -2;
-            sircError = stat;                    /* an error has occurred while reading */
+     { BO->sngIndRefClust = buf;
+       BO->nClustSIRef = nClust;                 /* operation carried out with success */
+     }
+     else { BO->nClustSIRef = -2;
+            BO->sircError = stat;                /* an error has occurred while reading */
           }
 
   return stat;
@@ -529,8 +690,9 @@ SODataClust *soGetSngIndRefClust (void)
 {
   soColorProbe (724, "07;31", "soGetSngIndRefClust ()\n");
 
-  if (nClustSIRef >= 0)
-     return &sngIndRefClust;
+  soCheckCacheGen ();
+  if (BO->nClustSIRef >= 0)
+     return BO->sngIndRefClust;
      else return NULL;
 }
 
@@ -555,17 +717,18 @@ int soStoreSngIndRefClust (void)
 
   int stat;                                      /* status of operation */
 
-  if (sircError != 0) return sircError;          /* a previous error has occurred */
-  if (nClustSIRef < 0)
-     { nClustSIRef = -2;
-       sircError = -ELIBBAD;                     /* no cluster of the table of single indirect references has not been
+  soCheckCacheGen ();
+  if (BO->sircError != 0) return BO->sircError;  /* a previous error has occurred */
+  if (BO->nClustSIRef < 0)
+     { BO->nClustSIRef = -2;
+       BO->sircError = -ELIBBAD;                 /* no cluster of the table of single indirect references has not been
                                                     read yet */
-       return sircError;
+       return BO->sircError;
      }
-  stat = soWriteCacheCluster (nClustSIRef, &sngIndRefClust);
+  stat = soMarkCacheCluster (BO->nClustSIRef);
   if (stat != 0)
-     { nClustSIRef = -2;
-       sircError = stat;                          /* an error has occurred while writing */
+     { BO->nClustSIRef = -2;
+       BO->sircError = stat;                      /* an error has occurred while writing */
      }
 
   return stat;
@@ -593,20 +756,28 @@ int soLoadDirRefClust (uint32_t nClust)
 {
   soColorProbe (726, "07;31", "soLoadDirRefClust (%"PRIu32")\n", nClust);
 
+  void *buf;                                     /* pointer to the pinned cluster */
   int stat;                                      /* status of operation */
 
   if ((stat = soLoadSuperBlock ()) != 0) return stat;
-  if ((nClust < sb.dzone_start) || (((nClust - sb.dzone_start) % BLOCKS_PER_CLUSTER) != 0) ||
-      (nClust >= (sb.dzone_start + sb.dzone_total * BLOCKS_PER_CLUSTER)))
+  if ((nClust < BO->sb->dzone_start) || (((nClust - BO->sb->dzone_start) % BLOCKS_PER_CLUSTER) != 0) ||
+      (nClust >= (BO->sb->dzone_start + BO->sb->dzone_total * BLOCKS_PER_CLUSTER)))
      return -EINVAL;
 
-  if (drcError != 0) return drcError;            /* a previous error has occurred */
-  if (nClust == nClustDRef) return 0;            /* the cluster has already been read */
-  stat = soReadCacheCluster (nClust, &dirRefClust);
+  if (BO->drcError != 0) return BO->drcError;    /* a previous error has occurred */
+  if (nClust == BO->nClustDRef) return 0;        /* the cluster has already been read */
+  if ((BO->nClustDRef >= 0) && ((stat = soPutCacheCluster (BO->nClustDRef)) != 0))
+     { BO->nClustDRef = -2;
+       BO->drcError = stat;                      /* an error has occurred while releasing the previous cluster */
+       return stat;
+     }
+  stat = soGetCacheCluster (nClust, &buf);
   if (stat == 0)
-	  nClustDRef = nClust;                       /* operation carried out with success */
-     else { nClustDRef = -2;
-            drcError = stat;                     /* an error has occurred while reading */
+     { BO->dirRefClust = buf;
+       BO->nClustDRef = nClust;                  /* operation carried out with success */
+     }
+     else { BO->nClustDRef = -2;
+            BO->drcError = stat;                 /* an error has occurred while reading */
           }
 
   return stat;
@@ -627,8 +798,9 @@ SODataClust *soGetDirRefClust (void)
 {
   soColorProbe (727, "07;31", "soGetDirRefClust ()\n");
 
-  if (nClustDRef >= 0)
-     return &dirRefClust;
+  soCheckCacheGen ();
+  if (BO->nClustDRef >= 0)
+     return BO->dirRefClust;
      else return NULL;
 }
 
@@ -653,18 +825,379 @@ int soStoreDirRefClust (void)
 
   int stat;                                      /* status of operation */
 
-  if (drcError != 0) return drcError;            /* a previous error has occurred */
-  if (nClustDRef < 0)
-     { nClustDRef = -2;
-       drcError = -ELIBBAD;                      /* no cluster of the table of direct references has not been
+  soCheckCacheGen ();
+  if (BO->drcError != 0) return BO->drcError;    /* a previous error has occurred */
+  if (BO->nClustDRef < 0)
+     { BO->nClustDRef = -2;
+       BO->drcError = -ELIBBAD;                  /* no cluster of the table of direct references has not been
                                                     read yet */
-       return sircError;
+       return BO->sircError;
      }
-  stat = soWriteCacheCluster (nClustDRef, &dirRefClust);
+  stat = soMarkCacheCluster (BO->nClustDRef);
   if (stat != 0)
-     { nClustDRef = -2;
-       drcError = stat;                          /* an error has occurred while writing */
+     { BO->nClustDRef = -2;
+       BO->drcError = stat;                      /* an error has occurred while writing */
+     }
+
+  return stat;
+}
+
+/**
+ *  \brief Translate an index to the list of direct references of a file into the logical number of the data cluster it
+ *         refers to.
+ *
+ *  The clusters of references to data clusters which are used are kept pinned in the cache of file maps, so that
+ *  translating another index of the same file, while they remain the ones referred by the inode, is just a memory
+ *  lookup. Their contents are accessed in place, so any change made to them afterwards is seen at once.
+ *
+ *  Any type of previous / current error on reading a cluster of references will disable the operation.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to the contents of the inode associated to the file
+ *  \param clustInd index to the list of direct references
+ *  \param p_outVal pointer to the location where the logical number of the data cluster is to be stored
+ *                  (\c NULL_CLUSTER, if there is none)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the inode number or the index to the list of direct references are out of range, any of the
+ *                      pointers is \c NULL or a reference to a cluster of references is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soMapFileCluster (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t *p_outVal)
+{
+  soColorProbe (729, "07;31", "soMapFileCluster (%"PRIu32", %p, %"PRIu32", %p)\n", nInode, p_inode, clustInd, p_outVal);
+
+  uint32_t s, v;                                 /* slot counter and slot to be used */
+  uint32_t ind;                                  /* index to the cluster of single indirect references */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if ((nInode >= BO->sb->itotal) || (p_inode == NULL) || (clustInd >= MAX_FILE_CLUSTERS) || (p_outVal == NULL))
+     return -EINVAL;
+
+  if (BO->fmapError != 0) return BO->fmapError;  /* a previous error has occurred */
+  if (clustInd < N_DIRECT)
+     { *p_outVal = p_inode->d[clustInd];
+       return 0;
+     }
+
+  /* look the file up; otherwise, select the least recently used slot */
+
+  for (s = 0, v = 0; s < FMAP_SLOTS; s++)
+  { if ((BO->fmapSlot[s].lastUse != 0) && (BO->fmapSlot[s].nInode == nInode))
+       break;
+    if (BO->fmapSlot[s].lastUse < BO->fmapSlot[v].lastUse)
+       v = s;
+  }
+  if (s == FMAP_SLOTS)
+     { if ((stat = soReleaseFileMap (v)) != 0) return stat;
+       BO->fmapSlot[v].nInode = nInode;
+       s = v;
+     }
+  BO->fmapSlot[s].lastUse = ++BO->fmapClock;
+
+  if (clustInd < N_DIRECT + RPC)                 /* single indirect reference */
+     { if (p_inode->i1 == NULL_CLUSTER)
+          { *p_outVal = NULL_CLUSTER;
+            return 0;
+          }
+       if ((BO->fmapSlot[s].i1Ref == NULL) || (BO->fmapSlot[s].nClustI1 != p_inode->i1))
+          if ((stat = soPinFileMapClust (p_inode->i1, &BO->fmapSlot[s].nClustI1, &BO->fmapSlot[s].i1Ref)) != 0)
+             return stat;
+       *p_outVal = BO->fmapSlot[s].i1Ref->ref[clustInd - N_DIRECT];
+       return 0;
+     }
+
+  /* double indirect reference */
+
+  if (p_inode->i2 == NULL_CLUSTER)
+     { *p_outVal = NULL_CLUSTER;
+       return 0;
+     }
+  if ((BO->fmapSlot[s].i2Ref == NULL) || (BO->fmapSlot[s].nClustI2 != p_inode->i2))
+     if ((stat = soPinFileMapClust (p_inode->i2, &BO->fmapSlot[s].nClustI2, &BO->fmapSlot[s].i2Ref)) != 0)
+        return stat;
+  ind = (clustInd - N_DIRECT - RPC) / RPC;
+  if (BO->fmapSlot[s].i2Ref->ref[ind] == NULL_CLUSTER)
+     { *p_outVal = NULL_CLUSTER;
+       return 0;
+     }
+  if ((BO->fmapSlot[s].dRef == NULL) || (BO->fmapSlot[s].nClustDRef != BO->fmapSlot[s].i2Ref->ref[ind]))
+     if ((stat = soPinFileMapClust (BO->fmapSlot[s].i2Ref->ref[ind], &BO->fmapSlot[s].nClustDRef,
+                                    &BO->fmapSlot[s].dRef)) != 0)
+        return stat;
+  *p_outVal = BO->fmapSlot[s].dRef->ref[(clustInd - N_DIRECT - RPC) % RPC];
+
+  return 0;
+}
+
+/**
+ *  \brief Remove a file from the cache of file maps.
+ *
+ *  The clusters of references to data clusters kept pinned for it are released. It must be called before the list of
+ *  references of the inode associated to the file is changed, so that no cluster which is freed remains pinned.
+ *
+ *  Any type of previous / current error on reading a cluster of references will disable the operation.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soForgetFileMap (uint32_t nInode)
+{
+  soColorProbe (730, "07;31", "soForgetFileMap (%"PRIu32")\n", nInode);
+
+  uint32_t s;                                    /* slot counter */
+
+  soCheckCacheGen ();
+  if (BO->fmapError != 0) return BO->fmapError;  /* a previous error has occurred */
+  for (s = 0; s < FMAP_SLOTS; s++)
+    if ((BO->fmapSlot[s].lastUse != 0) && (BO->fmapSlot[s].nInode == nInode))
+       return soReleaseFileMap (s);
+
+  return 0;
+}
+
+/**
+ *  \brief Set the level of the quick consistency checks.
+ *
+ *  The quick consistency checks of the superblock, of the table of inodes and of the data zone may be run
+ *
+ *    \li QCHECK_ALWAYS: on every call (default)
+ *    \li QCHECK_STORE:  once per generation of the superblock, that is, again only after it has been stored
+ *    \li QCHECK_MOUNT:  only once, when the file system is mounted.
+ *
+ *  \param level level of the quick consistency checks
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the level is not one of the above
+ */
+
+int soSetQCheckLevel (uint32_t level)
+{
+  soColorProbe (731, "07;31", "soSetQCheckLevel (%"PRIu32")\n", level);
+
+  if (level > QCHECK_MOUNT) return -EINVAL;
+  BO->qcLevel = level;
+
+  return 0;
+}
+
+/**
+ *  \brief Run a quick consistency check according to the level set.
+ *
+ *  The check is skipped if it was already passed and the level set does not require it to be run again.
+ *  If the free data clusters are tracked by a bitmap, the data zone is checked by soQCheckBitmap.
+ *
+ *  \param check quick consistency check to be run (QC_SUPERBLOCK, QC_INT or QC_DZ)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the check is not one of the above
+ *  \return -<em>error</em> issued by the quick consistency check, if it fails
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soQCheck (uint32_t check)
+{
+  soColorProbe (732, "07;31", "soQCheck (%"PRIu32")\n", check);
+
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if (check >= N_QCHECKS) return -EINVAL;
+
+  if ((BO->qcGen[check] != 0) &&
+      ((BO->qcLevel == QCHECK_MOUNT) || ((BO->qcLevel == QCHECK_STORE) && (BO->qcGen[check] == BO->sbGen))))
+     return 0;                                   /* the check was already passed */
+  switch (check)
+  { case QC_SUPERBLOCK:
+      stat = (BO->sb->fcformat == FC_BITMAP) ? soQCheckSuperBlockBmp (BO->sb) : soQCheckSuperBlock (BO->sb);
+      break;
+    case QC_INT:
+      stat = soQCheckInT (BO->sb);
+      break;
+    default:
+      stat = (BO->sb->fcformat == FC_BITMAP) ? soQCheckBitmap (BO->sb) : soQCheckDZ (BO->sb);
+  }
+  BO->qcGen[check] = (stat == 0) ? BO->sbGen : 0;
+
+  return stat;
+}
+
+/**
+ *  \brief Check the geometry of the storage device.
+ *
+ *  Only a formatted storage device is checked: while it is being formatted, the magic number is not yet the right one.
+ *
+ *  \param p_sb pointer to the superblock
+ *
+ *  \return \c 1, if the geometry recorded in the superblock is the one the file system was built with
+ *  \return <tt>0 (zero)</tt>, otherwise
+ */
+
+static int soCheckGeometry (SOSuperBlock *p_sb)
+{
+  if (p_sb->magic != MAGIC_NUMBER)
+     return 1;
+  if (p_sb->bsize == NO_GEOMETRY)
+     return (BLOCK_SIZE == DEF_BLOCK_SIZE) && (BLOCKS_PER_CLUSTER == DEF_BLOCKS_PER_CLUSTER);
+
+  return (p_sb->bsize == BLOCK_SIZE) && (p_sb->bpc == BLOCKS_PER_CLUSTER);
+}
+
+/**
+ *  \brief Quick check of the superblock of a file system whose free data clusters are tracked by a bitmap.
+ *
+ *  The header, the layout of the storage device and the table of inodes are checked as soQCheckSuperBlock does, but
+ *  the data zone is checked by soQCheckBitmap, instead of soQCheckDZ.
+ *
+ *  \param p_sb pointer to the superblock
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ESBHINVAL, if the header data or the layout of the storage device is inconsistent
+ *  \return -<em>error</em> issued by soQCheckInT or soQCheckBitmap, if they fail
+ */
+
+static int soQCheckSuperBlockBmp (SOSuperBlock *p_sb)
+{
+  int stat;                                      /* status of operation */
+
+  if ((p_sb->magic != MAGIC_NUMBER) || (p_sb->version != VERSION_NUMBER) ||
+      (strnlen ((char *) p_sb->name, PARTITION_NAME_SIZE + 1) > PARTITION_NAME_SIZE) ||
+      ((p_sb->mstat != PRU) && (p_sb->mstat != NPRU)))
+     return -ESBHINVAL;
+  if ((p_sb->ntotal != 1 + p_sb->itable_size + p_sb->tbfreeclust_size + p_sb->dzone_total * BLOCKS_PER_CLUSTER) ||
+      (p_sb->itable_start != 1) || (p_sb->tbfreeclust_start != p_sb->itable_start + p_sb->itable_size) ||
+      (p_sb->dzone_start != p_sb->tbfreeclust_start + p_sb->tbfreeclust_size))
+     return -ESBHINVAL;
+  if ((stat = soQCheckInT (p_sb)) != 0) return stat;
+
+  return soQCheckBitmap (p_sb);
+}
+
+/**
+ *  \brief Pin a cluster of references to data clusters in a slot of the cache of file maps.
+ *
+ *  The cluster previously pinned in the same place, if any, is released.
+ *
+ *  \param nClust logical number of the cluster to be pinned
+ *  \param p_nClust pointer to the location where the logical number of the pinned cluster is stored
+ *  \param p_ref pointer to the location where the pointer to the contents of the pinned cluster is stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if logical cluster number is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+static int soPinFileMapClust (uint32_t nClust, uint32_t *p_nClust, SODataClust **p_ref)
+{
+  void *buf;                                     /* pointer to the pinned cluster */
+  int stat;                                      /* status of operation */
+
+  if (nClust >= BO->sb->dzone_total) return -EINVAL;
+
+  if ((*p_ref != NULL) && ((stat = soPutCacheCluster (BO->sb->dzone_start + BLOCKS_PER_CLUSTER * (*p_nClust))) != 0))
+     { *p_ref = NULL;
+       BO->fmapError = stat;                     /* an error has occurred while releasing the previous cluster */
+       return stat;
      }
+  *p_ref = NULL;
+  stat = soGetCacheCluster (BO->sb->dzone_start + BLOCKS_PER_CLUSTER * nClust, &buf);
+  if (stat == 0)
+     { *p_nClust = nClust;
+       *p_ref = buf;                             /* operation carried out with success */
+     }
+     else BO->fmapError = stat;                  /* an error has occurred while reading */
 
   return stat;
 }
+
+/**
+ *  \brief Release the clusters of references to data clusters pinned in a slot of the cache of file maps.
+ *
+ *  \param s slot to be released
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soReleaseFileMap (uint32_t s)
+{
+  uint32_t *nClust[3] = { &BO->fmapSlot[s].nClustI1, &BO->fmapSlot[s].nClustI2, &BO->fmapSlot[s].nClustDRef };
+  SODataClust **clust[3] = { &BO->fmapSlot[s].i1Ref, &BO->fmapSlot[s].i2Ref, &BO->fmapSlot[s].dRef };
+  uint32_t k;                                    /* counter */
+  int stat = 0;                                  /* status of operation */
+
+  for (k = 0; k < 3; k++)
+  { if ((*clust[k] != NULL) && (stat == 0))
+       stat = soPutCacheCluster (BO->sb->dzone_start + BLOCKS_PER_CLUSTER * (*nClust[k]));
+    *clust[k] = NULL;
+  }
+  BO->fmapSlot[s].lastUse = 0;
+  if (stat != 0)
+     BO->fmapError = stat;                       /* an error has occurred while releasing a cluster */
+
+  return stat;
+}
+
+/**
+ *  \brief Discard the internal storage if the buffercache it was loaded from was closed in the meantime.
+ *
+ *  The pins it held went away with the storage area, so they are just forgotten. The level of the quick consistency
+ *  checks is kept.
+ */
+
+static void soCheckCacheGen (void)
+{
+  uint32_t gen = soGetBufferCacheGen ();         /* present generation of the buffercache */
+  uint32_t level = BO->qcLevel;                  /* level of the quick consistency checks */
+
+  if (BO->cacheGen == gen) return;
+  soInitState (BO);
+  BO->qcLevel = level;
+  BO->cacheGen = gen;
+}
+
+/**
+ *  \brief Set up the state of the basic operations in a context.
+ *
+ *  \param state pointer to the state
+ */
+
+static void soInitState (void *state)
+{
+  SOBasicOperState *bo = state;                  /* pointer to the state */
+
+  memset (bo, 0, sizeof (SOBasicOperState));
+  bo->sbGen = 1;
+  bo->qcLevel = QCHECK_ALWAYS;
+  bo->nBlkInTLoaded = -1;
+  bo->nBlkFCTLoaded = -1;
+  bo->nClustSIRef = -1;
+  bo->nClustDRef = -1;
+}
+
+/**
+ *  \brief Register the state of the basic operations, before <tt>main</tt> is called.
+ */
+
+static void __attribute__ ((constructor)) soRegisterState (void)
+{
+  soRegisterContextState (CTX_BASICOPER, sizeof (SOBasicOperState), soInitState, &defState);
+}
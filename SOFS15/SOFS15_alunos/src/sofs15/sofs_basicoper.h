@@ -35,7 +35,12 @@
  *          storage
  *      \li get a pointer to the contents of a specific cluster of the table of direct references to data clusters
  *      \li store the contents of a specific cluster of the table of direct references to data clusters resident in
- *          internal storage to the storage device.
+ *          internal storage to the storage device
+ *      \li translate an index to the list of direct references of a file into the logical number of the data cluster
+ *          it refers to
+ *      \li remove a file from the cache of file maps
+ *      \li set the level of the quick consistency checks
+ *      \li run a quick consistency check according to the level set.
  *
  *  \author António Rui Borges - August 2010 - August 2011
  *
@@ -52,6 +57,24 @@
 #include "sofs_superblock.h"
 #include "sofs_inode.h"
 
+/* Levels of the quick consistency checks */
+
+/** \brief the quick consistency checks are run on every call */
+#define QCHECK_ALWAYS  0
+/** \brief the quick consistency checks are run again only after the superblock has been stored */
+#define QCHECK_STORE   1
+/** \brief the quick consistency checks are run only once, when the file system is mounted */
+#define QCHECK_MOUNT   2
+
+/* Quick consistency checks */
+
+/** \brief quick consistency check of the superblock */
+#define QC_SUPERBLOCK  0
+/** \brief quick consistency check of the table of inodes */
+#define QC_INT         1
+/** \brief quick consistency check of the data zone */
+#define QC_DZ          2
+
 /**
  *  \brief Load the contents of the superblock into internal storage.
  *
@@ -345,4 +368,86 @@ extern SODataClust *soGetDirRefClust (void);
 
 extern int soStoreDirRefClust (void);
 
+/**
+ *  \brief Translate an index to the list of direct references of a file into the logical number of the data cluster it
+ *         refers to.
+ *
+ *  The clusters of references to data clusters which are used are kept pinned in the cache of file maps, so that
+ *  translating another index of the same file, while they remain the ones referred by the inode, is just a memory
+ *  lookup. Their contents are accessed in place, so any change made to them afterwards is seen at once.
+ *
+ *  Any type of previous / current error on reading a cluster of references will disable the operation.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to the contents of the inode associated to the file
+ *  \param clustInd index to the list of direct references
+ *  \param p_outVal pointer to the location where the logical number of the data cluster is to be stored
+ *                  (\c NULL_CLUSTER, if there is none)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the inode number or the index to the list of direct references are out of range, any of the
+ *                      pointers is \c NULL or a reference to a cluster of references is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soMapFileCluster (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t *p_outVal);
+
+/**
+ *  \brief Remove a file from the cache of file maps.
+ *
+ *  The clusters of references to data clusters kept pinned for it are released. It must be called before the list of
+ *  references of the inode associated to the file is changed, so that no cluster which is freed remains pinned.
+ *
+ *  Any type of previous / current error on reading a cluster of references will disable the operation.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soForgetFileMap (uint32_t nInode);
+
+/**
+ *  \brief Set the level of the quick consistency checks.
+ *
+ *  The quick consistency checks of the superblock, of the table of inodes and of the data zone may be run
+ *
+ *    \li QCHECK_ALWAYS: on every call (default)
+ *    \li QCHECK_STORE:  once per generation of the superblock, that is, again only after it has been stored
+ *    \li QCHECK_MOUNT:  only once, when the file system is mounted.
+ *
+ *  \param level level of the quick consistency checks
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the level is not one of the above
+ */
+
+extern int soSetQCheckLevel (uint32_t level);
+
+/**
+ *  \brief Run a quick consistency check according to the level set.
+ *
+ *  The check is skipped if it was already passed and the level set does not require it to be run again.
+ *  If the free data clusters are tracked by a bitmap, the data zone is checked by soQCheckBitmap.
+ *
+ *  \param check quick consistency check to be run (QC_SUPERBLOCK, QC_INT or QC_DZ)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the check is not one of the above
+ *  \return -<em>error</em> issued by the quick consistency check, if it fails
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soQCheck (uint32_t check);
+
 #endif /* SOFS_BASICOPER_H_ */
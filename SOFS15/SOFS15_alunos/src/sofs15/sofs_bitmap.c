@@ -0,0 +1,618 @@
+/**
+ *  \file sofs_bitmap.c (implementation file)
+ *
+ *  \brief Bitmap of free data clusters.
+ *
+ *  When the file system is formatted with the <tt>FC_BITMAP</tt> format, the blocks which would otherwise hold the
+ *  table of references to free data clusters hold instead the bitmap proper, a bit per data cluster, set if the data
+ *  cluster is free, followed by its summary, a count per block of the bitmap of the free data clusters it describes.
+ *  A bitmap which fits in a single block has no summary.
+ *
+ *  The blocks of the bitmap and of the summary are accessed in place in the buffercache: they are pinned while an
+ *  operation is carried out and unpinned before it returns, so no state is kept between operations.
+ *  The words of a block are scanned a vector at a time, with AVX2 or SSE2 instructions when the build enables them,
+ *  and the blocks of the bitmap whose count in the summary is zero are skipped without being read.
+ *
+ *  The following operations are defined:
+ *    \li get the number of blocks the bitmap and its summary comprise
+ *    \li allocate a run of free data clusters
+ *    \li free a run of allocated data clusters
+ *    \li get the allocation status of a data cluster
+ *    \li quick check of the bitmap metadata.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#if defined (__AVX2__) || defined (__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicconsist.h"
+#include "sofs_bitmap.h"
+
+/** \brief number of blocks of the bitmap proper */
+#define BMP_BLOCKS(p_sb)   (((p_sb)->dzone_total + BPB - 1) / BPB)
+
+/** \brief physical number of the <tt>n</tt>-th block of the bitmap */
+#define BMP_BLOCK(p_sb,n)  ((p_sb)->tbfreeclust_start + (n))
+
+/** \brief number of blocks of the bitmap, from the one where the search starts, where a long enough run is looked for */
+#define BMP_WINDOW         8
+
+/** \brief whether the bitmap has a summary */
+#define HAS_SUMMARY(p_sb)  (BMP_BLOCKS (p_sb) > 1)
+
+/** \brief physical number of the block of the summary where the count of the <tt>n</tt>-th block of the bitmap is */
+#define SUM_BLOCK(p_sb,n)  ((p_sb)->tbfreeclust_start + BMP_BLOCKS (p_sb) + (n) / RPB)
+
+/**
+ *  \brief Block of the bitmap or of its summary pinned in the buffercache.
+ */
+
+typedef struct
+{ /** \brief physical number of the block (<tt>NULL_BLOCK</tt>, if none is pinned) */
+    uint32_t nBlk;
+  /** \brief pointer to its contents, seen as an array of 32-bit words */
+    uint32_t *w;
+} SOBmpPin;
+
+/* Allusion to internal functions */
+
+static int soFindFree (SOSuperBlock *p_sb, SOBmpPin *map, SOBmpPin *sum, uint32_t lo, uint32_t hi,
+                       uint32_t *p_nClust);
+static int soRunEnd (SOSuperBlock *p_sb, SOBmpPin *map, uint32_t nClust, uint32_t lim, uint32_t *p_end);
+static uint32_t soScanWords (const uint32_t *w, uint32_t from, uint32_t to, uint32_t pat);
+static uint32_t soFindBit (const uint32_t *w, uint32_t from, uint32_t to, uint32_t pat);
+static void soFillBits (uint32_t *w, uint32_t from, uint32_t to, bool set);
+static int soPin (SOBmpPin *pin, uint32_t nBlk);
+static int soPinCount (SOSuperBlock *p_sb, SOBmpPin *sum, uint32_t n, uint32_t **p_cnt);
+static int soRelease (SOBmpPin *map, SOBmpPin *sum, int stat);
+
+/**
+ *  \brief Get the number of blocks the bitmap and its summary comprise.
+ *
+ *  \param nclust total number of data clusters
+ *
+ *  \return the number of blocks
+ */
+
+uint32_t soBitmapSize (uint32_t nclust)
+{
+  uint32_t nBmp = (nclust + BPB - 1) / BPB;      /* number of blocks of the bitmap proper */
+
+  return (nBmp > 1) ? nBmp + (nBmp + RPB - 1) / RPB : nBmp;
+}
+
+/**
+ *  \brief Allocate a run of free data clusters.
+ *
+ *  The first run of free data clusters as long as required, from a given data cluster on, is allocated; if there is none
+ *  within a window of <tt>BMP_WINDOW</tt> blocks of the bitmap, the longest run found there is allocated instead and,
+ *  if there is none at all, the search goes on to the end of the data zone and wraps around to its start, allocating
+ *  the first free data cluster which is found and the free ones which immediately follow it, up to the number required.
+ *  The fields of the superblock are left unchanged.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param goal logical number of the data cluster where the search starts
+ *  \param count maximum number of data clusters to be allocated
+ *  \param p_nClust pointer to the location where the logical number of the first allocated data cluster is to be stored
+ *  \param p_len pointer to the location where the number of allocated data clusters is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or the number of data clusters is zero
+ *  \return -\c ENOSPC, if there are no free data clusters
+ *  \return -\c EFCTINVAL, if the bitmap is inconsistent with its summary
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soBitmapAlloc (SOSuperBlock *p_sb, uint32_t goal, uint32_t count, uint32_t *p_nClust, uint32_t *p_len)
+{
+  soColorProbe (741, "07;31", "soBitmapAlloc (%p, %"PRIu32", %"PRIu32", %p, %p)\n", p_sb, goal, count, p_nClust,
+                p_len);
+
+  SOBmpPin map = { NULL_BLOCK, NULL };           /* pinned block of the bitmap */
+  SOBmpPin sum = { NULL_BLOCK, NULL };           /* pinned block of the summary */
+  uint32_t nClust;                               /* logical number of the first data cluster of the run */
+  uint32_t end;                                  /* logical number of the data cluster which follows the run */
+  uint32_t lim;                                  /* upper bound of the run */
+  uint32_t pos;                                  /* logical number of the data cluster where the search goes on */
+  uint32_t wEnd;                                 /* logical number of the data cluster which follows the window */
+  uint32_t best = NULL_CLUSTER;                  /* logical number of the first data cluster of the longest run */
+  uint32_t bestLen = 0;                          /* number of data clusters of the longest run */
+  uint32_t n;                                    /* logical number of the block of the bitmap */
+  uint32_t off, top;                             /* bounds of the run within the block of the bitmap */
+  uint32_t *cnt;                                 /* pointer to the count of free data clusters of the block */
+  int stat;                                      /* status of operation */
+
+  if ((p_sb == NULL) || (p_nClust == NULL) || (p_len == NULL) || (count == 0)) return -EINVAL;
+  if (goal >= p_sb->dzone_total) goal = 0;
+
+  /* look for the first run as long as required within the window, keeping the longest one found meanwhile */
+
+  wEnd = (p_sb->dzone_total / BPB - goal / BPB < BMP_WINDOW) ? p_sb->dzone_total : (goal / BPB + BMP_WINDOW) * BPB;
+  pos = goal;
+  while ((bestLen < count) && ((stat = soFindFree (p_sb, &map, &sum, pos, wEnd, &nClust)) == 0))
+  { lim = (count < p_sb->dzone_total - nClust) ? nClust + count : p_sb->dzone_total;
+    if ((stat = soRunEnd (p_sb, &map, nClust, lim, &end)) != 0) break;
+    if (end - nClust > bestLen)
+       { best = nClust;
+         bestLen = end - nClust;
+       }
+    pos = end;
+  }
+  if ((stat != 0) && (stat != -ENOSPC)) return soRelease (&map, &sum, stat);
+
+  /* if there is none, look for the first free data cluster up to the end of the data zone and, then, from its start */
+
+  if (bestLen == 0)
+     { stat = soFindFree (p_sb, &map, &sum, wEnd, p_sb->dzone_total, &nClust);
+       if ((stat == -ENOSPC) && (goal != 0))
+          stat = soFindFree (p_sb, &map, &sum, 0, goal, &nClust);
+       if (stat != 0) return soRelease (&map, &sum, stat);
+     }
+     else nClust = best;
+
+  /* allocate it and the free ones which immediately follow it, a block of the bitmap at a time */
+
+  lim = (count < p_sb->dzone_total - nClust) ? nClust + count : p_sb->dzone_total;
+  end = nClust;
+  do
+  { n = end / BPB;
+    off = end % BPB;
+    top = (lim - n * BPB < BPB) ? lim - n * BPB : BPB;
+    if (((stat = soPin (&map, BMP_BLOCK (p_sb, n))) != 0) || ((stat = soPinCount (p_sb, &sum, n, &cnt)) != 0))
+       break;
+    top = soFindBit (map.w, off, top, ~0U);      /* the first allocated data cluster ends the run */
+    if ((cnt != NULL) && (*cnt < top - off))
+       { stat = -EFCTINVAL;
+         break;
+       }
+    soFillBits (map.w, off, top, false);
+    if (cnt != NULL) *cnt -= top - off;
+    if (((stat = soMarkCacheBlock (map.nBlk)) != 0) ||
+        ((sum.nBlk != NULL_BLOCK) && ((stat = soMarkCacheBlock (sum.nBlk)) != 0)))
+       break;
+    end = n * BPB + top;
+  } while ((end < lim) && (top == BPB));
+  if (stat == 0)
+     { *p_nClust = nClust;
+       *p_len = end - nClust;
+     }
+
+  return soRelease (&map, &sum, stat);
+}
+
+/**
+ *  \brief Free a run of allocated data clusters.
+ *
+ *  Either all the data clusters of the run are freed, or none is.
+ *  The fields of the superblock are left unchanged.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param nClust logical number of the first data cluster of the run
+ *  \param len number of data clusters of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL or the run is out of range
+ *  \return -\c EDCNALINVAL, if any of the data clusters is not allocated
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soBitmapFree (SOSuperBlock *p_sb, uint32_t nClust, uint32_t len)
+{
+  soColorProbe (742, "07;31", "soBitmapFree (%p, %"PRIu32", %"PRIu32")\n", p_sb, nClust, len);
+
+  SOBmpPin map = { NULL_BLOCK, NULL };           /* pinned block of the bitmap */
+  SOBmpPin sum = { NULL_BLOCK, NULL };           /* pinned block of the summary */
+  uint32_t end;                                  /* logical number of the data cluster which follows the run */
+  uint32_t n;                                    /* logical number of the block of the bitmap */
+  uint32_t off, top;                             /* bounds of the run within the block of the bitmap */
+  uint32_t *cnt;                                 /* pointer to the count of free data clusters of the block */
+  int stat = 0;                                  /* status of operation */
+
+  if ((p_sb == NULL) || (len == 0) || (nClust >= p_sb->dzone_total) || (len > p_sb->dzone_total - nClust))
+     return -EINVAL;
+  end = nClust + len;
+
+  /* make sure all of them are allocated, before any is freed */
+
+  for (n = nClust / BPB; n * BPB < end; n++)
+  { off = (nClust > n * BPB) ? nClust - n * BPB : 0;
+    top = (end - n * BPB < BPB) ? end - n * BPB : BPB;
+    if ((stat = soPin (&map, BMP_BLOCK (p_sb, n))) != 0) break;
+    if (soFindBit (map.w, off, top, 0) != top)
+       { stat = -EDCNALINVAL;
+         break;
+       }
+  }
+
+  /* free them */
+
+  if (stat == 0)
+     for (n = nClust / BPB; n * BPB < end; n++)
+     { off = (nClust > n * BPB) ? nClust - n * BPB : 0;
+       top = (end - n * BPB < BPB) ? end - n * BPB : BPB;
+       if (((stat = soPin (&map, BMP_BLOCK (p_sb, n))) != 0) || ((stat = soPinCount (p_sb, &sum, n, &cnt)) != 0))
+          break;
+       soFillBits (map.w, off, top, true);
+       if (cnt != NULL) *cnt += top - off;
+       if (((stat = soMarkCacheBlock (map.nBlk)) != 0) ||
+           ((sum.nBlk != NULL_BLOCK) && ((stat = soMarkCacheBlock (sum.nBlk)) != 0)))
+          break;
+     }
+
+  return soRelease (&map, &sum, stat);
+}
+
+/**
+ *  \brief Get the allocation status of a data cluster.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param nClust logical number of the data cluster
+ *  \param p_stat pointer to a location where the allocation status is stored on success
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if either of the pointers is \c NULL or the logical number of the data cluster is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soBitmapStat (SOSuperBlock *p_sb, uint32_t nClust, uint32_t *p_stat)
+{
+  soColorProbe (743, "07;31", "soBitmapStat (%p, %"PRIu32", %p)\n", p_sb, nClust, p_stat);
+
+  SOBmpPin map = { NULL_BLOCK, NULL };           /* pinned block of the bitmap */
+  SOBmpPin sum = { NULL_BLOCK, NULL };           /* no block of the summary is needed */
+  uint32_t off;                                  /* position of the data cluster within the block of the bitmap */
+  int stat;                                      /* status of operation */
+
+  if ((p_sb == NULL) || (p_stat == NULL) || (nClust >= p_sb->dzone_total)) return -EINVAL;
+
+  off = nClust % BPB;
+  if ((stat = soPin (&map, BMP_BLOCK (p_sb, nClust / BPB))) == 0)
+     *p_stat = ((map.w[off >> 5] >> (off & 31)) & 1) ? FREE_CLT : ALLOC_CLT;
+
+  return soRelease (&map, &sum, stat);
+}
+
+/**
+ *  \brief Quick check of the bitmap metadata.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are not empty
+ *  \return -\c EFCTINVAL, if the summary of the bitmap is inconsistent
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+int soQCheckBitmap (SOSuperBlock *p_sb)
+{
+  soColorProbe (744, "07;31", "soQCheckBitmap (%p)\n", p_sb);
+
+  SOBmpPin map = { NULL_BLOCK, NULL };           /* pinned block of the bitmap, if it has no summary */
+  SOBmpPin sum = { NULL_BLOCK, NULL };           /* pinned block of the summary */
+  uint32_t nBmp;                                 /* number of blocks of the bitmap proper */
+  uint32_t n;                                    /* logical number of the block of the bitmap */
+  uint32_t max;                                  /* number of data clusters described by the block of the bitmap */
+  uint32_t total = 0;                            /* number of free data clusters, as told by the summary */
+  int stat = 0;                                  /* status of operation */
+
+  if (p_sb == NULL) return -EINVAL;
+
+  if ((p_sb->dzone_total == 0) || (p_sb->tbfreeclust_size != soBitmapSize (p_sb->dzone_total)) ||
+      (p_sb->dzone_start != p_sb->tbfreeclust_start + p_sb->tbfreeclust_size) ||
+      (p_sb->dzone_free >= p_sb->dzone_total) || (p_sb->tbfreeclust_head >= p_sb->dzone_total))
+     return -ESBDZINVAL;
+  if ((p_sb->dzone_retriev.cache_idx != DZONE_CACHE_SIZE) || (p_sb->dzone_insert.cache_idx != 0))
+     return -ESBFCCINVAL;
+
+  nBmp = BMP_BLOCKS (p_sb);
+  if (!HAS_SUMMARY (p_sb))                       /* the free data clusters of the single block are counted */
+     { if ((stat = soPin (&map, BMP_BLOCK (p_sb, 0))) == 0)
+          for (n = 0; n < RPB; n++)
+            total += __builtin_popcount (map.w[n]);
+       if ((stat == 0) && (total != p_sb->dzone_free))
+          stat = -EFCTINVAL;
+       return soRelease (&map, &sum, stat);
+     }
+  for (n = 0; n < nBmp; n++)
+  { if ((stat = soPin (&sum, SUM_BLOCK (p_sb, n))) != 0) break;
+    max = (n == nBmp - 1) ? p_sb->dzone_total - n * BPB : BPB;
+    if (sum.w[n % RPB] > max)
+       { stat = -EFCTINVAL;
+         break;
+       }
+    total += sum.w[n % RPB];
+  }
+  if ((stat == 0) && (total != p_sb->dzone_free))
+     stat = -EFCTINVAL;
+
+  return soRelease (&map, &sum, stat);
+}
+
+/**
+ *  \brief Look for the first free data cluster in a range of the data zone.
+ *
+ *  The blocks of the bitmap pinned on return are released by the caller.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param map pointer to the pinned block of the bitmap
+ *  \param sum pointer to the pinned block of the summary
+ *  \param lo logical number of the first data cluster of the range
+ *  \param hi logical number of the data cluster which follows the range
+ *  \param p_nClust pointer to the location where the logical number of the free data cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENOSPC, if there are no free data clusters in the range
+ *  \return -\c EFCTINVAL, if the bitmap is inconsistent with its summary
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soFindFree (SOSuperBlock *p_sb, SOBmpPin *map, SOBmpPin *sum, uint32_t lo, uint32_t hi,
+                       uint32_t *p_nClust)
+{
+  uint32_t n;                                    /* logical number of the block of the bitmap */
+  uint32_t last;                                 /* logical number of the last block of the bitmap in the range */
+  uint32_t s, top;                               /* bounds of the counts to be scanned in the block of the summary */
+  uint32_t k;                                    /* position of the first nonzero count / free data cluster */
+  uint32_t off;                                  /* position of the first data cluster in the block of the bitmap */
+  int stat;                                      /* status of operation */
+
+  if (lo >= hi) return -ENOSPC;
+
+  last = (hi - 1) / BPB;
+  n = lo / BPB;
+  while (n <= last)
+  { /* skip the blocks of the bitmap with no free data cluster, a block of the summary at a time */
+    if (HAS_SUMMARY (p_sb))
+       { if ((stat = soPin (sum, SUM_BLOCK (p_sb, n))) != 0) return stat;
+         s = n % RPB;
+         top = (last - n < RPB - s) ? s + (last - n) + 1 : RPB;
+         k = soScanWords (sum->w, s, top, 0);
+         n += k - s;
+         if (k == top) continue;
+       }
+
+    /* scan the block of the bitmap whose count is not zero */
+    if ((stat = soPin (map, BMP_BLOCK (p_sb, n))) != 0) return stat;
+    off = (lo > n * BPB) ? lo - n * BPB : 0;
+    top = (hi - n * BPB < BPB) ? hi - n * BPB : BPB;
+    if ((k = soFindBit (map->w, off, top, 0)) < top)
+       { *p_nClust = n * BPB + k;
+         return 0;
+       }
+    if (HAS_SUMMARY (p_sb) && (off == 0) && (top == BPB)) return -EFCTINVAL;
+    n += 1;
+  }
+
+  return -ENOSPC;
+}
+
+/**
+ *  \brief Get the end of a run of free data clusters.
+ *
+ *  The bitmap is only read.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param map pointer to the pinned block of the bitmap
+ *  \param nClust logical number of the first data cluster of the run, which is free
+ *  \param lim upper bound of the run
+ *  \param p_end pointer to the location where the logical number of the data cluster which follows the run is to be
+ *               stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soRunEnd (SOSuperBlock *p_sb, SOBmpPin *map, uint32_t nClust, uint32_t lim, uint32_t *p_end)
+{
+  uint32_t n;                                    /* logical number of the block of the bitmap */
+  uint32_t top;                                  /* upper bound of the run within the block of the bitmap */
+  int stat;                                      /* status of operation */
+
+  do
+  { n = nClust / BPB;
+    top = (lim - n * BPB < BPB) ? lim - n * BPB : BPB;
+    if ((stat = soPin (map, BMP_BLOCK (p_sb, n))) != 0) return stat;
+    top = soFindBit (map->w, nClust % BPB, top, ~0U);
+    nClust = n * BPB + top;
+  } while ((nClust < lim) && (top == BPB));
+  *p_end = nClust;
+
+  return 0;
+}
+
+/**
+ *  \brief Look for the first word in a range of an array of words which differs from a pattern.
+ *
+ *  \param w pointer to the array of words
+ *  \param from index of the first word of the range
+ *  \param to index of the word which follows the range
+ *  \param pat pattern
+ *
+ *  \return the index of the word, or <tt>to</tt>, if all the words of the range match the pattern
+ */
+
+static uint32_t soScanWords (const uint32_t *w, uint32_t from, uint32_t to, uint32_t pat)
+{
+#if defined (__AVX2__)
+  __m256i vpat = _mm256_set1_epi32 ((int) pat); /* pattern in every word of a vector */
+
+  for (; from + 8 <= to; from += 8)
+    if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (_mm256_loadu_si256 ((const __m256i *) (w + from)), vpat)) != -1)
+       break;
+#elif defined (__SSE2__)
+  __m128i vpat = _mm_set1_epi32 ((int) pat);     /* pattern in every word of a vector */
+
+  for (; from + 4 <= to; from += 4)
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_loadu_si128 ((const __m128i *) (w + from)), vpat)) != 0xFFFF)
+       break;
+#endif
+  for (; from < to; from++)
+    if (w[from] != pat) break;
+
+  return from;
+}
+
+/**
+ *  \brief Look for the first bit in a range of a bitmap which differs from the bits of a pattern.
+ *
+ *  \param w pointer to the bitmap, seen as an array of words
+ *  \param from position of the first bit of the range
+ *  \param to position of the bit which follows the range
+ *  \param pat pattern: \c 0, to look for a set bit, or \c ~0, to look for a clear one
+ *
+ *  \return the position of the bit, or <tt>to</tt>, if there is none in the range
+ */
+
+static uint32_t soFindBit (const uint32_t *w, uint32_t from, uint32_t to, uint32_t pat)
+{
+  uint32_t k;                                    /* index of the word */
+  uint32_t x;                                    /* bits of the word which differ from the pattern */
+
+  if (from >= to) return to;
+
+  k = from >> 5;
+  x = (w[k] ^ pat) & (~0U << (from & 31));
+  if (x == 0)
+     { k = soScanWords (w, k + 1, (to + 31) >> 5, pat);
+       if (k == ((to + 31) >> 5)) return to;
+       x = w[k] ^ pat;
+     }
+  from = (k << 5) + __builtin_ctz (x);
+
+  return (from < to) ? from : to;
+}
+
+/**
+ *  \brief Set or clear the bits in a range of a bitmap.
+ *
+ *  \param w pointer to the bitmap, seen as an array of words
+ *  \param from position of the first bit of the range
+ *  \param to position of the bit which follows the range
+ *  \param set \c true, to set the bits, \c false, to clear them
+ */
+
+static void soFillBits (uint32_t *w, uint32_t from, uint32_t to, bool set)
+{
+  uint32_t k;                                    /* index of the word */
+  uint32_t hi;                                   /* position within the word of the bit which follows the range */
+  uint32_t mask;                                 /* bits of the word in the range */
+
+  while (from < to)
+  { k = from >> 5;
+    if (((from & 31) == 0) && (to - from >= 32))
+       { hi = (to - from) >> 5;                  /* whole words */
+         memset (w + k, set ? 0xFF : 0x00, hi * sizeof (uint32_t));
+         from += hi << 5;
+         continue;
+       }
+    hi = (to - (k << 5) < 32) ? to - (k << 5) : 32;
+    mask = ((hi == 32) ? ~0U : ((1U << hi) - 1)) & (~0U << (from & 31));
+    w[k] = set ? (w[k] | mask) : (w[k] & ~mask);
+    from = (k << 5) + hi;
+  }
+}
+
+/**
+ *  \brief Pin a block of the bitmap or of its summary in the buffercache.
+ *
+ *  The block previously pinned in the same place, if any, is unpinned.
+ *
+ *  \param pin pointer to the pinned block
+ *  \param nBlk physical number of the block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soPin (SOBmpPin *pin, uint32_t nBlk)
+{
+  void *buf;                                     /* pointer to the contents of the block */
+  int stat;                                      /* status of operation */
+
+  if (pin->nBlk == nBlk) return 0;
+  if (pin->nBlk != NULL_BLOCK)
+     { stat = soPutCacheBlock (pin->nBlk);
+       pin->nBlk = NULL_BLOCK;
+       if (stat != 0) return stat;
+     }
+  if ((stat = soGetCacheBlock (nBlk, &buf)) != 0) return stat;
+  pin->nBlk = nBlk;
+  pin->w = buf;
+
+  return 0;
+}
+
+/**
+ *  \brief Pin the block of the summary where the count of free data clusters of a block of the bitmap is stored.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param sum pointer to the pinned block of the summary
+ *  \param n logical number of the block of the bitmap
+ *  \param p_cnt pointer to the location where the pointer to the count is to be stored (\c NULL, if the bitmap has no
+ *               summary)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+static int soPinCount (SOSuperBlock *p_sb, SOBmpPin *sum, uint32_t n, uint32_t **p_cnt)
+{
+  int stat;                                      /* status of operation */
+
+  *p_cnt = NULL;
+  if (!HAS_SUMMARY (p_sb)) return 0;
+  if ((stat = soPin (sum, SUM_BLOCK (p_sb, n))) != 0) return stat;
+  *p_cnt = sum->w + n % RPB;
+
+  return 0;
+}
+
+/**
+ *  \brief Unpin the blocks of the bitmap and of its summary which are pinned at the end of an operation.
+ *
+ *  \param map pointer to the pinned block of the bitmap
+ *  \param sum pointer to the pinned block of the summary
+ *  \param stat status of the operation
+ *
+ *  \return the status of the operation or, if it was successful, the status of unpinning the blocks
+ */
+
+static int soRelease (SOBmpPin *map, SOBmpPin *sum, int stat)
+{
+  int st;                                        /* status of unpinning a block */
+
+  if ((map->nBlk != NULL_BLOCK) && ((st = soPutCacheBlock (map->nBlk)) != 0) && (stat == 0)) stat = st;
+  if ((sum->nBlk != NULL_BLOCK) && ((st = soPutCacheBlock (sum->nBlk)) != 0) && (stat == 0)) stat = st;
+  map->nBlk = sum->nBlk = NULL_BLOCK;
+
+  return stat;
+}
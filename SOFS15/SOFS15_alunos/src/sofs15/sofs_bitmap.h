@@ -0,0 +1,139 @@
+/**
+ *  \file sofs_bitmap.h (interface file)
+ *
+ *  \brief Bitmap of free data clusters.
+ *
+ *  When the file system is formatted with the <tt>FC_BITMAP</tt> format, the blocks which would otherwise hold the
+ *  table of references to free data clusters hold instead
+ *     \li the <em>bitmap</em> proper - a bit per data cluster, set if the data cluster is free, <tt>BPB</tt> data
+ *         clusters per block (the bits past the last data cluster are kept clear)
+ *     \li the <em>summary</em> - a count per block of the bitmap of the free data clusters it describes, <tt>RPB</tt>
+ *         counts per block; a bitmap which fits in a single block has no summary.
+ *
+ *  Looking for free data clusters, the blocks of the bitmap whose count is zero are skipped without being read and the
+ *  remaining ones are scanned a vector of words at a time. So a run of free data clusters, however long, is found and
+ *  allocated, or freed, in a single pass.
+ *
+ *  The caches of references in the superblock are kept empty and the point of retrieval of the table of references is
+ *  where the next search for a free data cluster starts. The number of free data clusters is kept by the callers.
+ *
+ *  The following operations are defined:
+ *    \li get the number of blocks the bitmap and its summary comprise
+ *    \li allocate a run of free data clusters
+ *    \li free a run of allocated data clusters
+ *    \li get the allocation status of a data cluster
+ *    \li quick check of the bitmap metadata.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           or the local error that better represents the error cause.
+ */
+
+#ifndef SOFS_BITMAP_H_
+#define SOFS_BITMAP_H_
+
+#include <stdint.h>
+
+#include "sofs_const.h"
+#include "sofs_superblock.h"
+
+/** \brief number of data clusters described by a block of the bitmap */
+#define BPB (BLOCK_SIZE << 3)
+
+/**
+ *  \brief Get the number of blocks the bitmap and its summary comprise.
+ *
+ *  \param nclust total number of data clusters
+ *
+ *  \return the number of blocks
+ */
+
+extern uint32_t soBitmapSize (uint32_t nclust);
+
+/**
+ *  \brief Allocate a run of free data clusters.
+ *
+ *  The first run of free data clusters as long as required, from a given data cluster on, is allocated; if there is none
+ *  within a window of a few blocks of the bitmap, the longest run found there is allocated instead and,
+ *  if there is none at all, the search goes on to the end of the data zone and wraps around to its start, allocating
+ *  the first free data cluster which is found and the free ones which immediately follow it, up to the number required.
+ *  The fields of the superblock are left unchanged.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param goal logical number of the data cluster where the search starts
+ *  \param count maximum number of data clusters to be allocated
+ *  \param p_nClust pointer to the location where the logical number of the first allocated data cluster is to be stored
+ *  \param p_len pointer to the location where the number of allocated data clusters is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL or the number of data clusters is zero
+ *  \return -\c ENOSPC, if there are no free data clusters
+ *  \return -\c EFCTINVAL, if the bitmap is inconsistent with its summary
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soBitmapAlloc (SOSuperBlock *p_sb, uint32_t goal, uint32_t count, uint32_t *p_nClust, uint32_t *p_len);
+
+/**
+ *  \brief Free a run of allocated data clusters.
+ *
+ *  Either all the data clusters of the run are freed, or none is.
+ *  The fields of the superblock are left unchanged.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param nClust logical number of the first data cluster of the run
+ *  \param len number of data clusters of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL or the run is out of range
+ *  \return -\c EDCNALINVAL, if any of the data clusters is not allocated
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soBitmapFree (SOSuperBlock *p_sb, uint32_t nClust, uint32_t len);
+
+/**
+ *  \brief Get the allocation status of a data cluster.
+ *
+ *  The status is returned in the following way
+ *     \li <tt>ALLOC_CLT</tt>, if the data cluster is allocated
+ *     \li <tt>FREE_CLT</tt>, if the data cluster is free.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param nClust logical number of the data cluster
+ *  \param p_stat pointer to a location where the allocation status is stored on success
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if either of the pointers is \c NULL or the logical number of the data cluster is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soBitmapStat (SOSuperBlock *p_sb, uint32_t nClust, uint32_t *p_stat);
+
+/**
+ *  \brief Quick check of the bitmap metadata.
+ *
+ *  It takes the place of soQCheckDZ for a file system formatted with a bitmap. The associated fields in the superblock
+ *  must have legal values, the caches must be empty and the number of free data clusters computed through inspection
+ *  of the summary must match the value stored in the related field of the superblock.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are not empty
+ *  \return -\c EFCTINVAL, if the summary of the bitmap is inconsistent
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ */
+
+extern int soQCheckBitmap (SOSuperBlock *p_sb);
+
+#endif /* SOFS_BITMAP_H_ */
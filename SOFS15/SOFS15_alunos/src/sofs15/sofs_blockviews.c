@@ -298,6 +298,28 @@ void printSuperBlock (void *buf)
   if (p_sb->tbfreeclust_tail == NULL_CLUSTER)
      printf ("(nil)\n");
      else printf ("%"PRIu32"\n", p_sb->tbfreeclust_tail);
+
+  /* geometry */
+
+  printf ("Geometry\n");
+  if (p_sb->bsize == NO_GEOMETRY)
+     printf ("   Not recorded (default geometry: %d-byte blocks, %d blocks per cluster)\n", DEF_BLOCK_SIZE,
+             DEF_BLOCKS_PER_CLUSTER);
+     else { printf ("   Block size (in bytes) = %"PRIu32"\n", p_sb->bsize);
+            printf ("   Number of blocks in a cluster = %"PRIu32"\n", p_sb->bpc);
+          }
+
+  /* free data clusters metadata */
+
+  printf ("Free data clusters metadata\n");
+  if (p_sb->fcformat == FC_BITMAP)
+     printf ("   Bitmap of free data clusters, in place of the table of references, whose point of retrieval is where\n"
+             "     the next search starts\n");
+     else { printf ("   Table of references to free data clusters and caches%s\n",
+                    (p_sb->fcformat == FC_TABLE) ? "" : " (not recorded)");
+            printf ("   Number of references the caches hold = %"PRIu32"%s\n", DZ_CACHE_SIZE (p_sb),
+                    (DZ_CACHE_SIZE (p_sb) == p_sb->dzcache_size) ? "" : " (not recorded)");
+          }
 }
 
 /**
@@ -10,6 +10,7 @@
  *      \li allocate a free inode
  *      \li free the referenced inode
  *      \li allocate a free data cluster
+ *      \li allocate a number of free data clusters, in runs as long as possible
  *      \li free the referenced data cluster.
  *
  *  \author Artur Carneiro Pereira September 2008
@@ -110,6 +111,38 @@ extern int soFreeInode (uint32_t nInode);
 
 extern int soAllocDataCluster (uint32_t *p_nClust);
 
+/**
+ *  \brief Allocate a number of free data clusters, in runs as long as possible near a given data cluster.
+ *
+ *  If the free data clusters are tracked by a bitmap, the runs are taken from it one after the other, the first one
+ *  starting the search at the goal and each of the following ones where the previous one ended. The logical numbers
+ *  of the data clusters of a run are stored in succession in the list.
+ *  Otherwise, the table of references to free data clusters has no notion of where the free data clusters are, so they
+ *  are allocated one at a time from the retrieval cache, each one being the first in the cache, in the order of the
+ *  data zone, from the goal, or from the data cluster which follows the previous one, on. The superblock is stored once
+ *  for all of them.
+ *
+ *  Either all the data clusters are allocated, or none is.
+ *
+ *  \param count number of data clusters to be allocated
+ *  \param goal logical number of the data cluster where the search starts (<tt>NULL_CLUSTER</tt>, if the search is to
+ *              start where the previous one stopped)
+ *  \param list pointer to the array where the logical numbers of the allocated data clusters are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer to the array</em> is \c NULL or the <em>number of data clusters</em> is zero
+ *  \return -\c ENOSPC, if there are not enough free data clusters
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are inconsistent
+ *  \return -\c EFCTINVAL, if the table of references to free data clusters is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soAllocDataClusters (uint32_t count, uint32_t goal, uint32_t *list);
+
 /**
  *  \brief Free the referenced data cluster.
  *
@@ -18,17 +18,21 @@
 #include "sofs_datacluster.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_bitmap.h"
 
 /* Allusion to internal functions */
 
 int soReplenish (SOSuperBlock *p_sb);
 int soDeplete (SOSuperBlock *p_sb);
+static int soTakeRefsFCT (SOSuperBlock *p_sb, uint32_t *p_index, uint32_t *p_n);
 
 /**
  *  \brief Allocate a free data cluster.
  *
  *  The cluster is retrieved from the retrieval cache of free data cluster references. If the cache is empty, it has to
  *  be replenished before the retrieval may take place.
+ *  If the free data clusters are tracked by a bitmap, the first free cluster from the point where the previous search
+ *  stopped is taken instead.
  *
  *  \param p_nClust pointer to the location where the logical number of the allocated data cluster is to be stored
  *
@@ -53,24 +57,32 @@ int soAllocDataCluster (uint32_t *p_nClust)
 
    SOSuperBlock* p_sb; /*pointer to super block*/
    int error;
+   uint32_t len; /*number of clusters taken from the bitmap*/
 
    /*Load SB*/
    if((error=soLoadSuperBlock())!=0) 	return error; 	
    if((p_sb=soGetSuperBlock())==NULL)	return -EIO; 
    /*Quick consistency check of Super Block*/
-   if((error=soQCheckSuperBlock(p_sb))!=0)	return error;	
+   if((error=soQCheck(QC_SUPERBLOCK))!=0)	return error;	
    /*Quick consistency check of Data Zone (associated fields in the SB, 
    data clusters && table of references for free data clusters)*/
-   if((error=soQCheckDZ(p_sb))!=0)		return error;	
+   if((error=soQCheck(QC_DZ))!=0)		return error;	
    if(p_sb->dzone_free==0)				return -ENOSPC;	
-   if(p_sb->dzone_retriev.cache_idx==DZONE_CACHE_SIZE){
-      /* cache empty: replenish */
-   		if((error=soReplenish(p_sb))!=0) return error;	
+   if(p_sb->fcformat==FC_BITMAP){
+      /* bitmap: the search starts where the previous one stopped */
+      if((error=soBitmapAlloc(p_sb,p_sb->tbfreeclust_head,1,p_nClust,&len))!=0) return error;
+      p_sb->tbfreeclust_head=(*p_nClust+1)%p_sb->dzone_total;
    }
+   else{
+      if(p_sb->dzone_retriev.cache_idx==DZONE_CACHE_SIZE){
+         /* cache empty: replenish */
+   		if((error=soReplenish(p_sb))!=0) return error;	
+      }
 
-   *p_nClust=p_sb->dzone_retriev.cache[p_sb->dzone_retriev.cache_idx]; /* p_nclust = content of cache @ index*/ ////////////////////////////
-   /* increments index of retrieved cache */
-   p_sb->dzone_retriev.cache_idx+=1; 
+      *p_nClust=p_sb->dzone_retriev.cache[p_sb->dzone_retriev.cache_idx]; /* p_nclust = content of cache @ index*/ ////////////////////////////
+      /* increments index of retrieved cache */
+      p_sb->dzone_retriev.cache_idx+=1; 
+   }
    /* decrement number of free data clusters*/
    p_sb->dzone_free-=1; 
 
@@ -83,6 +95,9 @@ int soAllocDataCluster (uint32_t *p_nClust)
 /**
  *  \brief Replenish the retrieval cache of references to free data clusters.
  *
+ *  The references are moved from the table of references to free data clusters a block at a time: each block of the
+ *  table is loaded and stored once for all the references it supplies.
+ *
  *  \param p_sb pointer to a buffer where the superblock data is stored
  *
  *  \return <tt>0 (zero)</tt>, on success
@@ -94,44 +109,71 @@ int soAllocDataCluster (uint32_t *p_nClust)
 
 int soReplenish (SOSuperBlock *p_sb)
 {
-	uint32_t nclustt = (p_sb->dzone_free < DZONE_CACHE_SIZE) ? p_sb->dzone_free : DZONE_CACHE_SIZE;
-   uint32_t index = p_sb->tbfreeclust_head; //tbfreeclust_head nao esta declarado...
-   uint32_t n;
-   uint32_t *ref;
-   uint32_t error;
+   uint32_t nclustt = (p_sb->dzone_free < DZ_CACHE_SIZE(p_sb)) ? p_sb->dzone_free : DZ_CACHE_SIZE(p_sb);
+   uint32_t index = p_sb->tbfreeclust_head;
+   uint32_t n = DZONE_CACHE_SIZE - nclustt;
+   int error;
+
+   if((error=soTakeRefsFCT(p_sb, &index, &n))!=0) return error;
+   if (n != DZONE_CACHE_SIZE){ /* esvaziar a cache de inserção para se obter as referências restantes */
+      if((error=soDeplete(p_sb))!=0) return error;
+      if((error=soTakeRefsFCT(p_sb, &index, &n))!=0) return error;
+      if (n != DZONE_CACHE_SIZE) return -ELIBBAD;
+   }
+
+   p_sb->dzone_retriev.cache_idx = DZONE_CACHE_SIZE - nclustt;
+   p_sb->tbfreeclust_head = index;
+
+   return 0;
+}
+
+/**
+ *  \brief Move references from the table of references to free data clusters into the retrieval cache, a block of the
+ *         table at a time, until the cache is full or the point of insertion of the table is reached.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param p_index pointer to the index of the table where the references are taken from (it is updated)
+ *  \param p_n pointer to the position of the cache where the references are put into (it is updated)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+static int soTakeRefsFCT (SOSuperBlock *p_sb, uint32_t *p_index, uint32_t *p_n)
+{
+   uint32_t index = *p_index;
+   uint32_t n = *p_n;
    uint32_t block;
    uint32_t offset;
+   uint32_t len; /*number of references moved from the block*/
+   uint32_t k;
+   uint32_t *ref;
+   int error;
 
-   for (n = DZONE_CACHE_SIZE - nclustt; n < DZONE_CACHE_SIZE; n++){ 
-      if (index == p_sb->tbfreeclust_tail) break;
-      /*Get  references to Block and ref=soGetBlockFCT())==NULL_set from the index*/
+   while ((n < DZONE_CACHE_SIZE) && (index != p_sb->tbfreeclust_tail)){
       if((error=soConvertRefFCT(index, &block, &offset))!=0) return error;
-      /*Load Block*/
+      /* as many as the cache takes, up to the end of the block, of the table or of the filled part of the table */
+      len = DZONE_CACHE_SIZE - n;
+      if (len > RPB - offset) len = RPB - offset;
+      if (len > p_sb->dzone_total - index) len = p_sb->dzone_total - index;
+      if (len > (p_sb->tbfreeclust_tail + p_sb->dzone_total - index) % p_sb->dzone_total)
+         len = (p_sb->tbfreeclust_tail + p_sb->dzone_total - index) % p_sb->dzone_total;
       if((error=soLoadBlockFCT(block))!=0) return error;
-      /*Get pointer to ref from the table of references to free data clusters*/
       if((ref=soGetBlockFCT())==NULL) return -EIO;
-      p_sb->dzone_retriev.cache[n] = ref[offset];
-      ref[offset]=NULL_CLUSTER;
-      if((error=soStoreBlockFCT())!=0) return error;	
-      index = (index + 1) % p_sb->dzone_total;
-   }
-   
-   if (n != DZONE_CACHE_SIZE){ /* esvaziar a cache de inserção para se obter as referências restantes */
-      if((error=soDeplete(p_sb))!=0) return error;
-      
-      for (; n < DZONE_CACHE_SIZE; n++){ 
-         if((error=soConvertRefFCT(index, &block, &offset))!=0) return error;
-         if((error=soLoadBlockFCT(block))!=0) return error;
-         if((ref=soGetBlockFCT())==NULL) return -EIO;
-         p_sb->dzone_retriev.cache[n] = ref[offset];
-         ref[offset]=NULL_CLUSTER;
-	 if((error=soStoreBlockFCT())!=0) return error;	
-         index = (index + 1) % p_sb->dzone_total;
+      for (k = 0; k < len; k++){
+         p_sb->dzone_retriev.cache[n + k] = ref[offset + k];
+         ref[offset + k] = NULL_CLUSTER;
       }
+      if((error=soStoreBlockFCT())!=0) return error;
+      n += len;
+      index = (index + len) % p_sb->dzone_total;
    }
 
-   p_sb->dzone_retriev.cache_idx = DZONE_CACHE_SIZE - nclustt;
-   p_sb->tbfreeclust_head = index;
+   *p_index = index;
+   *p_n = n;
 
    return 0;
 }
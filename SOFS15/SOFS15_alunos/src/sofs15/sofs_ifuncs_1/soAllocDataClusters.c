@@ -0,0 +1,149 @@
+/**
+ *  \file soAllocDataClusters.c (implementation file)
+ */
+
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_bitmap.h"
+#include "sofs_ifuncs_1.h"
+
+/* Allusion to internal functions */
+
+int soReplenish (SOSuperBlock *p_sb);
+static int soPickNearest (SOSuperBlock *p_sb, uint32_t goal);
+
+/**
+ *  \brief Allocate a number of free data clusters, in runs as long as possible near a given data cluster.
+ *
+ *  If the free data clusters are tracked by a bitmap, the runs are taken from it one after the other, the first one
+ *  starting the search at the goal and each of the following ones where the previous one ended. The logical numbers
+ *  of the data clusters of a run are stored in succession in the list.
+ *  Otherwise, the table of references to free data clusters has no notion of where the free data clusters are, so they
+ *  are allocated one at a time from the retrieval cache, each one being the first in the cache, in the order of the
+ *  data zone, from the goal, or from the data cluster which follows the previous one, on. The superblock is stored once
+ *  for all of them.
+ *
+ *  Either all the data clusters are allocated, or none is.
+ *
+ *  \param count number of data clusters to be allocated
+ *  \param goal logical number of the data cluster where the search starts (<tt>NULL_CLUSTER</tt>, if the search is to
+ *              start where the previous one stopped)
+ *  \param list pointer to the array where the logical numbers of the allocated data clusters are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer to the array</em> is \c NULL or the <em>number of data clusters</em> is zero
+ *  \return -\c ENOSPC, if there are not enough free data clusters
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are inconsistent
+ *  \return -\c EFCTINVAL, if the table of references to free data clusters is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soAllocDataClusters (uint32_t count, uint32_t goal, uint32_t *list)
+{
+  soColorProbe (615, "07;33", "soAllocDataClusters (%"PRIu32", %"PRIu32", %p)\n", count, goal, list);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  uint32_t n;                                    /* number of data clusters allocated so far */
+  uint32_t nClust;                               /* logical number of the first data cluster of a run */
+  uint32_t len;                                  /* number of data clusters of a run */
+  int stat;                                      /* status of operation */
+
+  if ((list == NULL) || (count == 0)) return -EINVAL;
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if ((p_sb = soGetSuperBlock ()) == NULL) return -EIO;
+  if ((stat = soQCheck (QC_SUPERBLOCK)) != 0) return stat;
+  if ((stat = soQCheck (QC_DZ)) != 0) return stat;
+  if (p_sb->dzone_free < count) return -ENOSPC;
+
+  /* table of references: one data cluster at a time, the nearest one in the retrieval cache */
+
+  if (p_sb->fcformat != FC_BITMAP)
+     { for (n = 0; n < count; n++)
+       { if (((goal < p_sb->dzone_total) && ((stat = soPickNearest (p_sb, goal)) != 0)) ||
+             ((p_sb->dzone_retriev.cache_idx == DZONE_CACHE_SIZE) && ((stat = soReplenish (p_sb)) != 0)))
+            { while (n > 0)
+                soFreeDataCluster (list[--n]);
+              return stat;
+            }
+         list[n] = p_sb->dzone_retriev.cache[p_sb->dzone_retriev.cache_idx];
+         p_sb->dzone_retriev.cache_idx += 1;
+         p_sb->dzone_free -= 1;
+         goal = (list[n] + 1) % p_sb->dzone_total;
+       }
+       return soStoreSuperBlock ();
+     }
+
+  /* bitmap: a run at a time */
+
+  if (goal >= p_sb->dzone_total) goal = p_sb->tbfreeclust_head;
+  for (n = 0; n < count; n += len)
+  { if ((stat = soBitmapAlloc (p_sb, goal, count - n, &nClust, &len)) != 0)
+       { while (n > 0)
+           soBitmapFree (p_sb, list[--n], 1);
+         return stat;
+       }
+    for (goal = nClust; goal < nClust + len; goal++)
+      list[n + goal - nClust] = goal;
+    goal %= p_sb->dzone_total;
+  }
+  p_sb->tbfreeclust_head = goal;
+  p_sb->dzone_free -= count;
+
+  return soStoreSuperBlock ();
+}
+
+/**
+ *  \brief Bring the first reference in the retrieval cache, in the order of the data zone from a given data cluster on,
+ *         to the point of retrieval.
+ *
+ *  The retrieval cache is replenished first, if it is empty.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param goal logical number of the data cluster from which the references are taken in order
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+static int soPickNearest (SOSuperBlock *p_sb, uint32_t goal)
+{
+  uint32_t *cache = p_sb->dzone_retriev.cache;   /* retrieval cache */
+  uint32_t idx;                                  /* point of retrieval */
+  uint32_t k;                                    /* position in the retrieval cache */
+  uint32_t best;                                 /* position of the nearest reference */
+  uint32_t tmp;                                  /* reference being swapped */
+  int stat;                                      /* status of operation */
+
+  if (p_sb->dzone_retriev.cache_idx == DZONE_CACHE_SIZE)
+     { if ((stat = soReplenish (p_sb)) != 0) return stat;
+       if ((stat = soStoreSuperBlock ()) != 0) return stat;
+     }
+
+  idx = p_sb->dzone_retriev.cache_idx;
+  best = idx;
+  for (k = idx + 1; k < DZONE_CACHE_SIZE; k++)
+    if ((cache[k] - goal + p_sb->dzone_total) % p_sb->dzone_total <
+        (cache[best] - goal + p_sb->dzone_total) % p_sb->dzone_total)
+       best = k;
+  tmp = cache[idx];
+  cache[idx] = cache[best];
+  cache[best] = tmp;
+
+  return 0;
+}
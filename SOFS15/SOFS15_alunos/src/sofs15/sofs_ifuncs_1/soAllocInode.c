@@ -66,10 +66,10 @@ int soAllocInode (uint32_t type, uint32_t* p_nInode)
     return error;
    p_sb = soGetSuperBlock ();
 
-   if((error=soQCheckSuperBlock(p_sb)) != 0)
+   if((error=soQCheck(QC_SUPERBLOCK)) != 0)
       return error;
 
-   if((error=soQCheckInT(p_sb)) != 0)
+   if((error=soQCheck(QC_INT)) != 0)
       return error;
    
    if(p_sb->ifree == 0)                  //nao ha inodes livres
@@ -20,6 +20,7 @@
 #include "sofs_datacluster.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_bitmap.h"
 
 /* Allusion to internal functions */
 
@@ -30,6 +31,7 @@ int soDeplete (SOSuperBlock *p_sb);
  *
  *  The cluster is inserted into the insertion cache of free data cluster references. If the cache is full, it has to be
  *  depleted before the insertion may take place. It has to have been previouly allocated.
+ *  If the free data clusters are tracked by a bitmap, its bit is just set instead.
  *
  *  Notice that the first data cluster, supposed to belong to the file system root directory, can never be freed.
  *
@@ -58,17 +60,25 @@ int soFreeDataCluster (uint32_t nClust)
     /* Argument validation */
     if ( (error_status = soLoadSuperBlock()) != 0 ) return error_status;
     if ( (p_sb = soGetSuperBlock()) == NULL) return -EIO; 
-    if ( (error_status = soQCheckSuperBlock(p_sb)) != 0)  return error_status;
+    if ( (error_status = soQCheck(QC_SUPERBLOCK)) != 0)  return error_status;
     if ( nClust < 1 || nClust > p_sb -> dzone_total - 1 ) return -EINVAL;
-    if ( (error_status = soQCheckStatDC(p_sb, nClust, &clust_status)) != 0 ) return error_status;
-    if ( clust_status == FREE_CLT ) return -EDCNALINVAL;
-
-    /* Free Cluster */
-    if ( p_sb -> dzone_insert.cache_idx == DZONE_CACHE_SIZE ) /* Cache is full, it has to be depleted */
-        if ( (error_status = soDeplete(p_sb)) != 0 )
-            return error_status;
-    p_sb -> dzone_insert.cache[ p_sb -> dzone_insert.cache_idx ] = nClust;
-    p_sb -> dzone_insert.cache_idx += 1;
+
+    if ( p_sb -> fcformat == FC_BITMAP ) /* Bitmap: it fails if the cluster is not allocated */
+    {
+        if ( (error_status = soBitmapFree(p_sb, nClust, 1)) != 0 ) return error_status;
+    }
+    else
+    {
+        if ( (error_status = soQCheckStatDC(p_sb, nClust, &clust_status)) != 0 ) return error_status;
+        if ( clust_status == FREE_CLT ) return -EDCNALINVAL;
+
+        /* Free Cluster */
+        if ( p_sb -> dzone_insert.cache_idx >= DZ_CACHE_SIZE(p_sb) ) /* Cache is full, it has to be depleted */
+            if ( (error_status = soDeplete(p_sb)) != 0 )
+                return error_status;
+        p_sb -> dzone_insert.cache[ p_sb -> dzone_insert.cache_idx ] = nClust;
+        p_sb -> dzone_insert.cache_idx += 1;
+    }
     p_sb -> dzone_free += 1;
 
     if ( (error_status = soStoreSuperBlock()) != 0 ) return error_status;
@@ -78,6 +88,9 @@ int soFreeDataCluster (uint32_t nClust)
 /**
  *  \brief Deplete the insertion cache of references to free data clusters.
  *
+ *  The references are moved into the table of references to free data clusters a block at a time: each block of the
+ *  table is loaded and stored once for all the references it takes.
+ *
  *  \param p_sb pointer to a buffer where the superblock data is stored
  *
  *  \return <tt>0 (zero)</tt>, on success
@@ -93,24 +106,31 @@ int soDeplete (SOSuperBlock *p_sb)
     uint32_t cycle;
     uint32_t nBlk;
     uint32_t offset;
+    uint32_t len;   /* number of references moved into the block */
+    uint32_t k;
     uint32_t *ref;
     uint32_t error_status;
 
     index = p_sb->tbfreeclust_tail;
 
-    for ( cycle = 0; cycle < p_sb->dzone_insert.cache_idx; cycle++ )
+    for ( cycle = 0; cycle < p_sb->dzone_insert.cache_idx; cycle += len )
     {
         if ( (error_status = soConvertRefFCT(index, &nBlk, &offset)) != 0 ) return error_status;
+        /* as many as there are left, up to the end of the block or of the table */
+        len = p_sb->dzone_insert.cache_idx - cycle;
+        if ( len > RPB - offset ) len = RPB - offset;
+        if ( len > p_sb->dzone_total - index ) len = p_sb->dzone_total - index;
         if ( (error_status = soLoadBlockFCT(nBlk)) != 0 ) return error_status;
         if ( (ref = soGetBlockFCT()) == NULL ) return -EIO;
 
-
-        ref[offset] = p_sb->dzone_insert.cache[cycle];
-        p_sb -> dzone_insert.cache[cycle] = NULL_CLUSTER;
-        index = (index + 1) % p_sb -> dzone_total;
+        for ( k = 0; k < len; k++ )
+        {
+            ref[offset + k] = p_sb->dzone_insert.cache[cycle + k];
+            p_sb -> dzone_insert.cache[cycle + k] = NULL_CLUSTER;
+        }
+        index = (index + len) % p_sb -> dzone_total;
 
         if ( (error_status = soStoreBlockFCT()) != 0 ) return error_status;
-
     }
 
     p_sb -> dzone_insert.cache_idx = 0;
@@ -9,6 +9,7 @@
  *      \li read a specific data cluster
  *      \li write to a specific data cluster
  *      \li handle a file data cluster
+ *      \li allocate the data clusters of a range of a file which have not been allocated yet
  *      \li free all data clusters from the list of references starting at a given point.
  *
  *  \author Artur Carneiro Pereira September 2008
@@ -135,6 +136,37 @@ extern int soWriteFileCluster (uint32_t nInode, uint32_t clustInd, void *buff);
 
 extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32_t *p_outVal);
 
+/**
+ *  \brief Allocate the data clusters of a range of a file which have not been allocated yet.
+ *
+ *  The file (a regular file, a directory or a symlink) is described by the inode it is associated to.
+ *
+ *  It is meant to be called before a write extends a file by several data clusters: the data clusters which are missing
+ *  are allocated all at once, in runs as long as possible starting next to the data cluster which precedes the first
+ *  of them in the file, and are then associated to the file in succession, the clusters of references which may be
+ *  needed included. The data clusters of the file are thus laid out contiguously in the data zone, as far as possible.
+ *
+ *  If there are not enough free data clusters to allocate all of them at once, none is allocated and nothing is done:
+ *  the data clusters are then allocated one at a time as they are written, until there are no more.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references belonging to the inode of the first data cluster of the range
+ *  \param count number of data clusters of the range
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range
+ *  \return -\c ENOMEM, if there is not enough memory
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soAllocFileClusters (uint32_t nInode, uint32_t clustInd, uint32_t count);
+
 /**
  *  \brief Handle all data clusters from the list of references starting at a given point.
  *
@@ -0,0 +1,160 @@
+/**
+ *  \file soAllocFileClusters.c (implementation file)
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_ifuncs_1.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+
+/* Allusion to external function */
+
+uint32_t soSupplyFileClusters (uint32_t *list, uint32_t n);
+
+/* Allusion to internal function */
+
+static int soFindMissingClusters (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t count, uint32_t *ind,
+                                  uint32_t *p_nMiss, uint32_t *p_goal);
+
+/**
+ *  \brief Allocate the data clusters of a range of a file which have not been allocated yet.
+ *
+ *  The file (a regular file, a directory or a symlink) is described by the inode it is associated to.
+ *
+ *  It is meant to be called before a write extends a file by several data clusters: the data clusters which are missing
+ *  are allocated all at once, in runs as long as possible starting next to the data cluster which precedes the first
+ *  of them in the file, and are then associated to the file in succession, the clusters of references which may be
+ *  needed included. The data clusters of the file are thus laid out contiguously in the data zone, as far as possible.
+ *
+ *  If there are not enough free data clusters to allocate all of them at once, none is allocated and nothing is done:
+ *  the data clusters are then allocated one at a time as they are written, until there are no more.
+ *
+ *  The contents of the data clusters are not cleared, so the range must be one the caller is going to overwrite
+ *  completely. A data cluster which is only partially written must be left to be allocated as it is written.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references belonging to the inode of the first data cluster of the range
+ *  \param count number of data clusters of the range
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range
+ *  \return -\c ENOMEM, if there is not enough memory
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soAllocFileClusters (uint32_t nInode, uint32_t clustInd, uint32_t count)
+{
+  soColorProbe (415, "07;31", "soAllocFileClusters (%"PRIu32", %"PRIu32", %"PRIu32")\n", nInode, clustInd, count);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOInode inode;                                 /* inode associated to the file */
+  uint32_t *list;                                /* logical numbers of the data clusters allocated beforehand */
+  uint32_t *ind;                                 /* indexes to the list of direct references which are missing */
+  uint32_t nMiss = 0;                            /* number of data clusters which are missing */
+  uint32_t goal = NULL_CLUSTER;                  /* logical number of the data cluster where the search starts */
+  uint32_t nClust;                               /* logical number of a data cluster of the file */
+  uint32_t n;                                    /* index to the list of missing data clusters */
+  uint32_t left;                                 /* number of data clusters which were not taken */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if ((p_sb = soGetSuperBlock ()) == NULL) return -EIO;
+  if ((nInode >= p_sb->itotal) || (count == 0) || (clustInd >= MAX_FILE_CLUSTERS) ||
+      (count > MAX_FILE_CLUSTERS - clustInd))
+     return -EINVAL;
+
+  /* find the missing data clusters */
+
+  if (count < 2) return 0;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+  if ((list = malloc (2 * count * sizeof (uint32_t))) == NULL) return -ENOMEM;
+  ind = list + count;
+  if (((stat = soFindMissingClusters (nInode, &inode, clustInd, count, ind, &nMiss, &goal)) != 0) || (nMiss < 2))
+     { free (list);
+       return stat;
+     }
+  if (goal != NULL_CLUSTER) goal %= p_sb->dzone_total;
+
+  /* allocate them all at once and associate them to the file */
+
+  if ((stat = soAllocDataClusters (nMiss, goal, list)) != 0)
+     { free (list);
+       return (stat == -ENOSPC) ? 0 : stat;
+     }
+  soSupplyFileClusters (list, nMiss);
+  for (n = 0; n < nMiss; n++)
+    if ((stat = soHandleFileCluster (nInode, ind[n], ALLOC, &nClust)) != 0) break;
+
+  /* the data clusters which were not taken, if any, are freed */
+
+  for (left = soSupplyFileClusters (NULL, 0); left > 0; left--)
+    soFreeDataCluster (list[nMiss - left]);
+  free (list);
+
+  return stat;
+}
+
+/**
+ *  \brief Find the data clusters of a range of a file which have not been allocated yet.
+ *
+ *  The search for free data clusters should start next to the data cluster which precedes the first of them in the
+ *  file. If the data cluster which precedes the range is missing too, room is left for it, since it is going to be
+ *  allocated when it is written.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to the contents of the inode associated to the file
+ *  \param clustInd index to the list of direct references of the first data cluster of the range
+ *  \param count number of data clusters of the range
+ *  \param ind pointer to the array where the indexes of the missing data clusters are to be stored
+ *  \param p_nMiss pointer to the location where the number of missing data clusters is to be stored
+ *  \param p_goal pointer to the location where the logical number of the data cluster where the search should start
+ *                is to be stored (\c NULL_CLUSTER, if there is none)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>error</em>, issued by soMapFileCluster
+ */
+
+static int soFindMissingClusters (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t count, uint32_t *ind,
+                                  uint32_t *p_nMiss, uint32_t *p_goal)
+{
+  uint32_t nClust;                               /* logical number of a data cluster of the file */
+  uint32_t k;                                    /* index to the list of direct references */
+  int stat;                                      /* status of operation */
+
+  *p_nMiss = 0;
+  *p_goal = NULL_CLUSTER;
+  if (clustInd > 0)
+     { if ((stat = soMapFileCluster (nInode, p_inode, clustInd - 1, &nClust)) != 0) return stat;
+       if (nClust != NULL_CLUSTER)
+          *p_goal = nClust + 1;
+          else if (clustInd > 1)
+                  { if ((stat = soMapFileCluster (nInode, p_inode, clustInd - 2, &nClust)) != 0) return stat;
+                    if (nClust != NULL_CLUSTER) *p_goal = nClust + 2;
+                  }
+     }
+  for (k = clustInd; k < clustInd + count; k++)
+  { if ((stat = soMapFileCluster (nInode, p_inode, k, &nClust)) != 0) return stat;
+    if (nClust == NULL_CLUSTER)
+       ind[(*p_nMiss)++] = k;
+       else if (*p_nMiss == 0) *p_goal = nClust + 1;
+  }
+
+  return 0;
+}
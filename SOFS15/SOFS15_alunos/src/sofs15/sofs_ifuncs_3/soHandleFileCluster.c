@@ -10,6 +10,7 @@
 
 #include "sofs_probe.h"
 #include "sofs_buffercache.h"
+#include "sofs_context.h"
 #include "sofs_superblock.h"
 #include "sofs_inode.h"
 #include "sofs_datacluster.h"
@@ -26,8 +27,30 @@
 /** \brief operation free the referenced data cluster and dissociate it from the inode which describes the file */
 #define FREE        2
 
+/** \brief State of the allocation of the data clusters of files (one per SOFS context) */
+
+typedef struct
+{ /** \brief data clusters allocated beforehand, which ALLOC takes before allocating new ones */
+    uint32_t *supply;
+  /** \brief number of data clusters left in the supply */
+    uint32_t nSupply;
+  /** \brief logical number of the data cluster where the search for the next one ALLOC takes starts */
+    uint32_t goal;
+} SOFileClustState;
+
+/** \brief State of the allocation of the data clusters of files in the default context */
+static SOFileClustState defState;
+
+/** \brief State of the allocation of the data clusters of files in the context bound to the calling thread */
+#define FC  ((SOFileClustState *) CTX_STATE (CTX_FILECLUST))
+
+/** \brief number of data clusters ALLOC may take: the free ones and the ones left in the supply */
+#define AVAIL_CLUSTERS(p_sb)  ((p_sb)->dzone_free + FC->nSupply)
+
 /* Allusion to internal functions */
 
+static int soTakeDataCluster (uint32_t *p_nClust);
+static void soInitState (void *state);
 int soHandleDirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t nClust, uint32_t op, uint32_t *p_outVal);
 int soHandleSIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t nClust, uint32_t op, uint32_t *p_outVal);
 int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t nClust, uint32_t op, uint32_t *p_outVal);
@@ -96,20 +119,31 @@ int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32
 	if (op == FREE) { p_outVal = NULL; }
 	/*---------------------	Consistency	---------------------*/
 	/* INode table */
-	if ((error_status = soQCheckInT(p_sb)) != 0 ) { return error_status; }
+	if ((error_status = soQCheck(QC_INT)) != 0 ) { return error_status; }
 	/* data zone */
-	if ((error_status = soQCheckDZ(p_sb)) != 0 ) { return error_status; }
+	if ((error_status = soQCheck(QC_DZ)) != 0 ) { return error_status; }
 	/*---------------------	Code		---------------------*/
+	/* ALLOC places the data cluster right after the one which precedes it in the file and the clusters of references
+	   it may need just before it, or as near as possible */
+	if (op == ALLOC)
+	{
+		FC->goal = NULL_CLUSTER;
+		if (clustInd > 0) { if ((error_status = soMapFileCluster(nInode, &iNode, clustInd - 1, &FC->goal)) != 0 ) { return error_status; } }
+		if (FC->goal != NULL_CLUSTER) { FC->goal = (FC->goal + 1) % p_sb -> dzone_total; }
+	}
+	/* GET is translated through the cache of file maps; ALLOC and FREE change the references, so the file leaves it */
+	if (op == GET) { if ((error_status = soMapFileCluster(nInode, &iNode, clustInd, p_outVal)) != 0 ) { return error_status; } }
+	else if ((error_status = soForgetFileMap(nInode)) != 0 ) { return error_status; }
 	/* Direct reference */
-	if (clustInd < N_DIRECT) { if ((error_status = soHandleDirect(p_sb, &iNode, clustInd, op, p_outVal)) != 0 ) { return error_status; } }
+	else if (clustInd < N_DIRECT) { if ((error_status = soHandleDirect(p_sb, &iNode, clustInd, op, p_outVal)) != 0 ) { return error_status; } }
 	/* Single indirect reference */
 	else if (clustInd < (N_DIRECT + RPC)) { if ((error_status = soHandleSIndirect(p_sb, &iNode, clustInd, op, p_outVal)) != 0 ) { return error_status; } }
 	/* Double indirect reference */
 	else { if ((error_status = soHandleDIndirect(p_sb, &iNode, clustInd, op, p_outVal)) != 0 ) { return error_status; } }
 	/* Writes the inode */
 	if ((error_status = soWriteInode(&iNode, nInode)) != 0 ) { return error_status; }
-	/* Stores the SuperBlock */
-	if ((error_status = soStoreSuperBlock()) != 0 ) { return error_status; }
+	/* Stores the SuperBlock (GET does not change it) */
+	if (op != GET) { if ((error_status = soStoreSuperBlock()) != 0 ) { return error_status; } }
 	return 0;
 }
 
@@ -148,9 +182,9 @@ int soHandleDirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd, uin
         
         if(p_inode->d[clustInd]==NULL_CLUSTER)
         {
-            if(p_sb->dzone_free == 0) return -ELIBBAD;
+            if(AVAIL_CLUSTERS(p_sb) == 0) return -ELIBBAD;
 
-            if( (status = soAllocDataCluster(p_outVal)) != 0 ) return status;
+            if( (status = soTakeDataCluster(p_outVal)) != 0 ) return status;
 
             p_inode->d[clustInd] = *p_outVal;
         
@@ -236,8 +270,8 @@ int soHandleSIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
 			if (p_inode -> i1 == NULL_CLUSTER)
 			{
 				/* Checks if there are 2 free dataClusters */
-				if (p_sb -> dzone_free <= 1) { return -ENOSPC; }
-				if ((error_status = soAllocDataCluster(p_outVal)) != 0 ) { return error_status; }
+				if (AVAIL_CLUSTERS(p_sb) <= 1) { return -ENOSPC; }
+				if ((error_status = soTakeDataCluster(p_outVal)) != 0 ) { return error_status; }
 				/* Puts in the reference to the cluster and increments the cluster count associated to inode */
 				p_inode -> i1 = *p_outVal; p_inode -> clucount++;
 				/* Loads the content of the cluster */
@@ -248,7 +282,7 @@ int soHandleSIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
 				/* Stores the cluster */
 				if ((error_status = soStoreDirRefClust()) != 0 ) { return error_status; }
 				/* Allocates the data cluster in use */
-				if ((error_status = soAllocDataCluster(p_outVal)) != 0 ) { return error_status; }
+				if ((error_status = soTakeDataCluster(p_outVal)) != 0 ) { return error_status; }
 				/* Loads the content of the references cluster */
 				if ((error_status = soLoadDirRefClust(p_sb -> dzone_start + BLOCKS_PER_CLUSTER * p_inode -> i1)) != 0 ) { return error_status; }
 				if ((p_dc = soGetDirRefClust()) == NULL) { return -EIO; }
@@ -259,7 +293,7 @@ int soHandleSIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
 			}
 			else
 			{
-				if (p_sb -> dzone_free <= 0) { return -ENOSPC; }
+				if (AVAIL_CLUSTERS(p_sb) <= 0) { return -ENOSPC; }
 				/* Loads the content of the references cluster */
 				if ((error_status = soLoadDirRefClust(p_sb -> dzone_start + BLOCKS_PER_CLUSTER * p_inode -> i1)) != 0 ) { return error_status; }
 				if ((p_dc = soGetDirRefClust()) == NULL) { return -EIO; }
@@ -267,7 +301,7 @@ int soHandleSIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
 				if (p_dc -> ref[rel_position] == NULL_CLUSTER)
 				{
 					/* Allocates one */
-					if ((error_status = soAllocDataCluster(p_outVal)) != 0 ) { return error_status; }
+					if ((error_status = soTakeDataCluster(p_outVal)) != 0 ) { return error_status; }
 					/* Puts in the reference to the cluster and increments the cluster count associated to inode */
 					p_dc -> ref[rel_position] = *p_outVal; p_inode -> clucount++;
 					/* Stores the cluster */
@@ -388,12 +422,12 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
       if (p_inode->i2 == NULL_CLUSTER)
       {
           //e preciso 3 DC para guardar
-          if(p_sb->dzone_free <= 2)
+          if(AVAIL_CLUSTERS(p_sb) <= 2)
             return -ENOSPC; 
           
         
         //alocar um DC para criar a tabela de refs indirectas e mete tudo a NULL-CLUSER
-        if ((status = soAllocDataCluster(p_outVal)) != 0) return status;                
+        if ((status = soTakeDataCluster(p_outVal)) != 0) return status;                
         
           p_inode->i2=*p_outVal;
           p_inode->clucount++;
@@ -411,7 +445,7 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
           
         //aloca um DC para criar a tabela de refs directas e mete o valor desse DC na posicao certa (ind_DInd)
         //na tabela de refs indirctas duplas
-        if((status=soAllocDataCluster(&tmp_clust))!=0)               
+        if((status=soTakeDataCluster(&tmp_clust))!=0)               
         { if(status == -ENOSPC )
           return status;
         }
@@ -445,7 +479,7 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
         
         
         //alloc um DC para lá guardar a tabela de refs directas
-        if((status=soAllocDataCluster(p_outVal))!=0)
+        if((status=soTakeDataCluster(p_outVal))!=0)
           return status;
         
         p_inode -> clucount++;
@@ -473,7 +507,7 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
       }
       else
       { 
-          if(p_sb->dzone_free <= 1 )return -ENOSPC;
+          if(AVAIL_CLUSTERS(p_sb) <= 1 )return -ENOSPC;
         
         
         if((status=soLoadSngIndRefClust(p_inode->i2* BLOCKS_PER_CLUSTER + (p_sb->dzone_start)))!=0)
@@ -488,7 +522,7 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
         { 
           if((status=soStoreSngIndRefClust())!=0)  return status;
           
-          if((status=soAllocDataCluster(p_outVal))!=0) return status;           
+          if((status=soTakeDataCluster(p_outVal))!=0) return status;           
           tmp_clust= *p_outVal;
           
           p_inode -> clucount++;
@@ -519,7 +553,7 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
           
           
           //aloca um dc para la guardar a tabela de refs directas
-          if((status=soAllocDataCluster(p_outVal))!=0)  return status;
+          if((status=soTakeDataCluster(p_outVal))!=0)  return status;
             
           
           p_inode -> clucount++;
@@ -555,7 +589,7 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
           if((status=soStoreSngIndRefClust())!=0)  return status;
           
           
-          if((status=soAllocDataCluster(p_outVal))!=0)  return status;  
+          if((status=soTakeDataCluster(p_outVal))!=0)  return status;  
           
           p_inode -> clucount++;
           
@@ -670,3 +704,76 @@ int soHandleDIndirect (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd,
   return 0;
 
 }
+
+/**
+ *  \brief Hand over to ALLOC a supply of data clusters allocated beforehand.
+ *
+ *  Until the supply is exhausted, or replaced, every data cluster ALLOC needs in the context bound to the calling
+ *  thread, be it the one which is being associated to the file or a cluster of references, is taken from it in turn.
+ *
+ *  \param list pointer to the array of logical numbers of the data clusters (\c NULL, to withdraw the supply)
+ *  \param n number of data clusters
+ *
+ *  \return the number of data clusters left in the previous supply, which were not taken (they are the last ones)
+ */
+
+uint32_t soSupplyFileClusters (uint32_t *list, uint32_t n)
+{
+  uint32_t left = FC->nSupply;
+
+  FC->supply = list;
+  FC->nSupply = (list != NULL) ? n : 0;
+
+  return left;
+}
+
+/**
+ *  \brief Take a data cluster for ALLOC: from the supply, if it is not exhausted, or a newly allocated one, the nearest
+ *         free one from the goal on.
+ *
+ *  The goal is moved to the data cluster which follows it, so that the clusters ALLOC takes in a row are contiguous,
+ *  as far as possible.
+ *
+ *  \param p_nClust pointer to the location where the logical number of the data cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>error</em> issued by soAllocDataClusters, otherwise
+ */
+
+static int soTakeDataCluster (uint32_t *p_nClust)
+{
+  int stat;
+
+  if (FC->nSupply == 0)
+     { if ((stat = soAllocDataClusters (1, FC->goal, p_nClust)) != 0) return stat; }
+     else { *p_nClust = *FC->supply++;
+            FC->nSupply--;
+          }
+  FC->goal = *p_nClust + 1;
+
+  return 0;
+}
+
+/**
+ *  \brief Set up the state of the allocation of the data clusters of files in a context.
+ *
+ *  \param state pointer to the state
+ */
+
+static void soInitState (void *state)
+{
+  SOFileClustState *fc = state;                  /* pointer to the state */
+
+  fc->supply = NULL;
+  fc->nSupply = 0;
+  fc->goal = NULL_CLUSTER;
+}
+
+/**
+ *  \brief Register the state of the allocation of the data clusters of files, before <tt>main</tt> is called.
+ */
+
+static void __attribute__ ((constructor)) soRegisterState (void)
+{
+  soRegisterContextState (CTX_FILECLUST, sizeof (SOFileClustState), soInitState, &defState);
+}
@@ -13,6 +13,7 @@
 
 #include "sofs_probe.h"
 #include "sofs_buffercache.h"
+#include "sofs_context.h"
 #include "sofs_superblock.h"
 #include "sofs_inode.h"
 #include "sofs_direntry.h"
@@ -29,14 +30,24 @@ int soGetDirEntryByName (uint32_t nInodeDir, const char *eName, uint32_t *p_nIno
 /* Allusion to internal function */
 
 static int soTraversePath (const char *ePath, uint32_t *p_nInodeDir, uint32_t *p_nInodeEnt);
+static void soInitState (void *state);
 
-/** \brief Number of symbolic links in the path */
+/** \brief State of the path traversal (one per SOFS context) */
 
-static uint32_t nSymLinks = 0;
+typedef struct
+{ /** \brief Number of symbolic links in the path */
+    uint32_t nSymLinks;
+  /** \brief Old directory inode number */
+    uint32_t oldNInodeDir;
+} SODirPathState;
 
-/** \brief Old directory inode number */
+/** \brief State of the path traversal in the default context */
 
-static uint32_t oldNInodeDir = 0;
+static SODirPathState defState;
+
+/** \brief State of the path traversal in the context bound to the calling thread */
+
+#define DP  ((SODirPathState *) CTX_STATE (CTX_DIRPATH))
 
 /**
  *  \brief Get an entry by path.
@@ -177,8 +188,8 @@ static int soTraversePath (const char *ePath, uint32_t *p_nInodeDir, uint32_t *p
 	}
 	else{	// verifica se o atalho encontrado não é o primeiro
 		
-		if (nSymLinks>=1){
-			nSymLinks=0;
+		if (DP->nSymLinks>=1){
+			DP->nSymLinks=0;
 			return -ELOOP;
 		}
 
@@ -196,12 +207,12 @@ static int soTraversePath (const char *ePath, uint32_t *p_nInodeDir, uint32_t *p
 		else
 			strncpy(path,data,MAX_PATH+1);	// se for path absoluto, o novo path é o nome do atalho
 	
-		nSymLinks = 1;
+		DP->nSymLinks = 1;
 		// recursividade com o novo path do atalho
 		if ((status = soTraversePath(path, &nInodeDir, &nInodeEnt)) != 0) return status;	
 	
 		// fim da recursividade, reset do counter de atalhos.
-		nSymLinks = 0;
+		DP->nSymLinks = 0;
 	}
 
 	if ( p_nInodeDir != NULL)  *p_nInodeDir = nInodeDir;	//numero do inode para o diretorio pai
@@ -209,3 +220,26 @@ static int soTraversePath (const char *ePath, uint32_t *p_nInodeDir, uint32_t *p
 
 	return 0;
 }
+
+/**
+ *  \brief Set up the state of the path traversal in a context.
+ *
+ *  \param state pointer to the state
+ */
+
+static void soInitState (void *state)
+{
+  SODirPathState *dp = state;                    /* pointer to the state */
+
+  dp->nSymLinks = 0;
+  dp->oldNInodeDir = 0;
+}
+
+/**
+ *  \brief Register the state of the path traversal, before <tt>main</tt> is called.
+ */
+
+static void __attribute__ ((constructor)) soRegisterState (void)
+{
+  soRegisterContextState (CTX_DIRPATH, sizeof (SODirPathState), soInitState, &defState);
+}
@@ -17,6 +17,12 @@
 
 #include "sofs_const.h"
 
+/* the prebuilt binary libraries every program that operates on the file system is linked with are compiled for the
+   default geometry */
+#if (BLOCK_SIZE != DEF_BLOCK_SIZE) || (BLOCKS_PER_CLUSTER != DEF_BLOCKS_PER_CLUSTER)
+#error "the file system supports only the default geometry while it is linked with the prebuilt binary libraries"
+#endif
+
 /** \brief sofs15 magic number */
 #define MAGIC_NUMBER (0x65FE)
 
@@ -35,9 +41,27 @@
 /** \brief reference to a null data block */
 #define NULL_BLOCK ((uint32_t)(~0UL))
 
-/** \brief size of cache */
+/** \brief filler of the reserved area of the superblock */
+#define RESERVED_FILL (0xEE)
+
+/** \brief value of the geometry fields of a storage device formatted before the geometry was recorded */
+#define NO_GEOMETRY (0xEEEEEEEEU)
+
+/** \brief free data clusters tracked by the table of references to free data clusters, fronted by the caches */
+#define FC_TABLE 0
+
+/** \brief free data clusters tracked by a bitmap with a summary level (see sofs_bitmap.h) */
+#define FC_BITMAP 1
+
+/** \brief size of cache (the largest number of references a cache may be set to hold) */
 #define DZONE_CACHE_SIZE  (50)
 
+/** \brief number of references the caches of a file system hold: the value set when it was formatted, if it is in
+ *         range, or else <tt>DZONE_CACHE_SIZE</tt>; the retrieval cache is filled at its upper end and the insertion
+ *         cache at its lower end */
+#define DZ_CACHE_SIZE(p_sb) ((((p_sb)->dzcache_size >= 1) && ((p_sb)->dzcache_size <= DZONE_CACHE_SIZE)) ? \
+                             (p_sb)->dzcache_size : DZONE_CACHE_SIZE)
+
 /**
  *  \brief Definition of the reference cache data type.
  *
@@ -70,7 +94,12 @@ struct fCNode
  *         storage of references (static structures resident within the superblock itself) and the location and size in
  *         number of blocks of the table of references to free data clusters, organized as a static linear FIFO that
  *         links together all the free data clusters whose references are not in the caches - the insertion and retrieval
- *         points are also provided.
+ *         points are also provided
+ *     \li <em>geometry</em> - the block size and the number of blocks in a cluster the file system was formatted with
+ *     \li <em>format of the free data clusters metadata</em> - whether the free data clusters are tracked by the table
+ *         of references and the caches, or by a bitmap; in the latter case, the bitmap takes the place of the table of
+ *         references, the caches are kept empty and the point of retrieval of the table is where the next search for a
+ *         free data cluster starts.
  */
 
 typedef struct soSuperBlock
@@ -128,10 +157,24 @@ typedef struct soSuperBlock
    /** \brief number of free data clusters */
     uint32_t dzone_free;
 
+  /* Geometry */
+   /** \brief block size in bytes (should be BLOCK_SIZE macro value); a storage device formatted before the geometry
+    *         was recorded holds here the filler of the reserved area and is taken as having the default geometry */
+    uint32_t bsize;
+   /** \brief number of blocks in a cluster (should be BLOCKS_PER_CLUSTER macro value) */
+    uint32_t bpc;
+  /* Format of the free data clusters metadata */
+   /** \brief FC_TABLE or FC_BITMAP; a storage device formatted before the format was recorded holds here the filler of
+    *         the reserved area and is taken as having a table of references */
+    uint32_t fcformat;
+   /** \brief number of references the caches hold (see DZ_CACHE_SIZE); a storage device formatted before it was
+    *         recorded holds here the filler of the reserved area and is taken as having caches of the full size */
+    uint32_t dzcache_size;
+
   /* Padded area to ensure superblock structure is BLOCK_SIZE bytes long */
 
    /** \brief reserved area */
-    unsigned char reserved[BLOCK_SIZE - PARTITION_NAME_SIZE - 1 - 16 * sizeof(uint32_t) - 2 * sizeof(struct fCNode)];
+    unsigned char reserved[BLOCK_SIZE - PARTITION_NAME_SIZE - 1 - 20 * sizeof(uint32_t) - 2 * sizeof(struct fCNode)];
 } SOSuperBlock;
 
 #endif /* SOFS_SUPERBLOCK_H_ */
@@ -72,6 +72,10 @@ int soWrite (const char *ePath, void *buff, uint32_t count, int32_t pos)
   uint32_t nInodeEnt;     //inode associado a entry
   uint32_t clustInd;      //posicao do primeiro byte a escrever na tabela de referncias
   uint32_t offset;        //byte dentro do cluster de dados a escrever
+  uint32_t lastInd;       //posicao do ultimo byte a escrever na tabela de referencias
+  uint32_t lastOff;       //byte dentro do ultimo cluster de dados a escrever
+  uint32_t firstFull;     //primeiro cluster de dados escrito por completo
+  uint32_t endFull;       //cluster de dados seguinte ao ultimo escrito por completo
   SOInode *p_Inode;       //ponteiro para o inode a modificar 
   SOSuperBlock *p_sb;     //ponteiro para o superbloco 
   char buff_temp[BSLPC];  //buffer contendo os bytes do cluster
@@ -118,6 +122,19 @@ int soWrite (const char *ePath, void *buff, uint32_t count, int32_t pos)
   if((error = soConvertBPIDC(pos, &clustInd, &offset))!=0)
     return error;
 
+  //se a escrita abrange varios clusters completos, os que faltam sao alocados de uma vez, contiguos tanto quanto possivel;
+  //os clusters escritos so em parte sao alocados quando sao escritos, para que o resto fique a zero
+  if(count>0)
+  {
+    if((error = soConvertBPIDC(pos+count-1, &lastInd, &lastOff))!=0)
+      return error;
+    firstFull = (offset==0) ? clustInd : clustInd+1;
+    endFull = (lastOff==BSLPC-1) ? lastInd+1 : lastInd;
+    if(endFull>firstFull)
+      if((error = soAllocFileClusters(nInodeEnt, firstFull, endFull-firstFull))!=0)
+        return error;
+  }
+
   if((error=soReadFileCluster(nInodeEnt, clustInd, &buff_temp))!=0)
     return error;
 
@@ -0,0 +1,836 @@
+/**
+ *  \file sofs_syscalls.c (implementation file)
+ *
+ *  \brief Set of operations to manage system calls: the ones that need no changes to the directory hierarchy.
+ *
+ *  The operations are:
+ *      \li mount the SOFS15 file system
+ *      \li unmount the SOFS15 file system
+ *      \li get file system statistics
+ *      \li get file status
+ *      \li check real user's permissions for a file
+ *      \li change permissions of a file
+ *      \li change the ownership of a file
+ *      \li change the last access and modification times of a file
+ *      \li change the last access and modification times of a file with nanosecond resolution
+ *      \li open a regular file
+ *      \li close a regular file
+ *      \li synchronize a file's in-core state with storage device
+ *      \li open a directory for reading
+ *      \li close a directory.
+ *
+ *  \author Artur Carneiro Pereira September 2007
+ *  \author Miguel Oliveira e Silva September 2009
+ *  \author António Rui Borges - October 2010 / October 2015
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/statvfs.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <utime.h>
+#include <libgen.h>
+#include <string.h>
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_ifuncs_1.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_ifuncs_4.h"
+#include "sofs_syscalls.h"
+
+/* Path of the Linux file that simulates the storage device */
+
+static char devName[MAX_PATH+1];
+
+/**
+ *  \brief Mount the SOFS15 file system.
+ *
+ *  A communication channel is established with the storage device.
+ *  The superblock is read and it is checked if the file system was properly unmounted the last time it was mounted. If
+ *  not, a quick consistency check of the superblock is performed through soQCheck, so that it suits the format of the
+ *  table of free data clusters (presently, the check is superficial, a more thorough one is required).
+ *
+ *  \param devname absolute path to the Linux file that simulates the storage device
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if if the pointer to <em>device path</em> is \c NULL or is a \c NULL string or the magic number
+ *                      is not the one characteristic of SOFS15
+ *  \return -\c ENAMETOOLONG, if the absolute path exceeds the maximum allowed length
+ *  \return -\c EBUSY, if the storage area is already in use or the device is already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soMountSOFS (const char *devname)
+{
+  soColorProbe (211, "07;31", "soMountSOFS (\"%s\")\n", devname);
+
+  int stat;                                      /* status of operation */
+  SOSuperBlock *p_sb;                            /* pointer to the superblock data buffer */
+
+  if ((devname == NULL) || (devname[0] == '\0')) return -EINVAL;
+  if (strlen (devname) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soOpenBufferCache (devname, UNBUF)) != 0) return stat;
+  strncpy (devName, devname, MAX_PATH);
+  devName[MAX_PATH] = '\0';
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+  if (p_sb->magic != MAGIC_NUMBER) return -EINVAL;
+  if ((p_sb->mstat != PRU) && (soQCheck (QC_SUPERBLOCK) != 0)) return -ELIBBAD;
+
+  p_sb->mstat = NPRU;
+  if ((stat = soStoreSuperBlock ()) != 0) return stat;
+
+  return soFlushCacheBlock (0, p_sb);
+}
+
+/**
+ *  \brief Unmount the SOFS15 file system.
+ *
+ *  The communication channel previously established with the storage device is closed. This means, namely, that the
+ *  contents of the storage area is flushed into the storage device to keep data update. Before that, however, the mount
+ *  flag of the superblock is set to <em>properly unmounted</em>.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soUnmountSOFS (void)
+{
+  soColorProbe (212, "07;31", "soUnmountSOFS ()\n");
+
+  int stat;                                      /* status of operation */
+  SOSuperBlock *p_sb;                            /* pointer to the superblock data buffer */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+  p_sb->mstat = PRU;
+  if ((stat = soStoreSuperBlock ()) != 0) return stat;
+
+  return soCloseBufferCache ();
+}
+
+/**
+ *  \brief Get file system statistics.
+ *
+ *  It tries to emulate <em>statvfs</em> system call.
+ *
+ *  Information about a mounted file system is returned.
+ *  It checks whether the calling process can access the file specified by the path.
+ *
+ *  \param ePath path to any file within the mounted file system
+ *  \param st pointer to a statvfs structure
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers are \c NULL or the path string is a \c NULL string or the path does not
+ *                      describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT,  if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soStatFS (const char *ePath, struct statvfs *st)
+{
+  soColorProbe (213, "07;31", "soStatFS (\"%s\", %p)\n", ePath, st);
+
+  int stat;                                      /* status of operation */
+  SOSuperBlock *p_sb;                            /* pointer to the superblock data buffer */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+  if (st == NULL) return -EINVAL;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, NULL)) != 0) return stat;
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  memset (st, 0, sizeof (struct statvfs));
+  st->f_bsize = CLUSTER_SIZE;                    /* file system block size */
+  st->f_frsize = BLOCK_SIZE;                     /* fragment size */
+  st->f_blocks = p_sb->dzone_total;              /* size of file system in f_frsize units */
+  st->f_bfree = p_sb->dzone_free;                /* number of free blocks */
+  st->f_bavail = st->f_bfree;                    /* number of free blocks for non-root */
+  st->f_files = p_sb->itotal;                    /* number of inodes */
+  st->f_ffree = p_sb->ifree;                     /* number of free inodes */
+  st->f_favail = st->f_ffree;                    /* number of free inodes for non-root */
+  st->f_fsid = p_sb->magic;                      /* file system ID */
+  st->f_namemax = MAX_NAME;                      /* maximum filename length */
+
+  return 0;
+}
+
+/**
+ *  \brief Get file status.
+ *
+ *  It tries to emulate <em>stat</em> system call.
+ *
+ *  Information about a specific file is returned.
+ *  It checks whether the calling process can access the file specified by the path.
+ *
+ *  \param ePath path to the file
+ *  \param st pointer to a stat structure
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers are \c NULL  or the path string is a \c NULL string or the path does not
+ *                      describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT,  if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soStat (const char *ePath, struct stat *st)
+{
+  soColorProbe (214, "07;31", "soStat (\"%s\", %p)\n", ePath, st);
+
+  int status;                                    /* status of operation */
+  char dPath[MAX_PATH+1],                        /* copy of the path to be split into its directory part */
+       bPath[MAX_PATH+1];                        /* copy of the path to be split into its last component */
+  char *dName, *bName;                           /* directory part and last component of the path */
+  uint32_t nInodeDir, nInodeEnt;                 /* inode numbers of the parent directory and of the entry */
+  SOInode inodeDir, inodeEnt;                    /* inodes of the parent directory and of the entry */
+  struct stat devStat;                           /* status of the Linux file that simulates the storage device */
+  mode_t mode;                                   /* type and permissions of the entry */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+  if (st == NULL) return -EINVAL;
+
+  strcpy (dPath, ePath);
+  dName = dirname (dPath);
+  strcpy (bPath, ePath);
+  bName = basename (bPath);
+  if (strlen (bName) > MAX_NAME) return -ENAMETOOLONG;
+
+  if ((status = soGetDirEntryByPath (dName, NULL, &nInodeDir)) != 0) return status;
+  if ((status = soReadInode (&inodeDir, nInodeDir)) != 0) return status;
+  if ((inodeDir.mode & INODE_TYPE_MASK) != INODE_DIR) return -ENOTDIR;
+  if ((status = soAccessGranted (nInodeDir, X)) != 0) return status;
+  if (strcmp (bName, "/") == 0) strcpy (bName, ".");
+  if ((status = soGetDirEntryByName (nInodeDir, bName, &nInodeEnt, NULL)) != 0) return status;
+  if ((status = soReadInode (&inodeEnt, nInodeEnt)) != 0) return status;
+  if ((status = stat (devName, &devStat)) != 0) return status;
+
+  mode = 0;
+  if (inodeEnt.mode & INODE_DIR) mode |= S_IFDIR;
+  if (inodeEnt.mode & INODE_FILE) mode |= S_IFREG;
+  if (inodeEnt.mode & INODE_SYMLINK) mode |= S_IFLNK;
+  if (inodeEnt.mode & INODE_RD_USR) mode |= S_IRUSR;
+  if (inodeEnt.mode & INODE_WR_USR) mode |= S_IWUSR;
+  if (inodeEnt.mode & INODE_EX_USR) mode |= S_IXUSR;
+  if (inodeEnt.mode & INODE_RD_GRP) mode |= S_IRGRP;
+  if (inodeEnt.mode & INODE_WR_GRP) mode |= S_IWGRP;
+  if (inodeEnt.mode & INODE_EX_GRP) mode |= S_IXGRP;
+  if (inodeEnt.mode & INODE_RD_OTH) mode |= S_IROTH;
+  if (inodeEnt.mode & INODE_WR_OTH) mode |= S_IWOTH;
+  if (inodeEnt.mode & INODE_EX_OTH) mode |= S_IXOTH;
+
+  memset (st, 0, sizeof (struct stat));
+  st->st_dev = devStat.st_dev;                   /* ID of device containing file */
+  st->st_ino = nInodeEnt;                        /* inode number */
+  st->st_mode = mode;                            /* protection */
+  st->st_nlink = inodeEnt.refcount;              /* number of hard links */
+  st->st_uid = inodeEnt.owner;                   /* user ID of owner */
+  st->st_gid = inodeEnt.group;                   /* group ID of owner */
+  st->st_size = inodeEnt.size;                   /* total size, in bytes */
+  st->st_blksize = CLUSTER_SIZE;                 /* blocksize for file system I/O */
+  st->st_blocks = inodeEnt.clucount;             /* number of data clusters allocated */
+  st->st_atime = inodeEnt.vD1.atime;             /* time of last access */
+  st->st_mtime = inodeEnt.vD2.mtime;             /* time of last modification */
+  st->st_ctime = st->st_mtime;                   /* time of last status change */
+
+  return 0;
+}
+
+/**
+ *  \brief Check real user's permissions for a file.
+ *
+ *  It tries to emulate <em>access</em> system call.
+ *
+ *  It checks whether the calling process can access the file specified by the path.
+ *
+ *  \param ePath path to the file
+ *  \param opRequested operation to be performed:
+ *                    F_OK (check if file exists)
+ *                    a bitwise combination of R_OK, W_OK, and X_OK
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path or no operation of the defined class is described
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT,  if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one, or the operation is denied
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soAccess (const char *ePath, int opRequested)
+{
+  soColorProbe (215, "07;31", "soAccess (\"%s\", %u)\n", ePath, opRequested);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  SOInode inode;                                 /* inode of the file */
+  uint32_t op;                                   /* operation to be checked */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+
+  op = 0;
+  if (opRequested & R_OK) op |= R;
+  if (opRequested & W_OK) op |= W;
+  if (opRequested & X_OK) op |= X;
+  if (op == 0) return 0;                         /* F_OK: the file exists */
+
+  return soAccessGranted (nInode, op);
+}
+
+/**
+ *  \brief Change permissions of a file.
+ *
+ *  It tries to emulate <em>chmod</em> system call.
+ *
+ *  It changes the permissions of a file specified by the path.
+ *
+ *  \remark If the file is a symbolic link, its contents shall always be used to reach the destination file, so the
+ *          permissions of a symbolic link can never be changed (they are set to rwx for <em>user</em>, <em>group</em>
+ *          and <em>other</em> when the link is created and remain unchanged thereafter).
+ *
+ *  \param ePath path to the file
+ *  \param mode permissions to be set:
+ *                    a bitwise combination of S_IRUSR, S_IWUSR, S_IXUSR, S_IRGRP, S_IWGRP, S_IXGRP, S_IROTH, S_IWOTH,
+                      S_IXOTH
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path or no mode of the defined class is described
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT,  if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c EPERM, if the process that calls the operation is neither the file's owner, nor is <em>root</em>
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soChmod (const char *ePath, mode_t mode)
+{
+  soColorProbe (216, "07;31", "soChmod (\"%s\", %u)\n", ePath, mode);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  SOInode inode;                                 /* inode of the file */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+  if ((mode & (S_IRWXU | S_IRWXG | S_IRWXO)) == 0) return -EINVAL;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+  if ((inode.owner != getuid ()) && (getuid () != 0)) return -EPERM;
+
+  inode.mode &= INODE_TYPE_MASK;
+  if (mode & S_IRUSR) inode.mode |= INODE_RD_USR;
+  if (mode & S_IWUSR) inode.mode |= INODE_WR_USR;
+  if (mode & S_IXUSR) inode.mode |= INODE_EX_USR;
+  if (mode & S_IRGRP) inode.mode |= INODE_RD_GRP;
+  if (mode & S_IWGRP) inode.mode |= INODE_WR_GRP;
+  if (mode & S_IXGRP) inode.mode |= INODE_EX_GRP;
+  if (mode & S_IROTH) inode.mode |= INODE_RD_OTH;
+  if (mode & S_IWOTH) inode.mode |= INODE_WR_OTH;
+  if (mode & S_IXOTH) inode.mode |= INODE_EX_OTH;
+
+  return soWriteInode (&inode, nInode);
+}
+
+/**
+ *  \brief Change the ownership of a file.
+ *
+ *  It tries to emulate <em>chown</em> system call.
+ *
+ *  It changes the ownership of a file specified by the path.
+ *
+ *  Only <em>root</em> may change the owner of a file. The file's owner may change the group if the specified group is
+ *  one of the owner's supplementary groups.
+ *
+ *  \param ePath path to the file
+ *  \param owner file user id (-1, if user is not to be changed)
+ *  \param group file group id (-1, if group is not to be changed)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT,  if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c EPERM, if the process that calls the operation is neither the file's owner, nor is <em>root</em>, nor
+ *                     the specified group is one of the owner's supplementary groups
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soChown (const char *ePath, uid_t owner, gid_t group)
+{
+  soColorProbe (217, "07;31", "soChown (\"%s\", %u, %u)\n", ePath, owner, group);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  SOInode inode;                                 /* inode of the file */
+  gid_t *groups;                                 /* supplementary groups of the calling process */
+  int nGroups, i;                                /* number of supplementary groups and index to them */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+
+  if (owner == inode.owner) owner = (uid_t) -1;
+  if ((owner != (uid_t) -1) && (getuid () != 0)) return -EPERM;
+  if (group == inode.group) group = (gid_t) -1;
+  if ((group != (gid_t) -1) && (inode.owner != getuid ()) && (getuid () != 0)) return -EPERM;
+  if ((group != (gid_t) -1) && (group != getgid ()))
+     { if ((nGroups = getgroups (0, NULL)) < 0) return -errno;
+       groups = malloc (nGroups * sizeof (gid_t));
+       if ((stat = getgroups (nGroups, groups)) < 0)
+          { free (groups);
+            return -errno;
+          }
+       for (i = 0; i < nGroups; i++)
+         if (groups[i] == group) break;
+       free (groups);
+       if (i == nGroups) return -EPERM;
+     }
+
+  if (owner != (uid_t) -1) inode.owner = owner;
+  if (group != (gid_t) -1) inode.group = group;
+
+  return soWriteInode (&inode, nInode);
+}
+
+/**
+ *  \brief Change the last access and modification times of a file.
+ *
+ *  It tries to emulate <em>utime</em> system call.
+ *
+ *  \param ePath path to the file
+ *  \param times pointer to a structure where the last access and modification times are passed, if \c NULL, the last
+ *               access and modification times are set to the current time
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT,  if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c EPERM, if the process that calls the operation is neither the file's owner, nor is <em>root</em>, or
+ *                     has not write permission
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soUtime (const char *ePath, const struct utimbuf *times)
+{
+  soColorProbe (218, "07;31", "soUtime (\"%s\", %p)\n", ePath, times);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  uint32_t nBlk, offset;                         /* block number and offset of the inode in the table of inodes */
+  SOInode *p_inode;                              /* pointer to the block of the table of inodes holding it */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soConvertRefInT (nInode, &nBlk, &offset)) != 0) return stat;
+  if ((stat = soLoadBlockInT (nBlk)) != 0) return stat;
+  p_inode = soGetBlockInT ();
+
+  stat = soAccessGranted (nInode, W);
+  if ((p_inode[offset].owner != getuid ()) && (getuid () != 0) && (stat != 0)) return -EPERM;
+
+  if (times == NULL)
+     { p_inode[offset].vD1.atime = time (NULL);
+       p_inode[offset].vD2.mtime = p_inode[offset].vD1.atime;
+     }
+     else { p_inode[offset].vD1.atime = times->actime;
+            p_inode[offset].vD2.mtime = times->modtime;
+          }
+
+  return soStoreBlockInT ();
+}
+
+/**
+ *  \brief Change the last access and modification times of a file with nanosecond resolution.
+ *
+ *  It tries to emulate <em>utimensat</em> system call.
+ *
+ *  \param ePath path to the file
+ *  \param tv structure array where the last access, element of index 0, and modification, element of index 1, times
+ *            are passed, if \c NULL, the last access and modification times are set to the current time
+ *            if the <tt>tv_nsec</tt> field of one of the <tt>timespec</tt> structures has the special
+ *            value \c UTIME_NOW, then the corresponding file timestamp is set to the current time
+ *            if the <tt>tv_nsec</tt> field of one of the <tt>timespec</tt> structures has the special
+ *            value \c UTIME_OMIT, then the corresponding file timestamp is left unchanged
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT,  if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c EPERM, if the process that calls the operation is neither the file's owner, nor is <em>root</em>, or
+ *                     has not write permission
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soUtimens (const char *ePath, const struct timespec tv[2])
+{
+  soColorProbe (219, "07;31", "soUtimens (\"%s\", %p)\n", ePath, tv);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  uint32_t nBlk, offset;                         /* block number and offset of the inode in the table of inodes */
+  SOInode *p_inode;                              /* pointer to the block of the table of inodes holding it */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soConvertRefInT (nInode, &nBlk, &offset)) != 0) return stat;
+  if ((stat = soLoadBlockInT (nBlk)) != 0) return stat;
+  p_inode = soGetBlockInT ();
+
+  stat = soAccessGranted (nInode, W);
+  if ((p_inode[offset].owner != getuid ()) && (getuid () != 0) && (stat != 0)) return -EPERM;
+
+  if (tv == NULL)
+     { p_inode[offset].vD1.atime = time (NULL);
+       p_inode[offset].vD2.mtime = p_inode[offset].vD1.atime;
+     }
+     else { if (tv[0].tv_nsec == UTIME_NOW)
+               p_inode[offset].vD1.atime = time (NULL);
+               else if (tv[0].tv_nsec != UTIME_OMIT)
+                       p_inode[offset].vD1.atime = tv[0].tv_sec;
+            if (tv[1].tv_nsec == UTIME_NOW)
+               p_inode[offset].vD2.mtime = time (NULL);
+               else if (tv[1].tv_nsec != UTIME_OMIT)
+                       p_inode[offset].vD2.mtime = tv[1].tv_sec;
+          }
+
+  return soStoreBlockInT ();
+}
+
+/**
+ *  \brief Open a regular file.
+ *
+ *  It tries to emulate <em>open</em> system call.
+ *
+ *  \param ePath path to the file
+ *  \param flags access modes to be used:
+ *                    O_RDONLY, O_WRONLY, O_RDWR
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path or no access mode of the defined class is described
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT, if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EISDIR, if <tt>ePath</tt> represents a directory
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c EPERM, if the process that calls the operation has not the proper permission (read / write) on the file
+ *                     described by <tt>ePath</tt>
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soOpen (const char *ePath, int flags)
+{
+  soColorProbe (220, "07;31", "soOpen (\"%s\", %x)\n", ePath, flags);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  SOInode inode;                                 /* inode of the file */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) != INODE_FILE) return -EISDIR;
+
+  return soAccessGranted (nInode, R);
+}
+
+/**
+ *  \brief Close a regular file.
+ *
+ *  It tries to emulate <em>close</em> system call.
+ *
+ *  \param ePath path to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT, if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EISDIR, if <tt>ePath</tt> represents a directory
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soClose (const char *ePath)
+{
+  soColorProbe (221, "07;31", "soClose (\"%s\")\n", ePath);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  SOInode inode;                                 /* inode of the file */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) != INODE_FILE) return -EISDIR;
+
+  return soFsync (ePath);
+}
+
+/**
+ *  \brief Synchronize a file's in-core state with storage device.
+ *
+ *  It tries to emulate <em>fsync</em> system call.
+ *
+ *  \param ePath path to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt>, but the last one, is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT, if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soFsync (const char *ePath)
+{
+  soColorProbe (222, "07;31", "soFsync (\"%s\")\n", ePath);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the file */
+  SOInode inode;                                 /* inode of the file */
+  SODataClust *p_sngInd, *p_dirRef;              /* pointers to the clusters of single and direct references */
+  SOSuperBlock *p_sb;                            /* pointer to the superblock data buffer */
+  int i, j;                                      /* indexes to the lists of references */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+
+  /* data clusters referenced through the double indirect reference and the clusters of references themselves */
+
+  if (inode.i2 != NULL_CLUSTER)
+     { if ((stat = soLoadSngIndRefClust (inode.i2)) != 0) return stat;
+       p_sngInd = soGetSngIndRefClust ();
+       for (i = 0; i < RPC; i++)
+         if (p_sngInd->ref[i] != NULL_CLUSTER)
+            { if ((stat = soLoadDirRefClust (p_sngInd->ref[i])) != 0) return stat;
+              p_dirRef = soGetDirRefClust ();
+              for (j = 0; j < RPC; j++)
+                if ((p_dirRef->ref[j] != NULL_CLUSTER) && ((stat = soSyncCacheCluster (p_dirRef->ref[j])) != 0))
+                   return stat;
+              if ((stat = soSyncCacheCluster (p_sngInd->ref[i])) != 0) return stat;
+            }
+       if ((stat = soSyncCacheCluster (inode.i2)) != 0) return stat;
+     }
+
+  /* data clusters referenced through the single indirect reference and the cluster of references itself */
+
+  if (inode.i1 != NULL_CLUSTER)
+     { if ((stat = soLoadDirRefClust (inode.i1)) != 0) return stat;
+       p_dirRef = soGetDirRefClust ();
+       for (j = 0; j < RPC; j++)
+         if ((p_dirRef->ref[j] != NULL_CLUSTER) && ((stat = soSyncCacheCluster (p_dirRef->ref[j])) != 0))
+            return stat;
+       if ((stat = soSyncCacheCluster (inode.i1)) != 0) return stat;
+     }
+
+  /* data clusters directly referenced */
+
+  for (i = 0; i < N_DIRECT; i++)
+    if ((inode.d[i] != NULL_CLUSTER) && ((stat = soSyncCacheCluster (inode.d[i])) != 0))
+       return stat;
+
+  /* block of the table of inodes where the inode is stored */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  return soSyncCacheBlock (p_sb->itable_start + nInode / IPB);
+}
+
+/**
+ *  \brief Open a directory for reading.
+ *
+ *  It tries to emulate <em>opendir</em> system call.
+ *
+ *  \param ePath path to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt> is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT, if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c EPERM, if the process that calls the operation has not read permission on the directory described by
+ *                     <tt>ePath</tt>
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soOpendir (const char *ePath)
+{
+  soColorProbe (223, "07;31", "soOpendir (\"%s\")\n", ePath);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the directory */
+  SOInode inode;                                 /* inode of the directory */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) != INODE_DIR) return -ENOTDIR;
+  if ((stat = soAccessGranted (nInode, R)) == -EACCES) return -EPERM;
+
+  return stat;
+}
+
+/**
+ *  \brief Close a directory.
+ *
+ *  It tries to emulate <em>closedir</em> system call.
+ *
+ *  \param ePath path to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the string is \c NULL or the path string is a \c NULL string or the path does
+ *                      not describe an absolute path
+ *  \return -\c ENAMETOOLONG, if the path name or any of its components exceed the maximum allowed length
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt> is not a directory
+ *  \return -\c ELOOP, if the path resolves to more than one symbolic link
+ *  \return -\c ENOENT, if no entry with a name equal to any of the components of <tt>ePath</tt> is found
+ *  \return -\c EACCES, if the process that calls the operation has not execution permission on any of the components
+ *                      of <tt>ePath</tt>, but the last one
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soClosedir (const char *ePath)
+{
+  soColorProbe (224, "07;31", "soClosedir (\"%s\")\n", ePath);
+
+  int stat;                                      /* status of operation */
+  uint32_t nInode;                               /* inode number of the directory */
+  SOInode inode;                                 /* inode of the directory */
+
+  if ((ePath == NULL) || (ePath[0] == '\0')) return -EINVAL;
+  if (strlen (ePath) > MAX_PATH) return -ENAMETOOLONG;
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) != INODE_DIR) return -ENOTDIR;
+
+  return soFsync (ePath);
+}
@@ -56,7 +56,8 @@
  *
  *  A buffered communication channel is established with the storage device.
  *  The superblock is read and it is checked if the file system was properly unmounted the last time it was mounted. If
- *  not, a consistency check is performed (presently, the check is superficial, a more thorough one is required).
+ *  not, a quick consistency check of the superblock is performed through soQCheck, so that it suits the format of the
+ *  table of free data clusters (presently, the check is superficial, a more thorough one is required).
  *
  *  \param devname absolute path to the Linux file that simulates the storage device
  *
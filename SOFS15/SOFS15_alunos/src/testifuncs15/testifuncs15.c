@@ -62,6 +62,7 @@
 #include "sofs_probe.h"
 #include "sofs_const.h"
 #include "sofs_buffercache.h"
+#include "sofs_rawdisk.h"
 #include "sofs_superblock.h"
 #include "sofs_inode.h"
 #include "sofs_direntry.h"
@@ -186,13 +187,14 @@ int main (int argc, char *argv[])
 {
   int lower = 0;                                 /* lower limit of log depth, if kept set to zero */
   int higher = 0;                                /* upper limit of log depth, if kept set to zero */
+  uint32_t mode;                                 /* device backend */
 
   /* process command line options */
 
   int opt;                                       /* selected option */
 
   do
-  { switch ((opt = getopt (argc, argv, "l:L:bh")))
+  { switch ((opt = getopt (argc, argv, "l:L:bM:h")))
     { case 'l': /* log depth */
                 if (sscanf (optarg, "%d,%d", &lower, &higher) != 2)
                    { fprintf (stderr, "%s: Bad argument to l option.\n", basename (argv[0]));
@@ -212,6 +214,21 @@ int main (int argc, char *argv[])
       case 'b': /* batch mode */
                 batch = 1;                       /* set batch mode for processing: no input messages are issued */
                 break;
+      case 'M': /* device backend */
+                if (strcmp (optarg, "sync") == 0)
+                   mode = RAW_SYNC;
+                   else if (strcmp (optarg, "uring") == 0)
+                           mode = RAW_URING;
+                   else if (strcmp (optarg, "mmap") == 0)
+                           mode = RAW_MMAP;
+                   else if (strcmp (optarg, "direct") == 0)
+                           mode = RAW_DIRECT;
+                   else { fprintf (stderr, "%s: Bad argument to M option.\n", basename (argv[0]));
+                          printUsage (basename (argv[0]));
+                          return EXIT_FAILURE;
+                        }
+                soSetDeviceMode (mode, 0);
+                break;
       case 'h': /* help mode */
                 printUsage (basename (argv[0]));
                 return EXIT_SUCCESS;
@@ -304,6 +321,7 @@ static void printUsage (char *cmd_name)
           "  -b       --- set batch mode (default: not batch)\n"
           "  -l depth --- set log depth (default: 0,0)\n"
           "  -L file  --- log file (default: stdout)\n"
+          "  -M mode  --- device backend: sync, uring, mmap or direct (default: sync)\n"
           "  -h       --- print this help\n", cmd_name);
 }
 